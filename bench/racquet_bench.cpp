@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "boost/program_options.hpp"
+
+#include "../src/interpret/interpret.h"
+#include "../src/interpret/counters.h"
+#include "../src/interpret/context.h"
+#include "../src/functions/functions.h"
+#include "../src/functions/vector_kernels.h"
+#include "../src/memory/gc.h"
+#include "../src/api/racquet.h"
+
+namespace Bench
+{
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+
+    /**
+     * A workload evaluates setup outside of the timed region, then times body. If check isn't empty,
+     * the global named result has to print as check after every run, so a broken interpreter can't look fast.
+     */
+    struct Workload
+    {
+        std::string name;
+        std::string setup;
+        std::string body;
+        std::string check;
+
+        /* Replaces evaluating body, for workloads that don't evaluate anything */
+        std::function<void(const std::string &)> timed;
+    };
+
+    struct Result
+    {
+        std::string name;
+        size_t iterations = 0;
+        double meanMs = 0, minMs = 0, maxMs = 0;
+        Interpreter::RuntimeStats perIteration;
+    };
+
+    void evaluateSource(const std::string &source, scope_ptr &globalScope)
+    {
+        std::istringstream input(source);
+
+        while (input)
+        {
+            std::string form = Interpreter::read(input);
+            if (form.empty()) continue;
+
+            Interpreter::interpret(Parser::parse(form, globalScope));
+            Memory::maybeCollect(globalScope.get());
+        }
+    }
+
+    /* Parses every tuple of the source down to its atoms without evaluating anything */
+    void parseTree(const std::string &str, size_t &atoms)
+    {
+        if (str.empty()) return;
+
+        if (str.front() != '(' && str.front() != '[')
+        {
+            if (Parser::isNumber(str)) ++atoms;
+            return;
+        }
+
+        for (auto &member : Parser::parseTuple(str)) parseTree(member, atoms);
+    }
+
+    std::string largeSource()
+    {
+        std::ostringstream source;
+
+        for (int i = 0; i < 2000; ++i)
+        {
+            source << "(define (f" << i << " x y) (cond [(< x " << i << ") (+ x (* y " << i << "))]" << std::endl
+                   << "  [(empty? y) (list x 'sym \"str\" #\\c)]" << std::endl
+                   << "  [else (local [(define z (- x 1))] (f" << i << " z (rest y)))]))" << std::endl;
+        }
+
+        return source.str();
+    }
+
+    std::string checkExpectSuite()
+    {
+        std::ostringstream source;
+
+        for (int i = 0; i < 100; ++i)
+            source << "(check-expect (fib " << i % 10 << ") (fib " << i % 10 << "))" << std::endl;
+        source << "(define result (run-tests))" << std::endl;
+
+        return source.str();
+    }
+
+    std::vector<Workload> workloads()
+    {
+        std::vector<Workload> list;
+
+        list.push_back({"fib",
+                        "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))",
+                        "(define result (fib 16))", "987", nullptr});
+
+        list.push_back({"tak",
+                        "(define (tak x y z) (if (not (< y x)) z (tak (tak (- x 1) y z) (tak (- y 1) z x)"
+                        " (tak (- z 1) x y))))",
+                        "(define result (tak 12 8 4))", "5", nullptr});
+
+        list.push_back({"sort",
+                        "(define lst (build-list 2000 (lambda (i) (- (* i 7919) (* 10007 (floor (/ (* i 7919) 10007)))))))",
+                        "(define result (first (sort lst <)))", "0", nullptr});
+
+        list.push_back({"foldl",
+                        "(define lst (build-list 1000000 identity))",
+                        "(define result (foldl + 0 lst))", "499999500000", nullptr});
+
+        list.push_back({"stream",
+                        "(define (square x) (* x x))",
+                        "(define result (stream-fold + 0 (stream-map square (stream-filter odd? (in-range 0 20000)))))",
+                        "1333333330000", nullptr});
+
+        list.push_back({"string-append",
+                        "(define (build s n) (if (= n 0) s (build (string-append s \"ab\") (- n 1))))",
+                        "(define result (string=? (build \"\" 1000) (replicate 1000 \"ab\")))", "true", nullptr});
+
+        list.push_back({"structs",
+                        "(define-struct particle (x y vx vy))\n"
+                        "(define (move p) (make-particle (+ (particle-x p) (particle-vx p))"
+                        " (+ (particle-y p) (particle-vy p)) (particle-vx p) (- (particle-vy p) 1)))\n"
+                        "(define (simulate ps ticks) (if (= ticks 0) ps (simulate (map move ps) (- ticks 1))))\n"
+                        "(define start (build-list 200 (lambda (i) (make-particle i 0 1 i))))",
+                        "(define result (foldl + 0 (map particle-y (simulate start 20))))", "360000", nullptr});
+
+        list.push_back({"flvector",
+                        "(define v (build-vector 100000 (lambda (i) (- i 50000))))",
+                        "(define result (flvector-argmin (flvector+ (flvector-sqr v) (flvector* v 3))))", "49998", nullptr});
+
+        std::string source = largeSource();
+        list.push_back({"parse-only", "", source, "", [](const std::string &body)
+        {
+            std::istringstream input(body);
+            size_t atoms = 0;
+
+            while (input)
+            {
+                std::string form = Interpreter::read(input);
+                if (!form.empty()) parseTree(form, atoms);
+            }
+
+            if (atoms == 0) throw std::logic_error("parse-only: nothing was parsed");
+        }});
+
+        // Calls from C++ into an interpreter kept across runs, arguments and results cross as Racquet::Values
+        auto embedded = std::make_shared<Racquet::Interpreter>();
+        embedded->eval("(define (dist2 x y) (+ (* x x) (* y y)))");
+        list.push_back({"embed-call", "", "", "", [embedded](const std::string &)
+        {
+            std::int64_t sum = 0;
+            for (std::int64_t i = 0; i < 1000; ++i) sum += embedded->call("dist2", i, 2).asInt64();
+
+            if (sum != 332837500) throw std::logic_error("embed-call: expected 332837500, got " + std::to_string(sum));
+        }});
+
+        list.push_back({"check-expect",
+                        "(define (fib n) (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2)))))",
+                        checkExpectSuite(), "", nullptr});
+
+        return list;
+    }
+
+    Interpreter::RuntimeStats difference(const Interpreter::RuntimeStats &after, const Interpreter::RuntimeStats &before,
+                                         size_t iterations)
+    {
+        Interpreter::RuntimeStats stats;
+        stats.steps = (after.steps - before.steps) / iterations;
+        stats.lambdaCalls = (after.lambdaCalls - before.lambdaCalls) / iterations;
+        stats.builtinCalls = (after.builtinCalls - before.builtinCalls) / iterations;
+        stats.scopeAllocations = (after.scopeAllocations - before.scopeAllocations) / iterations;
+        stats.clones = (after.clones - before.clones) / iterations;
+        stats.parses = (after.parses - before.parses) / iterations;
+        stats.gmpPromotions = (after.gmpPromotions - before.gmpPromotions) / iterations;
+        return stats;
+    }
+
+    Result run(const Workload &workload, double minSeconds, size_t minIterations)
+    {
+        Result result;
+        result.name = workload.name;
+
+        std::vector<double> times;
+        double total = 0;
+        Interpreter::RuntimeStats counted;
+
+        // The first run warms up the allocators and isn't counted
+        for (size_t i = 0; i == 0 || times.size() < minIterations || total < minSeconds * 1000; ++i)
+        {
+            Interpreter::Context context;
+            scope_ptr &globalScope = context.globalScope;
+            evaluateSource(workload.setup, globalScope);
+
+            Interpreter::RuntimeStats before = Interpreter::runtimeStats();
+            auto start = std::chrono::steady_clock::now();
+
+            if (workload.timed) workload.timed(workload.body);
+            else evaluateSource(workload.body, globalScope);
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            Interpreter::RuntimeStats after = Interpreter::runtimeStats();
+
+            if (!workload.check.empty())
+            {
+                std::string actual = globalScope->getDefinition("result")->toString();
+                if (actual != workload.check)
+                    throw std::logic_error(workload.name + ": expected " + workload.check + ", got " + actual);
+            }
+
+            if (i == 0) continue;
+
+            times.push_back(elapsed.count());
+            total += elapsed.count();
+            counted = difference(after, before, 1);
+
+            result.perIteration.steps += counted.steps;
+            result.perIteration.lambdaCalls += counted.lambdaCalls;
+            result.perIteration.builtinCalls += counted.builtinCalls;
+            result.perIteration.scopeAllocations += counted.scopeAllocations;
+            result.perIteration.clones += counted.clones;
+            result.perIteration.parses += counted.parses;
+            result.perIteration.gmpPromotions += counted.gmpPromotions;
+        }
+
+        result.iterations = times.size();
+        result.meanMs = total / times.size();
+        result.minMs = *std::min_element(times.begin(), times.end());
+        result.maxMs = *std::max_element(times.begin(), times.end());
+        result.perIteration = difference(result.perIteration, Interpreter::RuntimeStats(), times.size());
+
+        return result;
+    }
+
+    void writeJson(std::ostream &out, const std::vector<Result> &results)
+    {
+        auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        char date[32];
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        out << "{" << std::endl;
+        out << "  \"context\": {" << std::endl;
+        out << "    \"date\": \"" << date << "\"," << std::endl;
+        out << "    \"vector_kernels\": \"" << VectorKernels::kernels().name << "\"," << std::endl;
+#ifdef NDEBUG
+        out << "    \"library_build_type\": \"release\"" << std::endl;
+#else
+        out << "    \"library_build_type\": \"debug\"" << std::endl;
+#endif
+        out << "  }," << std::endl;
+        out << "  \"benchmarks\": [" << std::endl;
+
+        out << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &result = results[i];
+
+            out << "    {\"name\": \"" << result.name << "\", \"iterations\": " << result.iterations
+                << ", \"time_unit\": \"ms\", \"real_time\": " << result.meanMs
+                << ", \"min_time\": " << result.minMs << ", \"max_time\": " << result.maxMs
+                << ", \"steps\": " << result.perIteration.steps
+                << ", \"lambda_calls\": " << result.perIteration.lambdaCalls
+                << ", \"builtin_calls\": " << result.perIteration.builtinCalls
+                << ", \"scope_allocations\": " << result.perIteration.scopeAllocations
+                << ", \"clones\": " << result.perIteration.clones
+                << ", \"parses\": " << result.perIteration.parses
+                << ", \"gmp_promotions\": " << result.perIteration.gmpPromotions << "}"
+                << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+
+        out << "  ]" << std::endl;
+        out << "}" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    boost::program_options::options_description desc("Opts");
+    desc.add_options()
+            ("help,h", "Usage info")
+            ("filter", boost::program_options::value<std::string>(), "Only run workloads whose name contains this")
+            ("min-time", boost::program_options::value<double>()->default_value(0.5), "Seconds to run each workload")
+            ("min-iterations", boost::program_options::value<size_t>()->default_value(3), "Runs of each workload")
+            ("out,o", boost::program_options::value<std::string>(), "Write the JSON results to a file");
+
+    boost::program_options::variables_map variables;
+    try
+    {
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), variables);
+    }
+    catch (boost::program_options::error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    if (variables.count("help"))
+    {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    Functions::registerFunctions();
+
+    // Output of display and run-tests isn't part of the results
+    std::ostringstream discarded;
+    Functions::setOutput(&discarded);
+
+    std::string filter = variables.count("filter") ? variables["filter"].as<std::string>() : "";
+    std::vector<Bench::Result> results;
+
+    try
+    {
+        for (auto &workload : Bench::workloads())
+        {
+            if (workload.name.find(filter) == std::string::npos) continue;
+
+            Bench::Result result = Bench::run(workload, variables["min-time"].as<double>(),
+                                              std::max<size_t>(variables["min-iterations"].as<size_t>(), 1));
+            discarded.str("");
+
+            std::cerr << std::left << std::setw(16) << result.name << std::right << std::fixed
+                      << std::setprecision(3) << std::setw(12) << result.meanMs << " ms" << std::setw(8)
+                      << result.iterations << " runs" << std::setw(12) << result.perIteration.steps << " steps"
+                      << std::endl;
+
+            results.push_back(result);
+        }
+    }
+    catch (std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (variables.count("out"))
+    {
+        std::ofstream out(variables["out"].as<std::string>());
+        Bench::writeJson(out, results);
+    }
+    else Bench::writeJson(std::cout, results);
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "boost/program_options.hpp"
+
+#include "../src/server/server.h"
+
+/**
+ * Load generator for racquet --serve: clients each send requests back to back over a connection of their own,
+ * then the throughput and the latency distribution over all of them are printed.
+ */
+namespace Load
+{
+    struct Client
+    {
+        std::vector<double> latenciesUs;
+        size_t errors = 0, mismatches = 0;
+        bool failed = false;
+    };
+
+    int connectTo(const std::string &path)
+    {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) return -1;
+
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+        int socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socket < 0) return -1;
+
+        if (::connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0)
+        {
+            ::close(socket);
+            return -1;
+        }
+
+        return socket;
+    }
+
+    void run(const std::string &path, const std::string &source, const std::string &expected, size_t requests,
+             Client &client)
+    {
+        int socket = connectTo(path);
+        if (socket < 0)
+        {
+            client.failed = true;
+            return;
+        }
+
+        client.latenciesUs.reserve(requests);
+        std::string frame;
+        Server::Response response;
+
+        for (size_t i = 0; i < requests; ++i)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            if (!Server::sendFrame(socket, source) || !Server::receiveFrame(socket, frame)
+                || !Server::decodeResponse(frame, response))
+            {
+                client.failed = true;
+                break;
+            }
+
+            std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - start;
+            client.latenciesUs.push_back(latency.count());
+
+            if (response.status != Server::Status::ok) ++client.errors;
+            else if (!expected.empty() && response.result != expected) ++client.mismatches;
+        }
+
+        ::close(socket);
+    }
+
+    double percentile(const std::vector<double> &sorted, double fraction)
+    {
+        if (sorted.empty()) return 0;
+
+        auto index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    boost::program_options::options_description desc("Opts");
+    desc.add_options()
+            ("help,h", "Usage info")
+            ("socket,s", boost::program_options::value<std::string>(), "Socket racquet --serve listens on")
+            ("clients,c", boost::program_options::value<size_t>()->default_value(4), "Concurrent connections")
+            ("requests,n", boost::program_options::value<size_t>()->default_value(1000), "Requests per client")
+            ("expr,e", boost::program_options::value<std::string>()->default_value("(+ 1 2)"), "Source of each request")
+            ("expect", boost::program_options::value<std::string>(), "Count results other than this as mismatches");
+
+    boost::program_options::variables_map variables;
+    try
+    {
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), variables);
+    }
+    catch (boost::program_options::error &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 2;
+    }
+
+    if (variables.count("help") || !variables.count("socket"))
+    {
+        std::cout << desc << std::endl;
+        return variables.count("help") ? 0 : 2;
+    }
+
+    std::string path = variables["socket"].as<std::string>();
+    std::string source = variables["expr"].as<std::string>();
+    std::string expected = variables.count("expect") ? variables["expect"].as<std::string>() : "";
+    size_t requests = variables["requests"].as<size_t>();
+
+    std::vector<Load::Client> clients(std::max<size_t>(variables["clients"].as<size_t>(), 1));
+    std::vector<std::thread> threads;
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto &client : clients)
+        threads.emplace_back(Load::run, std::cref(path), std::cref(source), std::cref(expected), requests,
+                             std::ref(client));
+    for (auto &thread : threads) thread.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double> latencies;
+    size_t errors = 0, mismatches = 0, failedClients = 0;
+    for (auto &client : clients)
+    {
+        latencies.insert(latencies.end(), client.latenciesUs.begin(), client.latenciesUs.end());
+        errors += client.errors;
+        mismatches += client.mismatches;
+        if (client.failed) ++failedClients;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double total = 0;
+    for (double latency : latencies) total += latency;
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "requests:  " << latencies.size() << " in " << std::setprecision(3) << elapsed.count() << " s"
+              << std::endl << std::setprecision(1)
+              << "req/s:     " << latencies.size() / elapsed.count() << std::endl
+              << "mean:      " << (latencies.empty() ? 0 : total / latencies.size()) << " us" << std::endl
+              << "p50:       " << Load::percentile(latencies, 0.50) << " us" << std::endl
+              << "p99:       " << Load::percentile(latencies, 0.99) << " us" << std::endl
+              << "max:       " << (latencies.empty() ? 0 : latencies.back()) << " us" << std::endl
+              << "errors:    " << errors << std::endl
+              << "mismatch:  " << mismatches << std::endl
+              << "failed:    " << failedClients << " client(s)" << std::endl;
+
+    return failedClients == 0 && errors == 0 && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,470 @@
+#include <fstream>
+#include <sstream>
+
+#include "racquet.h"
+#include "../interpret/interpret.h"
+#include "../interpret/context.h"
+#include "../expressions/struct_expression.h"
+#include "../expressions/vector_expression.h"
+
+namespace Racquet
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+
+    /* Copies values between the interpreter's expressions and Values */
+    struct Marshal
+    {
+        static Value fromExpression(Expressions::Expression &expr)
+        {
+            Value value;
+
+            if (auto number = dynamic_cast<Expressions::NumericalValueExpression *>(&expr))
+            {
+                auto rational = number->value.backend().data();
+
+                if (mpz_cmp_ui(mpq_denref(rational), 1) == 0 && mpz_fits_slong_p(mpq_numref(rational)))
+                {
+                    value.valueKind = Value::Kind::integer;
+                    value.integer = mpz_get_si(mpq_numref(rational));
+                }
+                else
+                {
+                    value.valueKind = Value::Kind::exact;
+                    Expressions::VectorExpression::asFlonum(expr, value.real);
+                    value.printed = expr.toString();
+                }
+            }
+            else if (dynamic_cast<Expressions::InexactNumberExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::real;
+                Expressions::VectorExpression::asFlonum(expr, value.real);
+            }
+            else if (auto boolean = dynamic_cast<Expressions::BooleanValueExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::boolean;
+                value.boolean = boolean->value;
+            }
+            else if (auto string = dynamic_cast<Expressions::StringExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::string;
+                value.str = string->str;
+            }
+            else if (auto symbol = dynamic_cast<Expressions::SymbolExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::symbol;
+                value.str = symbol->symbol.substr(1);
+            }
+            else if (auto character = dynamic_cast<Expressions::CharacterExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::character;
+                value.ch = character->character;
+            }
+            else if (auto list = dynamic_cast<Expressions::ListExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::list;
+                for (auto &element : list->list) value.items.push_back(fromExpression(*element));
+            }
+            else if (auto vector = dynamic_cast<Expressions::VectorExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::vector;
+
+                std::vector<long> fixnums;
+                if (vector->fixnums(fixnums))
+                {
+                    value.unboxedFixnums = true;
+                    value.fixnums.assign(fixnums.begin(), fixnums.end());
+                    value.itemsBoxed = false;
+                }
+                else if (vector->kind() == Expressions::VectorStorage::Kind::flonum)
+                {
+                    value.unboxedFlonums = true;
+                    vector->numbers(value.flonums);
+                    value.itemsBoxed = false;
+                }
+                else
+                {
+                    for (auto &element : vector->elements()) value.items.push_back(fromExpression(*element));
+                }
+            }
+            else if (auto structure = dynamic_cast<Expressions::StructExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::structure;
+                value.str = structure->structName;
+                for (auto &field : structure->structFields) value.items.push_back(fromExpression(*field));
+            }
+            else if (dynamic_cast<Expressions::VoidValueExpression *>(&expr))
+            {
+                value.valueKind = Value::Kind::nothing;
+            }
+            else
+            {
+                value.valueKind = dynamic_cast<Expressions::FunctionExpression *>(&expr) ? Value::Kind::procedure
+                                                                                         : Value::Kind::other;
+                value.printed = expr.toString();
+
+                // The live value, not its source, so a closure keeps the variables it captured
+                value.handle = std::shared_ptr<Expressions::Expression>(expr.clone());
+                if (auto context = ::Interpreter::Context::find(expr.localScope.get()))
+                    context->addExternalRoot(value.handle);
+            }
+
+            return value;
+        }
+
+        static expression_vector toExpressions(const std::vector<Value> &values, const scope_ptr &scope)
+        {
+            expression_vector rtn;
+            rtn.reserve(values.size());
+            for (auto &value : values) rtn.push_back(toExpression(value, scope));
+
+            return rtn;
+        }
+
+        static expr_ptr toExpression(const Value &value, const scope_ptr &scope)
+        {
+            switch (value.valueKind)
+            {
+                case Value::Kind::nothing:
+                    return std::make_unique<Expressions::VoidValueExpression>(scope);
+                case Value::Kind::boolean:
+                    return std::make_unique<Expressions::BooleanValueExpression>(value.boolean, scope);
+                case Value::Kind::integer:
+                    return std::make_unique<Expressions::NumericalValueExpression>
+                            (Expressions::NumericalValueExpression::numerical_type(value.integer), scope);
+                case Value::Kind::real:
+                    return Expressions::VectorExpression::makeFlonum(value.real, scope);
+                case Value::Kind::string:
+                    return std::make_unique<Expressions::StringExpression>(value.str, scope);
+                case Value::Kind::symbol:
+                    return std::make_unique<Expressions::SymbolExpression>("'" + value.str, scope);
+                case Value::Kind::character:
+                    return std::make_unique<Expressions::CharacterExpression>(value.ch, scope);
+                case Value::Kind::list:
+                {
+                    std::list<expr_ptr> list;
+                    for (auto &element : value.items) list.push_back(toExpression(element, scope));
+
+                    return std::make_unique<Expressions::ListExpression>(std::move(list), scope);
+                }
+                case Value::Kind::vector:
+                    if (value.unboxedFixnums)
+                        return Expressions::VectorExpression::fromFixnums(
+                                std::vector<long>(value.fixnums.begin(), value.fixnums.end()), scope);
+                    if (value.unboxedFlonums) return Expressions::VectorExpression::fromFlonums(value.flonums, scope);
+
+                    return Expressions::VectorExpression::fromElements(toExpressions(value.items, scope), scope);
+                case Value::Kind::structure:
+                    return std::make_unique<Expressions::StructExpression>
+                            (value.str, toExpressions(value.items, scope), scope);
+                case Value::Kind::procedure:
+                case Value::Kind::other:
+                {
+                    auto from = ::Interpreter::Context::find(value.handle->localScope.get());
+                    auto to = ::Interpreter::Context::find(scope.get());
+                    if (from && to && from != to)
+                        throw std::invalid_argument("Can't pass " + value.printed + " to another interpreter");
+
+                    return value.handle->clone();
+                }
+                default:
+                    // Exact numbers that don't fit in 64 bits are rebuilt from their printed form
+                    return ::Interpreter::interpret(Parser::parse(value.printed, scope));
+            }
+        }
+
+        /* The name a kind is called in error messages */
+        static std::string describe(Value::Kind kind)
+        {
+            switch (kind)
+            {
+                case Value::Kind::boolean:
+                    return "boolean";
+                case Value::Kind::integer:
+                    return "64 bit integer";
+                case Value::Kind::string:
+                    return "string";
+                case Value::Kind::character:
+                    return "character";
+                case Value::Kind::structure:
+                    return "structure";
+                default:
+                    return "number";
+            }
+        }
+    };
+
+    /* Value */
+
+    Value::Value() = default;
+
+    Value::Value(bool value) : valueKind(Kind::boolean), boolean(value)
+    {}
+
+    Value::Value(int value) : valueKind(Kind::integer), integer(value)
+    {}
+
+    Value::Value(long value) : valueKind(Kind::integer), integer(value)
+    {}
+
+    Value::Value(long long value) : valueKind(Kind::integer), integer(value)
+    {}
+
+    Value::Value(double value) : valueKind(Kind::real), real(value)
+    {}
+
+    Value::Value(const char *value) : valueKind(Kind::string), str(value)
+    {}
+
+    Value::Value(boost::string_ref value) : valueKind(Kind::string), str(value.to_string())
+    {}
+
+    Value::Value(const std::string &value) : valueKind(Kind::string), str(value)
+    {}
+
+    Value::Value(std::vector<std::int64_t> fixnums)
+            : valueKind(Kind::vector), unboxedFixnums(true), fixnums(std::move(fixnums)), itemsBoxed(false)
+    {}
+
+    Value::Value(std::vector<double> flonums)
+            : valueKind(Kind::vector), unboxedFlonums(true), flonums(std::move(flonums)), itemsBoxed(false)
+    {}
+
+    Value Value::symbol(boost::string_ref name)
+    {
+        Value value(name);
+        value.valueKind = Kind::symbol;
+        return value;
+    }
+
+    Value Value::character(char ch)
+    {
+        Value value;
+        value.valueKind = Kind::character;
+        value.ch = ch;
+        return value;
+    }
+
+    Value Value::list(std::vector<Value> elements)
+    {
+        Value value;
+        value.valueKind = Kind::list;
+        value.items = std::move(elements);
+        return value;
+    }
+
+    Value Value::vector(std::vector<Value> elements)
+    {
+        Value value = list(std::move(elements));
+        value.valueKind = Kind::vector;
+        return value;
+    }
+
+    Value Value::structure(boost::string_ref name, std::vector<Value> fields)
+    {
+        Value value = list(std::move(fields));
+        value.valueKind = Kind::structure;
+        value.str = name.to_string();
+        return value;
+    }
+
+    Value::Kind Value::kind() const
+    {
+        return valueKind;
+    }
+
+    bool Value::isNumber() const
+    {
+        return valueKind == Kind::integer || valueKind == Kind::exact || valueKind == Kind::real;
+    }
+
+    bool Value::asBool() const
+    {
+        if (valueKind != Kind::boolean) throw std::invalid_argument("Expected boolean, found " + text());
+        return boolean;
+    }
+
+    std::int64_t Value::asInt64() const
+    {
+        if (valueKind != Kind::integer) throw std::invalid_argument("Expected 64 bit integer, found " + text());
+        return integer;
+    }
+
+    double Value::asDouble() const
+    {
+        if (valueKind == Kind::integer) return integer;
+        if (!isNumber()) throw std::invalid_argument("Expected number, found " + text());
+        return real;
+    }
+
+    const std::string &Value::asString() const
+    {
+        if (valueKind != Kind::string && valueKind != Kind::symbol)
+            throw std::invalid_argument("Expected string or symbol, found " + text());
+        return str;
+    }
+
+    char Value::asChar() const
+    {
+        if (valueKind != Kind::character) throw std::invalid_argument("Expected character, found " + text());
+        return ch;
+    }
+
+    const std::vector<Value> &Value::elements() const
+    {
+        if (valueKind != Kind::list && valueKind != Kind::vector && valueKind != Kind::structure)
+            throw std::invalid_argument("Expected list, vector or structure, found " + text());
+
+        if (!itemsBoxed)
+        {
+            if (unboxedFixnums) items.assign(fixnums.begin(), fixnums.end());
+            else items.assign(flonums.begin(), flonums.end());
+            itemsBoxed = true;
+        }
+
+        return items;
+    }
+
+    std::vector<std::int64_t> Value::asInt64s() const
+    {
+        if (unboxedFixnums) return fixnums;
+
+        std::vector<std::int64_t> rtn;
+        for (auto &element : elements()) rtn.push_back(element.asInt64());
+
+        return rtn;
+    }
+
+    std::vector<double> Value::asDoubles() const
+    {
+        if (unboxedFlonums) return flonums;
+        if (unboxedFixnums) return std::vector<double>(fixnums.begin(), fixnums.end());
+
+        std::vector<double> rtn;
+        for (auto &element : elements()) rtn.push_back(element.asDouble());
+
+        return rtn;
+    }
+
+    const std::string &Value::structName() const
+    {
+        if (valueKind != Kind::structure) throw std::invalid_argument("Expected structure, found " + text());
+        return str;
+    }
+
+    const std::string &Value::text() const
+    {
+        if (printed.empty()) printed = Marshal::toExpression(*this, nullptr)->toString();
+        return printed;
+    }
+
+    size_t Value::size() const
+    {
+        if (unboxedFixnums) return fixnums.size();
+        if (unboxedFlonums) return flonums.size();
+
+        return elements().size();
+    }
+
+    const Value &Value::operator[](size_t index) const
+    {
+        const std::vector<Value> &all = elements();
+
+        if (index >= all.size())
+            throw std::invalid_argument("Index " + std::to_string(index) + " is out of range for a value of length "
+                                        + std::to_string(all.size()));
+
+        return all[index];
+    }
+
+    /* Interpreter */
+
+    struct Interpreter::State
+    {
+        ::Interpreter::Context context;
+        std::ostream *output = &std::cout;
+    };
+
+    Interpreter::Interpreter()
+    {
+        Functions::registerFunctions();
+        state = std::make_unique<State>();
+    }
+
+    Interpreter::~Interpreter() = default;
+
+    Interpreter::Interpreter(Interpreter &&other) noexcept = default;
+
+    Interpreter &Interpreter::operator=(Interpreter &&other) noexcept = default;
+
+    Value Interpreter::eval(boost::string_ref source)
+    {
+        Functions::OutputRedirect redirect(state->output);
+        scope_ptr &global = state->context.globalScope;
+
+        Value result;
+
+        // Split into top-level forms the way the members of a tuple are, several may share a line
+        for (auto &form : Parser::parseTuple("(" + source.to_string() + "\n)"))
+        {
+            // The result has to be copied out before collecting, nothing roots it
+            result = Marshal::fromExpression(*::Interpreter::interpret(Parser::parse(form, global)));
+            Memory::maybeCollect(global.get());
+        }
+
+        return result;
+    }
+
+    void Interpreter::load(const std::string &path)
+    {
+        std::ifstream file(path);
+        if (!file) throw std::invalid_argument("Can't open " + path);
+
+        std::ostringstream source;
+        source << file.rdbuf();
+        eval(source.str());
+    }
+
+    Value Interpreter::call(boost::string_ref function, std::vector<Value> args)
+    {
+        Functions::OutputRedirect redirect(state->output);
+        scope_ptr &global = state->context.globalScope;
+        std::string name = function.to_string();
+
+        expr_ptr callee;
+        if (global->find(name)) callee = global->getDefinition(name);
+        else if (state->context.functions.count(name) > 0) callee = Functions::getFuncByName(name, global);
+        else throw std::invalid_argument("Function " + name + " not found");
+
+        auto func = dynamic_cast<Expressions::FunctionExpression *>(callee.get());
+        if (!func) throw std::invalid_argument("Expected function, found " + callee->toString());
+
+        expr_ptr returned = ::Interpreter::interpret(func->call(Marshal::toExpressions(args, global)));
+        Value result = Marshal::fromExpression(*returned);
+        Memory::maybeCollect(global.get());
+
+        return result;
+    }
+
+    void Interpreter::define(boost::string_ref name, const Value &value)
+    {
+        scope_ptr &global = state->context.globalScope;
+        global->define(name.to_string(), Marshal::toExpression(value, global));
+    }
+
+    Value Interpreter::get(boost::string_ref name)
+    {
+        return Marshal::fromExpression(*state->context.globalScope->getDefinition(name.to_string()));
+    }
+
+    bool Interpreter::defines(boost::string_ref name)
+    {
+        return state->context.globalScope->find(name.to_string()) != nullptr;
+    }
+
+    void Interpreter::setOutput(std::ostream &stream)
+    {
+        state->output = &stream;
+    }
+}
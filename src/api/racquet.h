@@ -0,0 +1,187 @@
+#ifndef RACQUET_H
+#define RACQUET_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "boost/utility/string_ref.hpp"
+
+namespace Expressions
+{
+    class Expression;
+}
+
+/**
+ * Embedding API of the interpreter. Values cross it as Racquet::Value, which owns plain C++ data and nothing of
+ * the interpreter's, so results can be kept after the interpreter that made them is gone. Procedures and other
+ * values without a C++ counterpart are the exception: they are opaque handles on the interpreter's own value,
+ * closures keep what they captured, and they can only be passed back to the interpreter they came from.
+ *
+ * Errors raised while evaluating, and asking a Value for something it doesn't hold, throw std::invalid_argument.
+ *
+ * libracquet.a contains the whole interpreter. Programs linking it also need Boost (system, filesystem,
+ * program_options, thread), GMP and the platform's threads library.
+ */
+namespace Racquet
+{
+    class Value
+    {
+    public:
+        enum class Kind
+        {
+            nothing, boolean, integer, exact, real, string, symbol, character, list, vector, structure, procedure,
+            other
+        };
+
+        /* The void value */
+        Value();
+
+        Value(bool value);
+
+        Value(int value);
+
+        Value(long value);
+
+        Value(long long value);
+
+        /* Has to be finite once passed to an interpreter, which has no infinities or NaN */
+        Value(double value);
+
+        Value(const char *value);
+
+        Value(boost::string_ref value);
+
+        Value(const std::string &value);
+
+        /* An unboxed fixnum vector */
+        Value(std::vector<std::int64_t> fixnums);
+
+        /* An flvector, finite numbers only like Value(double) */
+        Value(std::vector<double> flonums);
+
+        static Value symbol(boost::string_ref name);
+
+        static Value character(char value);
+
+        static Value list(std::vector<Value> elements);
+
+        static Value vector(std::vector<Value> elements);
+
+        static Value structure(boost::string_ref name, std::vector<Value> fields);
+
+        Kind kind() const;
+
+        bool isNumber() const;
+
+        bool asBool() const;
+
+        /* Exact integers that fit in 64 bits */
+        std::int64_t asInt64() const;
+
+        /* Any number, rounded to the nearest double */
+        double asDouble() const;
+
+        /* The contents of a string or the name of a symbol */
+        const std::string &asString() const;
+
+        char asChar() const;
+
+        /* The elements of a list or vector, or the fields of a structure */
+        const std::vector<Value> &elements() const;
+
+        /* The numbers of a list or vector of exact integers */
+        std::vector<std::int64_t> asInt64s() const;
+
+        /* The numbers of a list or vector of numbers, as doubles */
+        std::vector<double> asDoubles() const;
+
+        /* The name of a structure */
+        const std::string &structName() const;
+
+        /* The printed form, as the REPL would print it */
+        const std::string &text() const;
+
+        size_t size() const;
+
+        const Value &operator[](size_t index) const;
+
+    private:
+        friend struct Marshal;
+
+        Kind valueKind = Kind::nothing;
+
+        bool boolean = false;
+        std::int64_t integer = 0;
+        double real = 0;
+        char ch = 0;
+
+        /* String contents, symbol or struct name */
+        std::string str;
+
+        /* Printed form, made when first asked for. Set right away for exact numbers, which are rebuilt from it when
+         * passed back in, and for procedures and others. */
+        mutable std::string printed;
+
+        /* The value itself for procedures and others, kept alive as a root of its interpreter's collector */
+        std::shared_ptr<Expressions::Expression> handle;
+
+        /* Unboxed vectors keep their numbers here, elements() boxes them the first time it is asked */
+        bool unboxedFixnums = false, unboxedFlonums = false;
+        std::vector<std::int64_t> fixnums;
+        std::vector<double> flonums;
+        mutable std::vector<Value> items;
+        mutable bool itemsBoxed = true;
+    };
+
+    /**
+     * An interpreter of its own: globals, structs and test cases aren't shared with any other. An Interpreter must
+     * only be used by one thread at a time, different Interpreters may be used by different threads.
+     */
+    class Interpreter
+    {
+    public:
+        Interpreter();
+
+        ~Interpreter();
+
+        Interpreter(Interpreter &&other) noexcept;
+
+        Interpreter &operator=(Interpreter &&other) noexcept;
+
+        /* Evaluates every top-level form of source and returns the value of the last one */
+        Value eval(boost::string_ref source);
+
+        /* Evaluates every top-level form of a file */
+        void load(const std::string &path);
+
+        /* Calls a global function or builtin with the arguments given */
+        Value call(boost::string_ref function, std::vector<Value> args);
+
+        template<typename... Args>
+        Value call(boost::string_ref function, Args &&... args)
+        {
+            return call(function, std::vector<Value>{Value(std::forward<Args>(args))...});
+        }
+
+        /* Defines or redefines a global */
+        void define(boost::string_ref name, const Value &value);
+
+        /* The value of a global */
+        Value get(boost::string_ref name);
+
+        bool defines(boost::string_ref name);
+
+        /* Where display, newline and run-tests print to, std::cout unless set */
+        void setOutput(std::ostream &stream);
+
+    private:
+        struct State;
+
+        std::unique_ptr<State> state;
+    };
+}
+
+#endif //RACQUET_H
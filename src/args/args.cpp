@@ -4,15 +4,44 @@
 
 #include "args.h"
 #include "../interpret/interpret.h"
+#include "../interpret/thread_pool.h"
+#include "../interpret/profiler.h"
+#include "../functions/functions.h"
+#include "../server/server.h"
 
 namespace CLI
 {
+    namespace
+    {
+        /* Shared by the parser and findRunCommand, which needs to know the options taking a value */
+        boost::program_options::options_description options()
+        {
+            boost::program_options::options_description desc("Opts");
+            desc.add_options()
+                    ("help,h", "Usage info")
+                    ("require,t", boost::program_options::value<std::vector<boost::filesystem::path>>(), "Require file")
+                    ("jobs,j", boost::program_options::value<size_t>(), "Threads to run tests and parallel list functions on")
+                    ("test-steps", boost::program_options::value<size_t>(), "Evaluation step budget of each test")
+                    ("test-timeout", boost::program_options::value<long>(), "Time budget of each test in ms")
+                    ("slowest", boost::program_options::value<size_t>(), "List the slowest tests after each run")
+                    ("test-report", boost::program_options::value<std::string>(), "Write a JSON test report")
+                    ("stats", "Print evaluation counters at exit")
+                    ("memo-capacity", boost::program_options::value<size_t>(), "Results kept per memoized function")
+                    ("auto-memo", "Memoize functions proven pure")
+                    ("profile", boost::program_options::value<std::string>(), "Write a profile of the session")
+                    ("profile-period", boost::program_options::value<size_t>(), "Evaluation steps between samples")
+                    ("serve", boost::program_options::value<std::string>(), "Serve eval requests on a Unix socket")
+                    ("request-steps", boost::program_options::value<size_t>(), "Evaluation step budget of each request")
+                    ("request-timeout", boost::program_options::value<long>(), "Time budget of each request in ms")
+                    ("fork", "Evaluate each request in a forked copy of the server");
+
+            return desc;
+        }
+    }
+
     void parseCmdArgs(int argc, char *argv[], std::shared_ptr<Expressions::Scope> &globalScope)
     {
-        boost::program_options::options_description desc("Opts");
-        desc.add_options()
-                ("help,h", "Usage info")
-                ("require,t", boost::program_options::value<std::vector<boost::filesystem::path>>(), "Require file");
+        boost::program_options::options_description desc = options();
 
         boost::program_options::variables_map variables;
         try
@@ -22,7 +51,60 @@ namespace CLI
             if (variables.count("help"))
             {
                 std::cout << "-h \t\t This help message" << std::endl;
+                std::cout << "run <file> [args] \t Evaluate <file> and exit, options go before run" << std::endl;
                 std::cout << "-t <file> \t Load a file into the interpreter" << std::endl;
+                std::cout << "-j <count> \t Run tests, pmap, pfilter and build-list/par on <count> threads" << std::endl;
+                std::cout << "--test-steps <count> \t Fail tests taking more than <count> evaluation steps" << std::endl;
+                std::cout << "--test-timeout <ms> \t Fail tests running longer than <ms> milliseconds" << std::endl;
+                std::cout << "--slowest <count> \t List the <count> slowest tests after each run" << std::endl;
+                std::cout << "--test-report <file> \t Write a JSON report of each test run to <file>" << std::endl;
+                std::cout << "--stats \t\t Print evaluation counters at exit" << std::endl;
+                std::cout << "--memo-capacity <count> \t Keep up to <count> results per memoized function" << std::endl;
+                std::cout << "--auto-memo \t\t Memoize every function whose body is provably pure" << std::endl;
+                std::cout << "--profile <file> \t Write a flat profile to <file> and collapsed stacks to <file>.folded"
+                          << std::endl;
+                std::cout << "--profile-period <count> \t Sample the stack every <count> evaluation steps" << std::endl;
+                std::cout << "--serve <path> \t Evaluate requests from clients of the Unix socket <path> instead of"
+                          << " reading from stdin" << std::endl;
+                std::cout << "--request-steps <count> \t Fail requests taking more than <count> evaluation steps"
+                          << std::endl;
+                std::cout << "--request-timeout <ms> \t Fail requests running longer than <ms> milliseconds"
+                          << std::endl;
+                std::cout << "--fork \t\t Evaluate each request of --serve in a process forked from the warm server"
+                          << std::endl;
+            }
+
+            if (variables.count("jobs"))
+            {
+                TestingFunctions::testOptions.jobs = variables["jobs"].as<size_t>();
+                Interpreter::ThreadPool::configure(TestingFunctions::testOptions.jobs);
+            }
+
+            if (variables.count("test-steps"))
+                TestingFunctions::testOptions.stepLimit = variables["test-steps"].as<size_t>();
+            if (variables.count("test-timeout"))
+                TestingFunctions::testOptions.timeoutMs = variables["test-timeout"].as<long>();
+            if (variables.count("slowest"))
+                TestingFunctions::testOptions.slowest = variables["slowest"].as<size_t>();
+            if (variables.count("test-report"))
+                TestingFunctions::testOptions.jsonReport = variables["test-report"].as<std::string>();
+
+            if (variables.count("stats")) Interpreter::printStatsAtExit = true;
+            if (variables.count("memo-capacity"))
+                Functions::memoOptions.capacity = variables["memo-capacity"].as<size_t>();
+            if (variables.count("auto-memo")) Functions::memoOptions.automatic = true;
+
+            if (variables.count("serve")) Server::serverOptions.socketPath = variables["serve"].as<std::string>();
+            if (variables.count("request-steps"))
+                Server::serverOptions.stepLimit = variables["request-steps"].as<size_t>();
+            if (variables.count("request-timeout"))
+                Server::serverOptions.timeoutMs = variables["request-timeout"].as<long>();
+            if (variables.count("fork")) Server::serverOptions.fork = true;
+
+            if (variables.count("profile"))
+            {
+                size_t period = variables.count("profile-period") ? variables["profile-period"].as<size_t>() : 16;
+                Profiler::start(variables["profile"].as<std::string>(), period);
             }
 
             if (variables.count("require"))
@@ -43,4 +125,27 @@ namespace CLI
             std::cerr << "Command parsing error" << std::endl;
         }
     }
-}
\ No newline at end of file
+
+    int findRunCommand(int argc, char *argv[])
+    {
+        boost::program_options::options_description desc = options();
+
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "run") return i;
+
+            // Only options come before run
+            if (arg.size() < 2 || arg[0] != '-') return argc;
+
+            // --name=value and -jvalue carry their value, --name value and -j value take the next argument
+            bool isLong = arg.compare(0, 2, "--") == 0;
+            if (arg.find('=') != std::string::npos || (!isLong && arg.size() > 2)) continue;
+
+            auto option = desc.find_nothrow(isLong ? arg.substr(2) : arg, false);
+            if (option && option->semantic()->max_tokens() > 0) ++i;
+        }
+
+        return argc;
+    }
+}
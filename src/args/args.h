@@ -12,6 +12,12 @@
 namespace CLI
 {
     void parseCmdArgs(int argc, char *argv[], std::shared_ptr<Expressions::Scope> &);
+
+    /**
+     * The position of the run command in argv, argc if there is none. Options before it are the interpreter's,
+     * the arguments after the script's file are the script's.
+     */
+    int findRunCommand(int argc, char *argv[]);
 }
 
 #endif //RACKET_INTERPRETER_ARGS_H
@@ -0,0 +1,291 @@
+#include "concurrency_expression.h"
+#include "hash_expression.h"
+#include "vector_expression.h"
+#include "../interpret/interpret.h"
+#include "../interpret/context.h"
+#include "../memory/gc.h"
+
+namespace Expressions
+{
+/* FutureExpression */
+
+    void FutureState::run()
+    {
+        std::unique_ptr<Expression> toRun;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (status != Status::pending) return;
+
+            status = Status::running;
+            toRun = std::move(thunk);
+        }
+
+        std::unique_ptr<Expression> result;
+        std::exception_ptr failure;
+
+        try
+        {
+            Interpreter::BudgetScope scope(*budget);
+
+            auto function = dynamic_cast<FunctionExpression *>(toRun.get());
+            result = Interpreter::interpret(function->call(expression_vector()));
+        }
+        catch (...)
+        {
+            failure = std::current_exception();
+        }
+
+        // The thunk's closure goes away before the future stops counting as background work
+        toRun.reset();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            value = std::move(result);
+            error = failure;
+            status = Status::finished;
+            work.reset();
+        }
+
+        finished.notify_all();
+    }
+
+    void FutureState::join()
+    {
+        run();
+
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [this] { return status == Status::finished; });
+    }
+
+    FutureExpression::FutureExpression(std::unique_ptr<Expression> thunk, std::shared_ptr<Scope> scope)
+            : Expression(std::move(scope), "FutureExpression"), state(std::make_shared<FutureState>())
+    {
+        state->thunk = std::move(thunk);
+        state->work.reset(new Interpreter::BackgroundWork(true));
+        state->budget.reset(new Interpreter::SharedBudget());
+
+        if (Interpreter::Context *context = Interpreter::Context::find(localScope.get()))
+            context->addFuture(state);
+
+        std::shared_ptr<FutureState> shared = state;
+        Interpreter::ThreadPool::shared().submit([shared] { shared->run(); });
+    }
+
+    bool FutureExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> FutureExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string FutureExpression::toString() const
+    {
+        return "#<future>";
+    }
+
+    std::unique_ptr<Expression> FutureExpression::clone()
+    {
+        return std::unique_ptr<Expression>(new FutureExpression(*this, this->localScope));
+    }
+
+    bool FutureExpression::equals(const Expression &other) const
+    {
+        auto otherFuture = dynamic_cast<const FutureExpression *>(&other);
+        return otherFuture && otherFuture->state == state;
+    }
+
+    bool FutureExpression::isMutable() const
+    {
+        return true;
+    }
+
+    void FutureExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (state->thunk) tracer.mark(state->thunk.get());
+        if (state->value) tracer.mark(state->value.get());
+    }
+
+    std::unique_ptr<Expression> FutureExpression::touch()
+    {
+        state->join();
+
+        std::lock_guard<std::mutex> guard(state->lock);
+        if (state->error) std::rethrow_exception(state->error);
+        return state->value->clone();
+    }
+
+/* PlaceState */
+
+    void PlaceState::join()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        finished.wait(guard, [this] { return done; });
+    }
+
+/* PlaceChannelExpression */
+
+    bool PlaceChannelExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> PlaceChannelExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string PlaceChannelExpression::toString() const
+    {
+        return place ? "#<place>" : "#<place-channel>";
+    }
+
+    std::unique_ptr<Expression> PlaceChannelExpression::clone()
+    {
+        return std::unique_ptr<Expression>(new PlaceChannelExpression(in, out, place, localScope));
+    }
+
+    bool PlaceChannelExpression::equals(const Expression &other) const
+    {
+        auto otherChannel = dynamic_cast<const PlaceChannelExpression *>(&other);
+        return otherChannel && otherChannel->in == in && otherChannel->out == out;
+    }
+
+    bool PlaceChannelExpression::isMutable() const
+    {
+        return true;
+    }
+
+    void PlaceChannelExpression::put(const Expression &message)
+    {
+        auto copy = copyAcrossPlaces(const_cast<Expression &>(message), nullptr);
+        {
+            std::lock_guard<std::mutex> guard(out->lock);
+            out->messages.push_back(std::move(copy));
+        }
+
+        out->available.notify_one();
+    }
+
+    namespace
+    {
+        /* How long a blocked place operation sleeps between two looks at the waiting thread's budget */
+        const std::chrono::milliseconds budgetCheckInterval(10);
+
+        /* Waits on condition until ready() holds, throwing once the budget of this thread runs out */
+        template<typename Ready>
+        void waitWithinBudget(std::condition_variable &condition, std::unique_lock<std::mutex> &guard, Ready ready)
+        {
+            while (!condition.wait_for(guard, budgetCheckInterval, ready))
+            {
+                guard.unlock();
+                Interpreter::stepBudget().check();
+                guard.lock();
+            }
+        }
+    }
+
+    std::unique_ptr<Expression> PlaceChannelExpression::get(const std::shared_ptr<Scope> &scope)
+    {
+        std::unique_ptr<Expression> message;
+        {
+            std::unique_lock<std::mutex> guard(in->lock);
+            waitWithinBudget(in->available, guard, [this] { return !in->messages.empty() || in->closed; });
+
+            if (in->messages.empty())
+                throw std::invalid_argument("place-channel-get: The other end finished without sending anything");
+
+            message = std::move(in->messages.front());
+            in->messages.pop_front();
+        }
+
+        return copyAcrossPlaces(*message, scope);
+    }
+
+    void PlaceChannelExpression::close()
+    {
+        {
+            std::lock_guard<std::mutex> guard(out->lock);
+            out->closed = true;
+        }
+
+        out->available.notify_all();
+    }
+
+    bool PlaceChannelExpression::isPlace() const
+    {
+        return place != nullptr;
+    }
+
+    int PlaceChannelExpression::wait()
+    {
+        if (!place) throw std::invalid_argument("Expected place, found " + toString());
+
+        std::unique_lock<std::mutex> guard(place->lock);
+        waitWithinBudget(place->finished, guard, [this] { return place->done; });
+
+        return place->exitCode;
+    }
+
+/* Copying */
+
+    std::unique_ptr<Expression> copyAcrossPlaces(Expression &value, const std::shared_ptr<Scope> &scope)
+    {
+        if (dynamic_cast<FunctionExpression *>(&value) || dynamic_cast<FutureExpression *>(&value)
+            || dynamic_cast<PlaceChannelExpression *>(&value))
+            throw std::invalid_argument("Can't send " + value.toString() + " to another place");
+
+        if (auto list = dynamic_cast<ListExpression *>(&value))
+        {
+            std::list<std::unique_ptr<Expression>> elements;
+            for (auto &element : list->list) elements.push_back(copyAcrossPlaces(*element, scope));
+
+            return std::make_unique<ListExpression>(std::move(elements), scope);
+        }
+
+        if (auto structure = dynamic_cast<StructExpression *>(&value))
+        {
+            std::vector<std::unique_ptr<Expression>> fields;
+            for (auto &field : structure->structFields) fields.push_back(copyAcrossPlaces(*field, scope));
+
+            return std::make_unique<StructExpression>(StructExpression(structure->structName, std::move(fields), scope));
+        }
+
+        if (auto vector = dynamic_cast<VectorExpression *>(&value))
+        {
+            std::vector<double> flonums;
+            if (vector->kind() == VectorStorage::Kind::flonum && vector->numbers(flonums))
+                return VectorExpression::fromFlonums(std::move(flonums), scope);
+
+            expression_vector elements;
+            for (auto &element : vector->elements()) elements.push_back(copyAcrossPlaces(*element, scope));
+
+            return VectorExpression::fromElements(std::move(elements), scope);
+        }
+
+        if (auto hash = dynamic_cast<HashExpression *>(&value))
+        {
+            std::unique_ptr<HashExpression> copy(new HashExpression(hash->isMutableTable(), scope));
+
+            hash->forEach([&copy, &scope](Expression &key, Expression &entry)
+                          {
+                              auto keyCopy = copyAcrossPlaces(key, scope), entryCopy = copyAcrossPlaces(entry, scope);
+
+                              if (copy->isMutableTable()) copy->set(std::move(keyCopy), std::move(entryCopy));
+                              else copy = copy->with(std::move(keyCopy), std::move(entryCopy), scope);
+                          });
+
+            return copy;
+        }
+
+        auto copy = value.clone();
+        copy->localScope = scope;
+
+        return copy;
+    }
+}
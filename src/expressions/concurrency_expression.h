@@ -0,0 +1,158 @@
+#ifndef RACKET_INTERPRETER_CONCURRENCY_EXPRESSION_H
+#define RACKET_INTERPRETER_CONCURRENCY_EXPRESSION_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "expressions.h"
+#include "../interpret/budget.h"
+#include "../interpret/thread_pool.h"
+
+namespace Expressions
+{
+    /* The thunk of a future and, once it ran, its result. Shared by every copy of the future. */
+    struct FutureState
+    {
+        enum class Status
+        {
+            pending, running, finished
+        };
+
+        std::mutex lock;
+        std::condition_variable finished;
+        Status status = Status::pending;
+
+        std::unique_ptr<Expression> thunk;
+        std::unique_ptr<Expression> value;
+        std::exception_ptr error;
+
+        /* Alive until the thunk finished, so the heap isn't collected while it may still be in use */
+        std::unique_ptr<Interpreter::BackgroundWork> work;
+
+        /* The budget of the thread that started the future, also cancelled with the future's context */
+        std::unique_ptr<Interpreter::SharedBudget> budget;
+
+        /* Runs the thunk on this thread unless another thread already started it */
+        void run();
+
+        /* Runs the thunk here if no thread started it yet, then waits for it to finish */
+        void join();
+    };
+
+    class FutureExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        bool isMutable() const override;
+
+        void trace(Memory::Tracer &tracer) override;
+
+        /* Waits for the result, running the thunk right here if no worker has picked it up yet */
+        std::unique_ptr<Expression> touch();
+
+        /* Queues the thunk on the shared pool */
+        explicit FutureExpression(std::unique_ptr<Expression> thunk, std::shared_ptr<Scope> scope);
+
+    private:
+        FutureExpression(const FutureExpression &old_expr, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "FutureExpression"), state(old_expr.state)
+        {}
+
+        std::shared_ptr<FutureState> state;
+    };
+
+    /* Messages travelling one way between two places, already copied out of the sender's heap */
+    struct Mailbox
+    {
+        std::mutex lock;
+        std::condition_variable available;
+        std::deque<std::unique_ptr<Expression>> messages;
+
+        /* Set once the sender is gone, after the messages already sent nothing more arrives */
+        bool closed = false;
+    };
+
+    /* The thread of a place and how it ended */
+    struct PlaceState
+    {
+        std::mutex lock;
+        std::condition_variable finished;
+        bool done = false;
+        int exitCode = 0;
+
+        /* The budget of the thread that created the place, also cancelled with the creator's context */
+        std::unique_ptr<Interpreter::SharedBudget> budget;
+
+        /* Waits for the place to finish, however long it takes */
+        void join();
+    };
+
+    /**
+     * One end of a pair of mailboxes. The expression returned by place is both the creator's end of the channel
+     * and the handle to wait on, the place itself gets the other end.
+     */
+    class PlaceChannelExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        bool isMutable() const override;
+
+        /* Copies the message, so nothing of this heap is shared with the receiving place */
+        void put(const Expression &message);
+
+        /**
+         * Waits for a message and copies it into scope. Throws if the other end closed without sending one,
+         * and BudgetExceeded once the waiting thread's deadline passes.
+         */
+        std::unique_ptr<Expression> get(const std::shared_ptr<Scope> &scope);
+
+        /* Tells the other end that nothing more will be sent from this one */
+        void close();
+
+        bool isPlace() const;
+
+        /* Waits for the place to finish and returns its exit code, within the waiting thread's budget like get */
+        int wait();
+
+        PlaceChannelExpression(std::shared_ptr<Mailbox> in, std::shared_ptr<Mailbox> out,
+                               std::shared_ptr<PlaceState> place, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "PlaceChannelExpression"), in(std::move(in)), out(std::move(out)),
+                  place(std::move(place))
+        {}
+
+    private:
+        std::shared_ptr<Mailbox> in, out;
+
+        /* Set on the creator's end only */
+        std::shared_ptr<PlaceState> place;
+    };
+
+    /**
+     * A deep copy of a plain value with every part owned by scope: mutable vectors and hash tables get their own
+     * storage. Throws for procedures and anything else that can't leave the thread that made it.
+     */
+    std::unique_ptr<Expression> copyAcrossPlaces(Expression &value, const std::shared_ptr<Scope> &scope);
+}
+
+#endif //RACKET_INTERPRETER_CONCURRENCY_EXPRESSION_H
@@ -3,30 +3,92 @@
 //
 
 #include "../interpret/parser.h"
+#include "../memory/gc.h"
+#include "../interpret/budget.h"
+#include "../interpret/thread_pool.h"
+
+#include "boost/functional/hash.hpp"
+#include "boost/thread/shared_mutex.hpp"
 
 namespace Expressions
 {
+    /**
+     * Futures evaluate against the global scope while the thread that created them may still define into it.
+     * Global scopes, the ones without a globalScope of their own, are guarded for as long as any future is in
+     * flight. Every other scope belongs to one thread.
+     */
+    boost::shared_mutex globalDefinitionsLock;
+
+    Scope::Scope(std::shared_ptr<Scope> parent)
+    {
+        this->parent = std::move(parent);
+
+        if (this->parent && this->parent->globalScope) this->globalScope = this->parent->globalScope;
+        else this->globalScope = this->parent.get();
+        if (this->parent) this->context = this->parent->context;
+
+        Interpreter::bumpCounter(Interpreter::runtimeCounters().scopeAllocations);
+        Memory::registerScope(this);
+    }
+
+    Scope::Scope(Interpreter::Context &context, std::shared_ptr<Scope> parent)
+            : globalScope(nullptr), parent(std::move(parent)), context(&context)
+    {
+        Interpreter::bumpCounter(Interpreter::runtimeCounters().scopeAllocations);
+        Memory::registerScope(this);
+    }
+
+    Scope::Scope(Scope &&old_scope) noexcept
+    {
+        this->definitions = std::move(old_scope.definitions);
+        this->globalScope = old_scope.globalScope;
+        this->parent = std::move(old_scope.parent);
+        this->context = old_scope.context;
+
+        Memory::registerScope(this);
+    }
+
+    Scope::~Scope()
+    {
+        Memory::unregisterScope(this);
+    }
+
     bool Scope::contains(const std::string &token)
     {
-        return definitions.find(token) != definitions.end()
-               || (parent != nullptr && parent->contains(token));
+        return find(token) != nullptr;
+    }
+
+    Scope *Scope::find(const std::string &key)
+    {
+        for (Scope *scope = this; scope != nullptr; scope = scope->parent.get())
+        {
+            boost::shared_lock<boost::shared_mutex> guard(globalDefinitionsLock, boost::defer_lock);
+            if (!scope->globalScope && Interpreter::BackgroundWork::sharingHeap()) guard.lock();
+
+            if (scope->definitions.find(key) != scope->definitions.end()) return scope;
+        }
+
+        return nullptr;
     }
 
     void Scope::define(const std::string &key, std::unique_ptr<Expressions::Expression> val)
     {
+        boost::unique_lock<boost::shared_mutex> guard(globalDefinitionsLock, boost::defer_lock);
+        if (!globalScope && Interpreter::BackgroundWork::sharingHeap()) guard.lock();
+
         definitions[key] = std::move(val);
     }
 
     std::unique_ptr<Expressions::Expression> Scope::getDefinition(const std::string &key)
     {
-        if (definitions.find(key) != definitions.end())
+        if (Scope *scope = find(key))
         {
+            boost::shared_lock<boost::shared_mutex> guard(globalDefinitionsLock, boost::defer_lock);
+            if (!scope->globalScope && Interpreter::BackgroundWork::sharingHeap()) guard.lock();
+
             // Don't want to give the definition itself, only a copy of it
-            return definitions[key]->clone();
-        }
-        else if (parent != nullptr && parent->contains(key))
-        {
-            return parent->getDefinition(key);
+            Interpreter::bumpCounter(Interpreter::runtimeCounters().clones);
+            return scope->definitions.find(key)->second->clone();
         }
         else throw std::invalid_argument("Key " + key + " not found in scope."); //TODO: replace invalid_argument
     }
@@ -69,7 +131,18 @@ namespace Expressions
 
     std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref)
     {
+        Interpreter::countStep();
+
         auto ref = obj_ref.get();
+
+        if (Profiler::enabled)
+        {
+            Profiler::Activation activation(ref->profileFrame);
+            Profiler::sample();
+
+            return ref->evaluate(std::move(obj_ref));
+        }
+
         return ref->evaluate(std::move(obj_ref));
     }
 
@@ -78,6 +151,41 @@ namespace Expressions
         return this->exprType;
     }
 
+    void Expression::trace(Memory::Tracer &tracer)
+    {
+        tracer.mark(localScope);
+    }
+
+    bool Expression::equals(const Expression &other) const
+    {
+        return toString() == other.toString();
+    }
+
+    size_t Expression::hash() const
+    {
+        return std::hash<std::string>()(toString());
+    }
+
+    bool Expression::isMutable() const
+    {
+        return false;
+    }
+
+    namespace
+    {
+        /* Exact and inexact numbers are equal when their values are, so both hash through a double */
+        size_t hashNumber(double value)
+        {
+            return std::hash<double>()(value);
+        }
+
+        /* The parser takes n/0 as it is, such a rational can only be compared and hashed by its printed form */
+        bool zeroDenominator(const NumericalValueExpression::numerical_type &value)
+        {
+            return mpz_sgn(mpq_denref(value.backend().data())) == 0;
+        }
+    }
+
     /* UnparsedExpression */
 
     bool UnparsedExpression::isValue()
@@ -87,6 +195,7 @@ namespace Expressions
 
     std::unique_ptr<Expression> UnparsedExpression::evaluate(std::unique_ptr<Expressions::Expression> /* obj_ref*/)
     {
+        Profiler::CreationScope creation(profileFrame);
         auto expr = Parser::parse(mContents, localScope);
         return std::move(expr);
     }
@@ -126,6 +235,32 @@ namespace Expressions
         return std::unique_ptr<Expression>(new NumericalValueExpression(*this, this->localScope));
     }
 
+    bool NumericalValueExpression::equals(const Expression &other) const
+    {
+        auto exact = dynamic_cast<const NumericalValueExpression *>(&other);
+        if (zeroDenominator(value) || (exact && zeroDenominator(exact->value)))
+            return exact && toString() == exact->toString();
+
+        if (auto number = dynamic_cast<const NumericalValueExpression *>(&other)) return value == number->value;
+        if (auto inexact = dynamic_cast<const InexactNumberExpression *>(&other))
+            return InexactNumberExpression::numerical_type(value) == inexact->value;
+
+        return false;
+    }
+
+    size_t NumericalValueExpression::hash() const
+    {
+        if (zeroDenominator(value)) return std::hash<std::string>()(toString());
+
+        auto rational = value.backend().data();
+
+        // Integers that fit in a long skip the conversion of the whole rational
+        if (mpz_cmp_ui(mpq_denref(rational), 1) == 0 && mpz_fits_slong_p(mpq_numref(rational)))
+            return hashNumber(static_cast<double>(mpz_get_si(mpq_numref(rational))));
+
+        return hashNumber(mpq_get_d(rational));
+    }
+
     /* InexactNumberExpression */
 
     bool InexactNumberExpression::isValue()
@@ -148,6 +283,19 @@ namespace Expressions
         return std::make_unique<InexactNumberExpression>(InexactNumberExpression(this->value, this->localScope));
     }
 
+    bool InexactNumberExpression::equals(const Expression &other) const
+    {
+        if (auto inexact = dynamic_cast<const InexactNumberExpression *>(&other)) return value == inexact->value;
+        if (auto number = dynamic_cast<const NumericalValueExpression *>(&other)) return number->equals(*this);
+
+        return false;
+    }
+
+    size_t InexactNumberExpression::hash() const
+    {
+        return hashNumber(mpf_get_d(value.backend().data()));
+    }
+
     /* VoidValueExpression */
 
     bool VoidValueExpression::isValue()
@@ -171,6 +319,16 @@ namespace Expressions
         return std::unique_ptr<Expression>(new VoidValueExpression(localScope));
     }
 
+    bool VoidValueExpression::equals(const Expression &other) const
+    {
+        return dynamic_cast<const VoidValueExpression *>(&other) != nullptr;
+    }
+
+    size_t VoidValueExpression::hash() const
+    {
+        return 0;
+    }
+
     /* BooleanValueExpression */
 
     bool BooleanValueExpression::isValue()
@@ -193,6 +351,17 @@ namespace Expressions
         return std::unique_ptr<Expression>(new BooleanValueExpression(this->value, this->localScope));
     }
 
+    bool BooleanValueExpression::equals(const Expression &other) const
+    {
+        auto boolean = dynamic_cast<const BooleanValueExpression *>(&other);
+        return boolean && value == boolean->value;
+    }
+
+    size_t BooleanValueExpression::hash() const
+    {
+        return std::hash<bool>()(value);
+    }
+
     /* SymbolExpression */
 
     bool SymbolExpression::isValue()
@@ -215,6 +384,17 @@ namespace Expressions
         return std::make_unique<SymbolExpression>(SymbolExpression(symbol, localScope));
     }
 
+    bool SymbolExpression::equals(const Expression &other) const
+    {
+        auto sym = dynamic_cast<const SymbolExpression *>(&other);
+        return sym && symbol == sym->symbol;
+    }
+
+    size_t SymbolExpression::hash() const
+    {
+        return std::hash<std::string>()(symbol);
+    }
+
     /* StringExpression */
 
     bool StringExpression::isValue()
@@ -237,6 +417,20 @@ namespace Expressions
         return std::make_unique<StringExpression>(StringExpression(str, localScope));
     }
 
+    bool StringExpression::equals(const Expression &other) const
+    {
+        auto string = dynamic_cast<const StringExpression *>(&other);
+        return string && str == string->str;
+    }
+
+    size_t StringExpression::hash() const
+    {
+        // Offset so a string doesn't collide with the symbol of the same name
+        size_t seed = 1;
+        boost::hash_combine(seed, str);
+        return seed;
+    }
+
     /* CharacterExpression */
 
     bool CharacterExpression::isValue()
@@ -260,4 +454,15 @@ namespace Expressions
     {
         return std::make_unique<CharacterExpression>(CharacterExpression(this->character, localScope));
     }
+
+    bool CharacterExpression::equals(const Expression &other) const
+    {
+        auto chr = dynamic_cast<const CharacterExpression *>(&other);
+        return chr && character == chr->character;
+    }
+
+    size_t CharacterExpression::hash() const
+    {
+        return std::hash<char>()(character);
+    }
 }
@@ -12,10 +12,28 @@
 #include <functional>
 #include <list>
 #include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include "boost/rational.hpp"
 #include "boost/multiprecision/gmp.hpp"
 
+#include "../memory/nursery.h"
+#include "../interpret/profiler.h"
+#include "../interpret/counters.h"
+
+namespace Memory
+{
+    class Tracer;
+
+    struct ScopeRegistry;
+}
+
+namespace Interpreter
+{
+    class Context;
+}
+
 namespace Expressions
 {
     class Expression;
@@ -23,16 +41,24 @@ namespace Expressions
     class Scope
     {
     public:
-        explicit Scope(std::shared_ptr<Scope> parent)
-        {
-            this->parent = std::move(parent);
+        explicit Scope(std::shared_ptr<Scope> parent);
 
-            if (this->parent && this->parent->globalScope) this->globalScope = this->parent->globalScope;
-            else this->globalScope = this->parent.get();
-        }
+        /* The global scope of context, below parent if context is layered over another */
+        explicit Scope(Interpreter::Context &context, std::shared_ptr<Scope> parent = nullptr);
+
+        Scope(Scope &&old_scope) noexcept;
+
+        Scope(const Scope &) = delete;
+
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope();
 
         bool contains(const std::string &);
 
+        /* Returns the innermost scope in the chain that defines the key, or nullptr if none does. */
+        Scope *find(const std::string &);
+
         void define(const std::string &, std::unique_ptr<Expressions::Expression>);
 
         void defineGlobal(const std::string &, std::unique_ptr<Expressions::Expression>);
@@ -47,6 +73,14 @@ namespace Expressions
         std::map<std::string, std::unique_ptr<Expressions::Expression>> definitions;
         Scope *globalScope;
         std::shared_ptr<Scope> parent;
+
+        /* The interpreter this scope belongs to, inherited from the parent. See Interpreter::Context::of */
+        Interpreter::Context *context = nullptr;
+
+        /* Bookkeeping for the collector in memory/gc.cpp */
+        Memory::ScopeRegistry *heapRegistry = nullptr;
+        Scope *heapPrev = nullptr, *heapNext = nullptr;
+        unsigned int markEpoch = 0;
     };
 
     class Expression
@@ -66,17 +100,34 @@ namespace Expressions
 
         virtual std::unique_ptr<Expression> clone() = 0;
 
+        /* Should mark every scope this expression keeps alive, including those of its subexpressions. */
+        virtual void trace(Memory::Tracer &tracer);
+
+        /* Structural equality, as used by equal?. The default compares the printed forms. */
+        virtual bool equals(const Expression &other) const;
+
+        /* Consistent with equals: expressions that are equal have the same hash. */
+        virtual size_t hash() const;
+
+        /* Whether the value, or a value inside of it, can change after it was created. Such values can't be cached. */
+        virtual bool isMutable() const;
+
         friend std::ostream &operator<<(std::ostream &stream, const Expression &expr);
 
         virtual ~Expression() = default;
 
         std::shared_ptr<Scope> localScope;
 
+        /* The function invocation this expression was created by, see interpret/profiler.h */
+        Profiler::FrameId profileFrame = 0;
+
     protected:
         explicit Expression(std::shared_ptr<Scope> scope, const std::string &exprType)
         {
             this->localScope = std::move(scope);
             this->exprType = exprType;
+
+            if (Profiler::enabled) profileFrame = Profiler::currentFrame();
         }
 
     private:
@@ -86,6 +137,12 @@ namespace Expressions
 
     std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression>);
 
+    /* Builds the flat environment for a closure: the free variables bound below the global scope are copied
+     * into a single scope whose parent is the global scope, so the enclosing frames are not retained.
+     * Falls back to the enclosing scope itself if a free variable cannot be resolved yet. */
+    std::shared_ptr<Scope> closureScope(const std::vector<std::string> &freeVariables,
+                                        const std::shared_ptr<Scope> &enclosing);
+
     typedef std::vector<std::unique_ptr<Expression>> expression_vector;
 
     class UnparsedExpression : public Expression
@@ -155,6 +212,8 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        void trace(Memory::Tracer &tracer) override;
+
         explicit TupleExpression(expression_vector tuple, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "TupleExpression")
         {
@@ -187,6 +246,9 @@ namespace Expressions
 
         virtual std::unique_ptr<Expression> call(expression_vector args);
 
+        /* The name the profiler reports calls to this function under */
+        virtual std::string profileLabel() const;
+
         explicit FunctionExpression(std::string funcName,
                                     std::function<std::unique_ptr<Expression>(expression_vector,
                                                                               std::shared_ptr<Scope>)> &func,
@@ -195,6 +257,7 @@ namespace Expressions
         {
             mFuncName = std::move(funcName);
             mFunction = func;
+            mCounterIndex = Interpreter::builtinIndex(mFuncName);
         }
 
     protected:
@@ -204,6 +267,7 @@ namespace Expressions
         bool mSpecialForm = false;
         std::string mFuncName;
         std::function<std::unique_ptr<Expression>(expression_vector, std::shared_ptr<Scope>)> mFunction;
+        size_t mCounterIndex = 0;
 
     private:
         FunctionExpression(const FunctionExpression &old_expr, std::shared_ptr<Scope> scope)
@@ -211,6 +275,7 @@ namespace Expressions
         {
             this->mFuncName = old_expr.mFuncName;
             this->mFunction = old_expr.mFunction;
+            this->mCounterIndex = old_expr.mCounterIndex;
         }
     };
 
@@ -234,6 +299,11 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        std::string profileLabel() const override;
+
+        /* Names the lambda after the variable it was defined as */
+        void setBindingName(const std::string &name);
+
         /* lambda_expr should have "lambda" at front(), and it should have the arg tuple */
         explicit LambdaExpression(std::vector<std::string> lambda_expr,
                                   std::vector<std::string> lambda_args, std::shared_ptr<Scope> scope)
@@ -263,21 +333,107 @@ namespace Expressions
     protected:
         std::vector<std::string> mLambdaArgs;
         std::vector<std::string> mLambdaExpr;
+        std::string mBindingName;
 
-    private:
         LambdaExpression(const LambdaExpression &old_expr, std::shared_ptr<Scope> scope)
                 : FunctionExpression(std::move(scope))
         {
             this->mLambdaArgs = old_expr.mLambdaArgs;
             this->mLambdaExpr = old_expr.mLambdaExpr;
+            this->mBindingName = old_expr.mBindingName;
             this->mFuncName = old_expr.mFuncName;
             this->mFunction = old_expr.mFunction;
         }
     };
 
+    /**
+     * Results of a memoized function, keyed on the structural hash and equality of its arguments.
+     * Holds at most capacity results and evicts the least recently used one first.
+     */
+    class MemoTable
+    {
+    public:
+        explicit MemoTable(size_t capacity) : capacity(capacity)
+        {}
+
+        /* A copy of the cached result, or nullptr on a miss */
+        std::unique_ptr<Expression> lookup(const expression_vector &args);
+
+        /* args should be copies of the arguments the value was computed from */
+        void insert(expression_vector args, std::unique_ptr<Expression> value);
+
+        void trace(Memory::Tracer &tracer);
+
+        size_t hits = 0, misses = 0, evictions = 0;
+
+    private:
+        struct Key
+        {
+            std::vector<const Expression *> args;
+            size_t hash = 0;
+
+            explicit Key(const expression_vector &exprs);
+        };
+
+        struct KeyHash
+        {
+            size_t operator()(const Key *key) const
+            {
+                return key->hash;
+            }
+        };
+
+        struct KeyEqual
+        {
+            bool operator()(const Key *a, const Key *b) const;
+        };
+
+        struct Entry
+        {
+            expression_vector args;
+            Key key;
+            std::unique_ptr<Expression> value;
+
+            Entry(expression_vector args, std::unique_ptr<Expression> value)
+                    : args(std::move(args)), key(this->args), value(std::move(value))
+            {}
+        };
+
+        std::mutex lock;
+        size_t capacity;
+        std::list<Entry> entries;
+        std::unordered_map<const Key *, std::list<Entry>::iterator, KeyHash, KeyEqual> index;
+    };
+
+    /* A lambda whose results are cached, copies share the same table */
+    class MemoizedLambdaExpression : public LambdaExpression
+    {
+    public:
+        std::unique_ptr<Expression> call(expression_vector args) override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        void trace(Memory::Tracer &tracer) override;
+
+        explicit MemoizedLambdaExpression(std::vector<std::string> lambda_expr, std::vector<std::string> lambda_args,
+                                          std::shared_ptr<Scope> scope, size_t capacity)
+                : LambdaExpression(std::move(lambda_expr), std::move(lambda_args), std::move(scope)),
+                  mTable(std::make_shared<MemoTable>(capacity))
+        {}
+
+    private:
+        MemoizedLambdaExpression(const MemoizedLambdaExpression &old_expr, std::shared_ptr<Scope> scope)
+                : LambdaExpression(old_expr, std::move(scope)), mTable(old_expr.mTable)
+        {}
+
+        std::shared_ptr<MemoTable> mTable;
+    };
+
     class NumericalValueExpression : public Expression
     {
     public:
+        NURSERY_ALLOCATED
+
         typedef boost::multiprecision::mpq_rational numerical_type;
 
         numerical_type value;
@@ -290,6 +446,10 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
         explicit NumericalValueExpression(const std::string &str, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "NumericalValueExpression")
         {
@@ -335,6 +495,8 @@ namespace Expressions
     class InexactNumberExpression : public Expression
     {
     public:
+        NURSERY_ALLOCATED
+
         typedef boost::multiprecision::mpf_float numerical_type;
 
         numerical_type value;
@@ -347,6 +509,10 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
         explicit InexactNumberExpression(numerical_type value, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "InexactNumberExpression")
         {
@@ -365,6 +531,10 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
         explicit VoidValueExpression(std::shared_ptr<Scope> scope) : Expression(std::move(scope), "VoidValueExpression")
         {}
     };
@@ -372,6 +542,8 @@ namespace Expressions
     class BooleanValueExpression : public Expression
     {
     public:
+        NURSERY_ALLOCATED
+
         bool value = false;
 
         bool isValue() override;
@@ -382,6 +554,10 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
         explicit BooleanValueExpression(bool val, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "BooleanValueExpression")
         {
@@ -402,6 +578,10 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
         explicit SymbolExpression(const std::string &symbol, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "SymbolExpression")
         {
@@ -422,6 +602,10 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
         explicit StringExpression(const std::string &str, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "StringExpression")
         {
@@ -444,6 +628,14 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        bool isMutable() const override;
+
+        void trace(Memory::Tracer &tracer) override;
+
         explicit StructExpression(const std::string &name, std::vector<std::unique_ptr<Expression>> fields,
                                   std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "StructExpression")
@@ -466,6 +658,14 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        bool isMutable() const override;
+
+        void trace(Memory::Tracer &tracer) override;
+
         explicit ListExpression(std::list<std::unique_ptr<Expression>> list, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "ListExpression")
         {
@@ -486,6 +686,10 @@ namespace Expressions
 
         std::unique_ptr<Expression> clone() override;
 
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
         explicit CharacterExpression(char ch, std::shared_ptr<Scope> scope)
                 : Expression(std::move(scope), "CharacterExpression")
         {
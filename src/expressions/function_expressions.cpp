@@ -4,6 +4,7 @@
 
 #include "expressions.h"
 #include "../interpret/parser.h"
+#include "../functions/functions.h"
 
 namespace Expressions
 {
@@ -33,19 +34,70 @@ namespace Expressions
 
     std::unique_ptr<Expression> FunctionExpression::call(expression_vector args)
     {
+        Interpreter::countBuiltinCall(mCounterIndex);
+
+        if (Profiler::enabled)
+        {
+            Profiler::Activation activation(Profiler::enterCall(profileLabel()));
+            return mFunction(std::move(args), localScope);
+        }
+
         return mFunction(std::move(args), localScope);
     }
 
+    std::string FunctionExpression::profileLabel() const
+    {
+        return mFuncName;
+    }
+
     std::unique_ptr<Expression> FunctionExpression::clone()
     {
         return std::unique_ptr<Expression>(new FunctionExpression(*this, this->localScope));
     }
 
+/* Closures */
+
+    std::shared_ptr<Scope> closureScope(const std::vector<std::string> &freeVariables,
+                                        const std::shared_ptr<Scope> &enclosing)
+    {
+        std::shared_ptr<Scope> global = enclosing;
+        while (global->globalScope) global = global->parent;
+
+        std::shared_ptr<Scope> closure(new Scope(global));
+
+        for (auto &name : freeVariables)
+        {
+            Scope *owner = enclosing->find(name);
+
+            // Globals, this context's or those of a context it is layered over, are still found through global
+            if (owner && !owner->globalScope) continue;
+            else if (owner)
+            {
+                auto captured = owner->getDefinition(name);
+
+                /** Plain values never look at their scope, so they shouldn't keep the enclosing frames alive */
+                if (captured->isValue() && !dynamic_cast<FunctionExpression *>(captured.get()))
+                    captured->localScope = global;
+
+                closure->define(name, std::move(captured));
+            }
+            else if (Functions::functionsFor(global.get()).count(name) == 0
+                     && Functions::specialFormsFor(global.get()).count(name) == 0)
+            {
+                // Not bound yet, e.g. a local function defined after this lambda. Keep the linked chain.
+                return std::make_shared<Scope>(Scope(enclosing));
+            }
+        }
+
+        return closure;
+    }
+
 /* LambdaExpression */
 
     std::unique_ptr<Expression> LambdaExpression::call(expression_vector args)
     {
         if (mLambdaArgs.size() != args.size()) throw std::invalid_argument("Lambda arg parity mismatch");
+        Interpreter::bumpCounter(Interpreter::runtimeCounters().lambdaCalls);
         std::string toParser;
 
         std::shared_ptr<Expressions::Scope> fnScope(new Expressions::Scope(localScope));
@@ -61,6 +113,7 @@ namespace Expressions
             toParser += mLambdaExpr[i];
         }
 
+        Profiler::CreationScope creation(Profiler::enabled ? Profiler::enterCall(profileLabel()) : 0);
         auto expr = Parser::parse(toParser, fnScope);
 
         if (expr->type() == "PartialExpression")
@@ -71,6 +124,16 @@ namespace Expressions
         return expr;
     }
 
+    std::string LambdaExpression::profileLabel() const
+    {
+        return mBindingName.empty() ? mFuncName : mBindingName;
+    }
+
+    void LambdaExpression::setBindingName(const std::string &name)
+    {
+        mBindingName = name;
+    }
+
     std::unique_ptr<Expression> LambdaExpression::clone()
     {
         return std::unique_ptr<Expression>(new LambdaExpression(*this, this->localScope));
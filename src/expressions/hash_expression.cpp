@@ -0,0 +1,564 @@
+#include <algorithm>
+#include <functional>
+
+#include "hash_expression.h"
+#include "../memory/gc.h"
+
+namespace Expressions
+{
+/* MutableHashTable */
+
+    const size_t MutableHashTable::minCapacity;
+    const size_t MutableHashTable::empty;
+    const size_t MutableHashTable::deleted;
+
+    size_t MutableHashTable::slotOf(const Expression &key, size_t hash) const
+    {
+        size_t mask = hashes.size() - 1;
+        size_t stored = storedHash(hash);
+
+        for (size_t i = stored & mask;; i = (i + 1) & mask)
+        {
+            if (hashes[i] == empty) return std::string::npos;
+            if (hashes[i] == stored && keys[i]->equals(key)) return i;
+        }
+    }
+
+    Expression *MutableHashTable::find(const Expression &key) const
+    {
+        size_t slot = slotOf(key, key.hash());
+        return slot == std::string::npos ? nullptr : values[slot].get();
+    }
+
+    void MutableHashTable::set(std::unique_ptr<Expression> key, std::unique_ptr<Expression> value)
+    {
+        size_t hash = key->hash();
+
+        size_t slot = slotOf(*key, hash);
+        if (slot != std::string::npos)
+        {
+            values[slot] = std::move(value);
+            return;
+        }
+
+        // Keep at least a quarter of the slots empty so probes stay short and always end
+        if ((used + 1) * 4 > hashes.size() * 3) grow();
+
+        size_t mask = hashes.size() - 1;
+        size_t stored = storedHash(hash);
+        size_t i = stored & mask;
+
+        while (hashes[i] != empty && hashes[i] != deleted) i = (i + 1) & mask;
+
+        if (hashes[i] == empty) ++used;
+        hashes[i] = stored;
+        keys[i] = std::move(key);
+        values[i] = std::move(value);
+        ++count;
+    }
+
+    bool MutableHashTable::remove(const Expression &key)
+    {
+        size_t slot = slotOf(key, key.hash());
+        if (slot == std::string::npos) return false;
+
+        /** Later entries may have probed past this slot, so it becomes a tombstone instead of empty */
+        hashes[slot] = deleted;
+        keys[slot].reset();
+        values[slot].reset();
+        --count;
+
+        return true;
+    }
+
+    void MutableHashTable::grow()
+    {
+        // Sized for the live entries only, which also clears out the tombstones
+        size_t capacity = minCapacity;
+        while ((count + 1) * 2 > capacity) capacity *= 2;
+
+        std::vector<size_t> oldHashes(capacity, empty);
+        std::vector<std::unique_ptr<Expression>> oldKeys(capacity), oldValues(capacity);
+        oldHashes.swap(hashes);
+        oldKeys.swap(keys);
+        oldValues.swap(values);
+
+        size_t mask = capacity - 1;
+        for (size_t slot = 0; slot < oldHashes.size(); ++slot)
+        {
+            if (oldHashes[slot] == empty || oldHashes[slot] == deleted) continue;
+
+            size_t i = oldHashes[slot] & mask;
+            while (hashes[i] != empty) i = (i + 1) & mask;
+
+            hashes[i] = oldHashes[slot];
+            keys[i] = std::move(oldKeys[slot]);
+            values[i] = std::move(oldValues[slot]);
+        }
+
+        used = count;
+    }
+
+    void MutableHashTable::forEach(const hash_visitor &visitor) const
+    {
+        for (size_t i = 0; i < hashes.size(); ++i)
+        {
+            if (hashes[i] != empty && hashes[i] != deleted) visitor(*keys[i], *values[i]);
+        }
+    }
+
+/* HashTrie */
+
+    namespace
+    {
+        const unsigned int bitsPerLevel = 5;
+        const unsigned int hashBits = sizeof(size_t) * 8;
+
+        struct TrieEntry
+        {
+            size_t hash;
+            std::shared_ptr<Expression> key, value;
+        };
+
+        unsigned int fragment(size_t hash, unsigned int shift)
+        {
+            return (hash >> shift) & ((1u << bitsPerLevel) - 1);
+        }
+
+        unsigned int indexOf(uint32_t bitmap, uint32_t bit)
+        {
+            return __builtin_popcount(bitmap & (bit - 1));
+        }
+    }
+
+    /**
+     * Entries and child nodes are kept in separate arrays, ordered by the hash fragment of this level.
+     * Below the last level every hash bit has been used, so the node just holds the colliding entries.
+     */
+    struct HashTrie::Node
+    {
+        uint32_t entryMap = 0, nodeMap = 0;
+        std::vector<TrieEntry> entries;
+        std::vector<std::shared_ptr<const Node>> nodes;
+    };
+
+    namespace
+    {
+        typedef std::shared_ptr<const HashTrie::Node> node_ptr;
+
+        node_ptr insert(const node_ptr &node, const TrieEntry &entry, unsigned int shift, bool &added)
+        {
+            auto copy = node ? std::make_shared<HashTrie::Node>(*node) : std::make_shared<HashTrie::Node>();
+
+            if (shift >= hashBits)
+            {
+                for (auto &existing : copy->entries)
+                {
+                    if (existing.key->equals(*entry.key))
+                    {
+                        existing.value = entry.value;
+                        return copy;
+                    }
+                }
+
+                copy->entries.push_back(entry);
+                added = true;
+                return copy;
+            }
+
+            uint32_t bit = 1u << fragment(entry.hash, shift);
+
+            if (copy->entryMap & bit)
+            {
+                unsigned int index = indexOf(copy->entryMap, bit);
+                TrieEntry &existing = copy->entries[index];
+
+                if (existing.hash == entry.hash && existing.key->equals(*entry.key))
+                {
+                    existing.value = entry.value;
+                    return copy;
+                }
+
+                /** Two entries share this fragment, they move down into a new node together */
+                bool moved = false;
+                node_ptr child = insert(insert(nullptr, existing, shift + bitsPerLevel, moved),
+                                        entry, shift + bitsPerLevel, added);
+
+                copy->entries.erase(copy->entries.begin() + index);
+                copy->entryMap &= ~bit;
+                copy->nodes.insert(copy->nodes.begin() + indexOf(copy->nodeMap, bit), child);
+                copy->nodeMap |= bit;
+            }
+            else if (copy->nodeMap & bit)
+            {
+                unsigned int index = indexOf(copy->nodeMap, bit);
+                copy->nodes[index] = insert(copy->nodes[index], entry, shift + bitsPerLevel, added);
+            }
+            else
+            {
+                copy->entries.insert(copy->entries.begin() + indexOf(copy->entryMap, bit), entry);
+                copy->entryMap |= bit;
+                added = true;
+            }
+
+            return copy;
+        }
+
+        node_ptr erase(const node_ptr &node, size_t hash, const Expression &key, unsigned int shift, bool &removed)
+        {
+            if (!node) return node;
+
+            if (shift >= hashBits)
+            {
+                for (size_t i = 0; i < node->entries.size(); ++i)
+                {
+                    if (!node->entries[i].key->equals(key)) continue;
+
+                    auto copy = std::make_shared<HashTrie::Node>(*node);
+                    copy->entries.erase(copy->entries.begin() + i);
+                    removed = true;
+                    return copy;
+                }
+
+                return node;
+            }
+
+            uint32_t bit = 1u << fragment(hash, shift);
+
+            if (node->entryMap & bit)
+            {
+                unsigned int index = indexOf(node->entryMap, bit);
+                const TrieEntry &existing = node->entries[index];
+                if (existing.hash != hash || !existing.key->equals(key)) return node;
+
+                auto copy = std::make_shared<HashTrie::Node>(*node);
+                copy->entries.erase(copy->entries.begin() + index);
+                copy->entryMap &= ~bit;
+                removed = true;
+                return copy;
+            }
+            else if (node->nodeMap & bit)
+            {
+                unsigned int index = indexOf(node->nodeMap, bit);
+                node_ptr child = erase(node->nodes[index], hash, key, shift + bitsPerLevel, removed);
+                if (!removed) return node;
+
+                auto copy = std::make_shared<HashTrie::Node>(*node);
+                if (child->entries.empty() && child->nodes.empty())
+                {
+                    copy->nodes.erase(copy->nodes.begin() + index);
+                    copy->nodeMap &= ~bit;
+                }
+                else copy->nodes[index] = child;
+
+                return copy;
+            }
+
+            return node;
+        }
+
+        void visit(const node_ptr &node, const hash_visitor &visitor)
+        {
+            if (!node) return;
+
+            for (auto &entry : node->entries) visitor(*entry.key, *entry.value);
+            for (auto &child : node->nodes) visit(child, visitor);
+        }
+    }
+
+    Expression *HashTrie::find(const Expression &key) const
+    {
+        size_t hash = key.hash();
+        const Node *node = root.get();
+
+        for (unsigned int shift = 0; node; shift += bitsPerLevel)
+        {
+            if (shift >= hashBits)
+            {
+                for (auto &entry : node->entries)
+                    if (entry.key->equals(key)) return entry.value.get();
+
+                return nullptr;
+            }
+
+            uint32_t bit = 1u << fragment(hash, shift);
+
+            if (node->entryMap & bit)
+            {
+                const TrieEntry &entry = node->entries[indexOf(node->entryMap, bit)];
+                return entry.hash == hash && entry.key->equals(key) ? entry.value.get() : nullptr;
+            }
+            else if (node->nodeMap & bit) node = node->nodes[indexOf(node->nodeMap, bit)].get();
+            else return nullptr;
+        }
+
+        return nullptr;
+    }
+
+    HashTrie HashTrie::set(const std::shared_ptr<Expression> &key, const std::shared_ptr<Expression> &value) const
+    {
+        bool added = false;
+
+        HashTrie trie;
+        trie.root = insert(root, TrieEntry{key->hash(), key, value}, 0, added);
+        trie.count = count + (added ? 1 : 0);
+
+        return trie;
+    }
+
+    HashTrie HashTrie::remove(const Expression &key) const
+    {
+        bool removed = false;
+
+        HashTrie trie;
+        trie.root = erase(root, key.hash(), key, 0, removed);
+        trie.count = count - (removed ? 1 : 0);
+
+        return trie;
+    }
+
+    void HashTrie::forEach(const hash_visitor &visitor) const
+    {
+        visit(root, visitor);
+    }
+
+/* HashExpression */
+
+    namespace
+    {
+        /**
+         * Marks a mutable table as being visited by this thread for as long as it is alive, unless it already was.
+         * Doesn't lock the table, so printing or comparing nested tables never holds one table's lock while
+         * waiting for another's.
+         */
+        class VisitGuard
+        {
+        public:
+            explicit VisitGuard(const MutableHashTable *table) : table(table)
+            {
+                if (!table) return;
+
+                cycle = std::find(visiting.begin(), visiting.end(), table) != visiting.end();
+                if (!cycle) visiting.push_back(table);
+            }
+
+            ~VisitGuard()
+            {
+                if (table && !cycle) visiting.pop_back();
+            }
+
+            /* The table is already being visited further up, so it contains itself */
+            bool cycle = false;
+
+        private:
+            const MutableHashTable *table;
+
+            /* The tables this thread is inside of, innermost last */
+            static thread_local std::vector<const MutableHashTable *> visiting;
+        };
+
+        thread_local std::vector<const MutableHashTable *> VisitGuard::visiting;
+    }
+
+    bool HashExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> HashExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string HashExpression::toString() const
+    {
+        std::string constructor = table ? "(make-hash" : "(make-immutable-hash";
+
+        VisitGuard guard(table.get());
+        if (guard.cycle) return constructor + " ...)";
+        if (size() == 0) return constructor + ")";
+
+        std::string rtn = constructor + " (list";
+        forEach([&rtn](Expression &key, Expression &value)
+                {
+                    rtn += " (list " + key.toString() + " " + value.toString() + ")";
+                });
+
+        return rtn + "))";
+    }
+
+    std::unique_ptr<Expression> HashExpression::clone()
+    {
+        return std::unique_ptr<Expression>(new HashExpression(*this, this->localScope));
+    }
+
+    bool HashExpression::equals(const Expression &other) const
+    {
+        auto otherHash = dynamic_cast<const HashExpression *>(&other);
+        if (!otherHash || (table == nullptr) != (otherHash->table == nullptr)) return false;
+        if (table && table == otherHash->table) return true;
+
+        VisitGuard guard(table.get());
+        if (guard.cycle) return false;
+
+        // Pairs up the entries with both tables locked, then compares them with neither locked
+        std::vector<std::pair<std::unique_ptr<Expression>, std::unique_ptr<Expression>>> entries;
+        {
+            // Always in the same order, so two threads comparing the same two tables can't deadlock
+            std::unique_lock<std::recursive_mutex> first, second;
+            if (table)
+            {
+                MutableHashTable *firstTable = table.get(), *secondTable = otherHash->table.get();
+                if (std::less<MutableHashTable *>()(secondTable, firstTable)) std::swap(firstTable, secondTable);
+
+                first = std::unique_lock<std::recursive_mutex>(firstTable->lock);
+                second = std::unique_lock<std::recursive_mutex>(secondTable->lock);
+            }
+
+            if (size() != otherHash->size()) return false;
+
+            bool missing = false;
+            forEach([&entries, &missing, otherHash](Expression &key, Expression &value)
+                    {
+                        auto otherValue = otherHash->lookup(key);
+                        if (otherValue) entries.emplace_back(value.clone(), std::move(otherValue));
+                        else missing = true;
+                    });
+
+            if (missing) return false;
+        }
+
+        for (auto &entry : entries)
+            if (!entry.first->equals(*entry.second)) return false;
+
+        return true;
+    }
+
+    size_t HashExpression::hash() const
+    {
+        VisitGuard guard(table.get());
+        if (guard.cycle) return 0;
+
+        // Summed, so the order the entries are visited in doesn't matter
+        size_t seed = table ? 1 : 0;
+        forEach([&seed](Expression &key, Expression &value)
+                {
+                    seed += key.hash() * 31 + value.hash();
+                });
+
+        return seed;
+    }
+
+    bool HashExpression::isMutable() const
+    {
+        if (table) return true;
+
+        bool mutableEntry = false;
+        trie.forEach([&mutableEntry](Expression &key, Expression &value)
+                     {
+                         mutableEntry = mutableEntry || key.isMutable() || value.isMutable();
+                     });
+
+        return mutableEntry;
+    }
+
+    void HashExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+
+        VisitGuard guard(table.get());
+        if (guard.cycle) return;
+
+        auto mark = [&tracer](Expression &key, Expression &value)
+        {
+            tracer.mark(&key);
+            tracer.mark(&value);
+        };
+
+        if (table)
+        {
+            std::lock_guard<std::recursive_mutex> lock(table->lock);
+            table->forEach(mark);
+        }
+        else trie.forEach(mark);
+    }
+
+    std::unique_ptr<Expression> HashExpression::lookup(const Expression &key) const
+    {
+        if (table)
+        {
+            std::lock_guard<std::recursive_mutex> guard(table->lock);
+
+            Expression *value = table->find(key);
+            return value ? value->clone() : nullptr;
+        }
+
+        Expression *value = trie.find(key);
+        return value ? value->clone() : nullptr;
+    }
+
+    size_t HashExpression::size() const
+    {
+        if (table)
+        {
+            std::lock_guard<std::recursive_mutex> guard(table->lock);
+            return table->size();
+        }
+
+        return trie.size();
+    }
+
+    void HashExpression::forEach(const hash_visitor &visitor) const
+    {
+        if (!table)
+        {
+            trie.forEach(visitor);
+            return;
+        }
+
+        expression_vector keys, values;
+        {
+            std::lock_guard<std::recursive_mutex> guard(table->lock);
+            table->forEach([&keys, &values](Expression &key, Expression &value)
+                           {
+                               keys.push_back(key.clone());
+                               values.push_back(value.clone());
+                           });
+        }
+
+        for (size_t i = 0; i < keys.size(); ++i) visitor(*keys[i], *values[i]);
+    }
+
+    void HashExpression::set(std::unique_ptr<Expression> key, std::unique_ptr<Expression> value)
+    {
+        if (!table) throw std::invalid_argument("Expected a mutable hash, found " + toString());
+
+        std::lock_guard<std::recursive_mutex> guard(table->lock);
+        table->set(std::move(key), std::move(value));
+    }
+
+    bool HashExpression::remove(const Expression &key)
+    {
+        if (!table) throw std::invalid_argument("Expected a mutable hash, found " + toString());
+
+        std::lock_guard<std::recursive_mutex> guard(table->lock);
+        return table->remove(key);
+    }
+
+    std::unique_ptr<HashExpression> HashExpression::with(std::unique_ptr<Expression> key,
+                                                         std::unique_ptr<Expression> value,
+                                                         std::shared_ptr<Scope> scope) const
+    {
+        if (table) throw std::invalid_argument("Expected an immutable hash, found " + toString());
+
+        return std::unique_ptr<HashExpression>(new HashExpression(trie.set(std::move(key), std::move(value)),
+                                                                  std::move(scope)));
+    }
+
+    std::unique_ptr<HashExpression> HashExpression::without(const Expression &key, std::shared_ptr<Scope> scope) const
+    {
+        if (table) throw std::invalid_argument("Expected an immutable hash, found " + toString());
+
+        return std::unique_ptr<HashExpression>(new HashExpression(trie.remove(key), std::move(scope)));
+    }
+}
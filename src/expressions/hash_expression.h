@@ -0,0 +1,158 @@
+#ifndef RACKET_INTERPRETER_HASH_EXPRESSION_H
+#define RACKET_INTERPRETER_HASH_EXPRESSION_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "expressions.h"
+
+namespace Expressions
+{
+    typedef std::function<void(Expression &key, Expression &value)> hash_visitor;
+
+    /**
+     * Open addressing table with linear probing. The hash codes live in their own array, so a probe only
+     * touches the keys whose hash matched. Keys are compared with Expression::equals.
+     */
+    class MutableHashTable
+    {
+    public:
+        MutableHashTable() : hashes(minCapacity, empty), keys(minCapacity), values(minCapacity)
+        {}
+
+        Expression *find(const Expression &key) const;
+
+        void set(std::unique_ptr<Expression> key, std::unique_ptr<Expression> value);
+
+        bool remove(const Expression &key);
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        void forEach(const hash_visitor &visitor) const;
+
+        /* Guards every access, tables are shared between copies and may be shared between threads */
+        std::recursive_mutex lock;
+
+    private:
+        static const size_t minCapacity = 8;
+        static const size_t empty = 0, deleted = 1;
+
+        /* 0 and 1 mark free slots, so hashes are stored with those two values moved out of the way */
+        static size_t storedHash(size_t hash)
+        {
+            return hash < 2 ? hash + 2 : hash;
+        }
+
+        size_t slotOf(const Expression &key, size_t hash) const;
+
+        void grow();
+
+        std::vector<size_t> hashes;
+        std::vector<std::unique_ptr<Expression>> keys, values;
+        size_t count = 0, used = 0;
+    };
+
+    /**
+     * Persistent hash array mapped trie. Updates copy the path to the changed entry and share everything else,
+     * so an immutable hash and the ones derived from it can share most of their nodes.
+     */
+    class HashTrie
+    {
+    public:
+        Expression *find(const Expression &key) const;
+
+        HashTrie set(const std::shared_ptr<Expression> &key, const std::shared_ptr<Expression> &value) const;
+
+        HashTrie remove(const Expression &key) const;
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        void forEach(const hash_visitor &visitor) const;
+
+        struct Node;
+
+    private:
+        std::shared_ptr<const Node> root;
+        size_t count = 0;
+    };
+
+    class HashExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        bool isMutable() const override;
+
+        void trace(Memory::Tracer &tracer) override;
+
+        /* A copy of the value bound to key, or nullptr */
+        std::unique_ptr<Expression> lookup(const Expression &key) const;
+
+        size_t size() const;
+
+        /* Visits a snapshot of the entries, so the visitor may change the table */
+        void forEach(const hash_visitor &visitor) const;
+
+        /* For mutable tables, changes the table every copy shares */
+        void set(std::unique_ptr<Expression> key, std::unique_ptr<Expression> value);
+
+        bool remove(const Expression &key);
+
+        /* For immutable tables, a new table with the change */
+        std::unique_ptr<HashExpression> with(std::unique_ptr<Expression> key, std::unique_ptr<Expression> value,
+                                             std::shared_ptr<Scope> scope) const;
+
+        std::unique_ptr<HashExpression> without(const Expression &key, std::shared_ptr<Scope> scope) const;
+
+        bool isMutableTable() const
+        {
+            return table != nullptr;
+        }
+
+        /* What the copies of a mutable table share, nullptr for immutable ones */
+        const MutableHashTable *sharedTable() const
+        {
+            return table.get();
+        }
+
+        explicit HashExpression(bool mutableTable, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "HashExpression")
+        {
+            if (mutableTable) table = std::make_shared<MutableHashTable>();
+        }
+
+    private:
+        HashExpression(const HashExpression &old_expr, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "HashExpression"), table(old_expr.table), trie(old_expr.trie)
+        {}
+
+        HashExpression(HashTrie trie, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "HashExpression"), trie(std::move(trie))
+        {}
+
+        /* Set for mutable tables, which copies share. Immutable tables use the trie instead. */
+        std::shared_ptr<MutableHashTable> table;
+        HashTrie trie;
+    };
+}
+
+#endif //RACKET_INTERPRETER_HASH_EXPRESSION_H
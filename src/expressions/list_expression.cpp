@@ -3,6 +3,9 @@
 //
 
 #include "expressions.h"
+#include "../memory/gc.h"
+
+#include "boost/functional/hash.hpp"
 
 namespace Expressions
 {
@@ -42,4 +45,45 @@ namespace Expressions
 
         return std::make_unique<ListExpression>(ListExpression(std::move(listClone), localScope));
     }
+
+    bool ListExpression::equals(const Expression &other) const
+    {
+        auto otherList = dynamic_cast<const ListExpression *>(&other);
+        if (!otherList || list.size() != otherList->list.size()) return false;
+
+        auto otherElem = otherList->list.begin();
+        for (auto &elem : list)
+        {
+            if (!elem->equals(**otherElem)) return false;
+            ++otherElem;
+        }
+
+        return true;
+    }
+
+    size_t ListExpression::hash() const
+    {
+        size_t seed = list.size();
+        for (auto &elem : list) boost::hash_combine(seed, elem->hash());
+
+        return seed;
+    }
+
+    bool ListExpression::isMutable() const
+    {
+        for (auto &elem : list)
+            if (elem->isMutable()) return true;
+
+        return false;
+    }
+
+    void ListExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+
+        for (auto &elem : this->list)
+        {
+            tracer.mark(elem.get());
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "boost/functional/hash.hpp"
+
+#include "expressions.h"
+#include "../interpret/interpret.h"
+#include "../memory/gc.h"
+
+namespace Expressions
+{
+/* MemoTable */
+
+    MemoTable::Key::Key(const expression_vector &exprs)
+    {
+        for (auto &expr : exprs)
+        {
+            args.push_back(expr.get());
+            boost::hash_combine(hash, expr->hash());
+        }
+    }
+
+    bool MemoTable::KeyEqual::operator()(const Key *a, const Key *b) const
+    {
+        if (a->hash != b->hash || a->args.size() != b->args.size()) return false;
+
+        for (size_t i = 0; i < a->args.size(); ++i)
+            if (!a->args[i]->equals(*b->args[i])) return false;
+
+        return true;
+    }
+
+    std::unique_ptr<Expression> MemoTable::lookup(const expression_vector &args)
+    {
+        Key key(args);
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto found = index.find(&key);
+        if (found == index.end())
+        {
+            ++misses;
+            return nullptr;
+        }
+
+        ++hits;
+        entries.splice(entries.begin(), entries, found->second);
+        return found->second->value->clone();
+    }
+
+    void MemoTable::insert(expression_vector args, std::unique_ptr<Expression> value)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (capacity == 0) return;
+
+        entries.emplace_front(std::move(args), std::move(value));
+
+        // Another thread may have computed the same result in the meantime
+        if (!index.emplace(&entries.front().key, entries.begin()).second)
+        {
+            entries.pop_front();
+            return;
+        }
+
+        if (entries.size() > capacity)
+        {
+            index.erase(&entries.back().key);
+            entries.pop_back();
+            ++evictions;
+        }
+    }
+
+    void MemoTable::trace(Memory::Tracer &tracer)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        for (auto &entry : entries)
+        {
+            for (auto &arg : entry.args) tracer.mark(arg.get());
+            tracer.mark(entry.value.get());
+        }
+    }
+
+/* MemoizedLambdaExpression */
+
+    namespace
+    {
+        /**
+         * Procedures compare by their source, so two closures over different environments would look equal,
+         * and mutable values may change after the call. Calls with either kind of argument aren't cached.
+         */
+        bool isCacheable(const expression_vector &args)
+        {
+            for (auto &arg : args)
+                if (dynamic_cast<FunctionExpression *>(arg.get()) || arg->isMutable()) return false;
+
+            return true;
+        }
+
+        /* Plain values never look at their scope, so a cached one shouldn't keep the call's frames alive */
+        std::unique_ptr<Expression> detach(const std::unique_ptr<Expression> &value,
+                                           const std::shared_ptr<Scope> &global)
+        {
+            auto copy = value->clone();
+            if (!dynamic_cast<FunctionExpression *>(copy.get())) copy->localScope = global;
+
+            return copy;
+        }
+    }
+
+    std::unique_ptr<Expression> MemoizedLambdaExpression::call(expression_vector args)
+    {
+        if (!isCacheable(args)) return LambdaExpression::call(std::move(args));
+
+        if (auto cached = mTable->lookup(args)) return cached;
+
+        std::shared_ptr<Scope> global = localScope;
+        while (global->globalScope) global = global->parent;
+
+        expression_vector key;
+        for (auto &arg : args) key.push_back(detach(arg, global));
+
+        auto value = Interpreter::interpret(LambdaExpression::call(std::move(args)));
+
+        // A mutable result, such as a fresh vector or hash table, would be shared by every later caller
+        if (!value->isMutable()) mTable->insert(std::move(key), detach(value, global));
+
+        return value;
+    }
+
+    std::unique_ptr<Expression> MemoizedLambdaExpression::clone()
+    {
+        return std::unique_ptr<Expression>(new MemoizedLambdaExpression(*this, this->localScope));
+    }
+
+    void MemoizedLambdaExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+        mTable->trace(tracer);
+    }
+}
@@ -17,17 +17,19 @@ namespace Expressions
     std::unique_ptr<Expression>
     PartialExpression::evaluate(std::unique_ptr<Expression> /* obj_ref */)
     {
+        Profiler::CreationScope creation(profileFrame);
         Expressions::expression_vector members;
 
         if (mTupleMembers.front() == "lambda")
         {
             /** This parses the tuple containing the parameters of the lambda */
             std::vector<std::string> params = Parser::parseTuple(mTupleMembers.at(1));
-            std::shared_ptr<Expressions::Scope> lambdaScope(new Expressions::Scope(this->localScope));
+            std::shared_ptr<Expressions::Scope> lambdaScope = closureScope(Parser::freeVariables(mTupleMembers),
+                                                                           this->localScope);
 
             return std::unique_ptr<Expression>(new LambdaExpression(mTupleMembers, params, std::move(lambdaScope)));
         }
-        else if (Functions::specialFormMap.find(mTupleMembers.front()) != Functions::specialFormMap.end())
+        else if (Functions::specialFormsFor(localScope.get()).count(mTupleMembers.front()) > 0)
         {
             /** We want to give the special form an unevaluated TupleExpression */
 
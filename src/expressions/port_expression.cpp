@@ -0,0 +1,375 @@
+#include <fstream>
+
+#include "port_expression.h"
+#include "../interpret/mapped_file.h"
+
+namespace Expressions
+{
+    namespace
+    {
+        /* File ports read and write in blocks of this size */
+        const size_t fileBufferSize = 1u << 16u;
+
+        bool isDelimiter(int chr)
+        {
+            return std::isspace(chr) || chr == '(' || chr == ')' || chr == '[' || chr == ']' || chr == '"'
+                   || chr == ';';
+        }
+
+        int next(std::istream &in)
+        {
+            int chr = in.get();
+            if (chr == EOF) throw std::invalid_argument("read: Unexpected end of input");
+
+            return chr;
+        }
+
+        /* Skips whitespace and line comments, false if nothing else is left */
+        bool skipAtmosphere(std::istream &in)
+        {
+            while (true)
+            {
+                int chr = in.peek();
+                if (chr == EOF) return false;
+
+                if (chr == ';')
+                {
+                    while (chr != EOF && chr != '\n') chr = in.get();
+                }
+                else if (std::isspace(chr)) in.get();
+                else return true;
+            }
+        }
+
+        void readString(std::istream &in, std::string &datum)
+        {
+            datum.push_back(static_cast<char>(next(in)));
+
+            while (true)
+            {
+                int chr = next(in);
+                datum.push_back(static_cast<char>(chr));
+
+                if (chr == '\\') datum.push_back(static_cast<char>(next(in)));
+                else if (chr == '"') return;
+            }
+        }
+
+        void readAtom(std::istream &in, std::string &datum)
+        {
+            // A character literal's character is taken as is, even if it is a delimiter
+            if (in.peek() == '#')
+            {
+                datum.push_back(static_cast<char>(in.get()));
+                if (in.peek() == '\\')
+                {
+                    datum.push_back(static_cast<char>(in.get()));
+                    datum.push_back(static_cast<char>(next(in)));
+                }
+            }
+
+            while (in.peek() != EOF && !isDelimiter(in.peek())) datum.push_back(static_cast<char>(in.get()));
+        }
+
+        void readForm(std::istream &in, std::string &datum)
+        {
+            int chr = in.peek();
+
+            if (chr == '\'' || chr == '`')
+            {
+                datum.push_back(static_cast<char>(in.get()));
+                if (!skipAtmosphere(in)) throw std::invalid_argument("read: Unexpected end of input");
+
+                readForm(in, datum);
+            }
+            else if (chr == '(' || chr == '[')
+            {
+                // Brackets are read as parentheses, the parser only takes quoted lists in parentheses
+                in.get();
+                datum.push_back('(');
+
+                while (true)
+                {
+                    if (!skipAtmosphere(in)) throw std::invalid_argument("read: Unexpected end of input");
+
+                    if (in.peek() == ')' || in.peek() == ']')
+                    {
+                        in.get();
+                        datum.push_back(')');
+                        return;
+                    }
+
+                    if (datum.back() != '(') datum.push_back(' ');
+                    readForm(in, datum);
+                }
+            }
+            else if (chr == ')' || chr == ']')
+            {
+                in.get();
+                throw std::invalid_argument(std::string("read: Unexpected ") + static_cast<char>(chr));
+            }
+            else if (chr == '"') readString(in, datum);
+            else readAtom(in, datum);
+        }
+    }
+
+    /* PortState */
+
+    std::string PortState::toString() const
+    {
+        std::string kind = input ? "input-port" : "output-port";
+        return "#<" + kind + ":" + name + ">";
+    }
+
+    bool PortState::isClosed()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return closed;
+    }
+
+    void PortState::close()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (closed) return;
+
+        if (output) output->flush();
+        closed = true;
+
+        // String ports keep their stream, get-output-string still works after closing them
+        if (auto file = dynamic_cast<std::ofstream *>(ownedOutput.get())) file->close();
+        if (auto file = dynamic_cast<std::ifstream *>(ownedInput.get())) file->close();
+    }
+
+    std::istream &PortState::in()
+    {
+        if (!input) throw std::invalid_argument("Expected input port, found " + toString());
+        if (closed) throw std::invalid_argument("Port is closed: " + toString());
+
+        return *input;
+    }
+
+    std::ostream &PortState::out()
+    {
+        if (!output) throw std::invalid_argument("Expected output port, found " + toString());
+        if (closed) throw std::invalid_argument("Port is closed: " + toString());
+
+        return *output;
+    }
+
+    bool PortState::readLine(std::string &line)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::istream &stream = in();
+
+        if (stream.peek() == EOF) return false;
+
+        std::getline(stream, line);
+        return true;
+    }
+
+    int PortState::readChar()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return in().get();
+    }
+
+    int PortState::peekChar()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return in().peek();
+    }
+
+    bool PortState::readDatum(std::string &datum)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::istream &stream = in();
+
+        datum.clear();
+        if (!skipAtmosphere(stream)) return false;
+
+        readForm(stream, datum);
+        return true;
+    }
+
+    void PortState::write(const std::string &text)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        out() << text;
+    }
+
+    void PortState::flush()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        out().flush();
+    }
+
+    std::string PortState::outputString()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        auto str = dynamic_cast<std::ostringstream *>(ownedOutput.get());
+        if (!str) throw std::invalid_argument("Expected string output port, found " + toString());
+
+        return str->str();
+    }
+
+    /* PortExpression */
+
+    bool PortExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> PortExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string PortExpression::toString() const
+    {
+        return state->toString();
+    }
+
+    std::unique_ptr<Expression> PortExpression::clone()
+    {
+        return std::make_unique<PortExpression>(state, localScope);
+    }
+
+    bool PortExpression::equals(const Expression &other) const
+    {
+        auto port = dynamic_cast<const PortExpression *>(&other);
+        return port && port->state == state;
+    }
+
+    size_t PortExpression::hash() const
+    {
+        return std::hash<PortState *>()(state.get());
+    }
+
+    bool PortExpression::isMutable() const
+    {
+        return true;
+    }
+
+    bool PortExpression::isInput() const
+    {
+        return state->input != nullptr;
+    }
+
+    bool PortExpression::isOutput() const
+    {
+        return state->output != nullptr;
+    }
+
+    std::unique_ptr<PortExpression> PortExpression::openInputFile(const std::string &path, std::shared_ptr<Scope> scope)
+    {
+        auto state = std::make_shared<PortState>();
+        state->name = path;
+        state->buffer.reset(new char[fileBufferSize]);
+
+        auto file = std::make_unique<std::ifstream>();
+        file->rdbuf()->pubsetbuf(state->buffer.get(), fileBufferSize);
+        file->open(path, std::ios::binary);
+        if (!file->is_open()) throw std::invalid_argument("Cannot open input file: " + path);
+
+        state->input = file.get();
+        state->ownedInput = std::move(file);
+
+        return std::make_unique<PortExpression>(std::move(state), std::move(scope));
+    }
+
+    std::unique_ptr<PortExpression> PortExpression::openMappedFile(const std::string &path,
+                                                                   std::shared_ptr<Scope> scope)
+    {
+        auto file = std::make_unique<Interpreter::MappedInputStream>(path);
+        if (!file->isOpen()) return openInputFile(path, std::move(scope));
+
+        auto state = std::make_shared<PortState>();
+        state->name = path;
+        state->input = file.get();
+        state->ownedInput = std::move(file);
+
+        return std::make_unique<PortExpression>(std::move(state), std::move(scope));
+    }
+
+    std::unique_ptr<PortExpression> PortExpression::openOutputFile(const std::string &path, bool append,
+                                                                   std::shared_ptr<Scope> scope)
+    {
+        auto state = std::make_shared<PortState>();
+        state->name = path;
+        state->buffer.reset(new char[fileBufferSize]);
+
+        auto file = std::make_unique<std::ofstream>();
+        file->rdbuf()->pubsetbuf(state->buffer.get(), fileBufferSize);
+        file->open(path, std::ios::binary | (append ? std::ios::app : std::ios::trunc));
+        if (!file->is_open()) throw std::invalid_argument("Cannot open output file: " + path);
+
+        state->output = file.get();
+        state->ownedOutput = std::move(file);
+
+        return std::make_unique<PortExpression>(std::move(state), std::move(scope));
+    }
+
+    std::unique_ptr<PortExpression> PortExpression::inputString(const std::string &str, std::shared_ptr<Scope> scope)
+    {
+        auto state = std::make_shared<PortState>();
+        state->name = "string";
+        state->ownedInput = std::make_unique<std::istringstream>(str);
+        state->input = state->ownedInput.get();
+
+        return std::make_unique<PortExpression>(std::move(state), std::move(scope));
+    }
+
+    std::unique_ptr<PortExpression> PortExpression::outputString(std::shared_ptr<Scope> scope)
+    {
+        auto state = std::make_shared<PortState>();
+        state->name = "string";
+        state->ownedOutput = std::make_unique<std::ostringstream>();
+        state->output = state->ownedOutput.get();
+
+        return std::make_unique<PortExpression>(std::move(state), std::move(scope));
+    }
+
+    std::unique_ptr<PortExpression> PortExpression::wrap(std::istream *input, std::ostream *output,
+                                                         const std::string &name, std::shared_ptr<Scope> scope)
+    {
+        auto state = std::make_shared<PortState>();
+        state->name = name;
+        state->input = input;
+        state->output = output;
+
+        return std::make_unique<PortExpression>(std::move(state), std::move(scope));
+    }
+
+    /* EofExpression */
+
+    bool EofExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> EofExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string EofExpression::toString() const
+    {
+        return "#<eof>";
+    }
+
+    std::unique_ptr<Expression> EofExpression::clone()
+    {
+        return std::make_unique<EofExpression>(localScope);
+    }
+
+    bool EofExpression::equals(const Expression &other) const
+    {
+        return dynamic_cast<const EofExpression *>(&other) != nullptr;
+    }
+
+    size_t EofExpression::hash() const
+    {
+        return 0x0e0f;
+    }
+}
@@ -0,0 +1,147 @@
+#ifndef RACKET_INTERPRETER_PORT_EXPRESSION_H
+#define RACKET_INTERPRETER_PORT_EXPRESSION_H
+
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <utility>
+
+#include "expressions.h"
+
+namespace Expressions
+{
+    /**
+     * The stream behind a port, shared by every copy of the port. Ports made for files and strings own their
+     * stream, the ones standing for stdin or the current output only point at it.
+     */
+    struct PortState
+    {
+        std::string name;
+
+        std::istream *input = nullptr;
+        std::ostream *output = nullptr;
+
+        std::unique_ptr<std::istream> ownedInput;
+        std::unique_ptr<std::ostream> ownedOutput;
+
+        /* The buffer of a file stream, larger than the standard library's default */
+        std::unique_ptr<char[]> buffer;
+
+        bool closed = false;
+
+        /* Guards every access, ports are shared between copies and may be shared between threads */
+        std::mutex lock;
+
+        std::string toString() const;
+
+        bool isClosed();
+
+        /* Flushes an output port, then lets go of the stream if the port owns it. Closing twice does nothing. */
+        void close();
+
+        /* The next line without its line feed, false at the end of the input */
+        bool readLine(std::string &line);
+
+        /* The next character, or EOF at the end of the input */
+        int readChar();
+
+        int peekChar();
+
+        /**
+         * The text of the next datum: a parenthesized or bracketed form, a string, or an atom, with any quote
+         * prefix. Skips whitespace and comments before it and within it, and turns brackets into parentheses.
+         * False at the end of the input, throws if it ends within the datum.
+         */
+        bool readDatum(std::string &datum);
+
+        void write(const std::string &text);
+
+        void flush();
+
+        /* Everything written to a string port so far */
+        std::string outputString();
+
+        /* Runs read on the input stream with the lock held, for readers that work on the stream directly */
+        template<typename Reader>
+        auto readWith(Reader read) -> decltype(read(std::declval<std::istream &>()))
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            return read(in());
+        }
+
+    private:
+        /* The streams to read from and write to, throw if there is none or the port is closed. The lock has to be
+         * held. */
+        std::istream &in();
+
+        std::ostream &out();
+    };
+
+    class PortExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        bool isMutable() const override;
+
+        bool isInput() const;
+
+        bool isOutput() const;
+
+        static std::unique_ptr<PortExpression> openInputFile(const std::string &path, std::shared_ptr<Scope> scope);
+
+        /* Reads a regular file through a memory mapping, anything that can't be mapped like openInputFile does */
+        static std::unique_ptr<PortExpression> openMappedFile(const std::string &path, std::shared_ptr<Scope> scope);
+
+        static std::unique_ptr<PortExpression> openOutputFile(const std::string &path, bool append,
+                                                              std::shared_ptr<Scope> scope);
+
+        static std::unique_ptr<PortExpression> inputString(const std::string &str, std::shared_ptr<Scope> scope);
+
+        static std::unique_ptr<PortExpression> outputString(std::shared_ptr<Scope> scope);
+
+        /* A port reading from or writing to a stream owned elsewhere, which has to outlive it */
+        static std::unique_ptr<PortExpression> wrap(std::istream *input, std::ostream *output, const std::string &name,
+                                                    std::shared_ptr<Scope> scope);
+
+        explicit PortExpression(std::shared_ptr<PortState> state, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "PortExpression"), state(std::move(state))
+        {}
+
+        std::shared_ptr<PortState> state;
+    };
+
+    /* What the read functions return at the end of their input */
+    class EofExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        explicit EofExpression(std::shared_ptr<Scope> scope) : Expression(std::move(scope), "EofExpression")
+        {}
+    };
+}
+
+#endif //RACKET_INTERPRETER_PORT_EXPRESSION_H
@@ -0,0 +1,248 @@
+#include "promise_expression.h"
+#include "../interpret/interpret.h"
+#include "../memory/gc.h"
+
+namespace Expressions
+{
+    namespace
+    {
+        /* Marks what the promise computes from, the lock has to be held */
+        void traceSources(PromiseState &state, Memory::Tracer &tracer)
+        {
+            tracer.mark(state.thunk.get());
+            for (auto &operand : state.operands) tracer.mark(operand.get());
+            tracer.mark(state.scope);
+        }
+
+        /* Traces a stream's rest promise, except for a next cell, which it returns for the caller to go on with */
+        StreamExpression *traceRest(PromiseState &state, Memory::Tracer &tracer)
+        {
+            if (!tracer.firstVisit(state.markEpoch)) return nullptr;
+
+            std::lock_guard<std::mutex> guard(state.lock);
+            traceSources(state, tracer);
+
+            auto next = dynamic_cast<StreamExpression *>(state.value.get());
+            if (next) tracer.mark(next->localScope);
+            else tracer.mark(state.value.get());
+
+            return next;
+        }
+    }
+
+/* PromiseState */
+
+    PromiseState::~PromiseState()
+    {
+        std::unique_ptr<Expression> next = std::move(value);
+
+        while (auto cell = dynamic_cast<StreamExpression *>(next.get()))
+        {
+            if (cell->rest.use_count() != 1) break;
+
+            std::unique_ptr<Expression> after = std::move(cell->rest->value);
+            next = std::move(after);
+        }
+    }
+
+    std::unique_ptr<Expression> PromiseState::force()
+    {
+        std::unique_ptr<Expression> toRun;
+        step_function toStep;
+        expression_vector stepOperands;
+        std::shared_ptr<Scope> stepScope;
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (status == Status::running && runner == std::this_thread::get_id())
+                throw std::invalid_argument("force: Reentrant promise");
+
+            finished.wait(guard, [this] { return status != Status::running; });
+
+            if (status == Status::forced)
+            {
+                if (error) std::rethrow_exception(error);
+                return value->clone();
+            }
+
+            status = Status::running;
+            runner = std::this_thread::get_id();
+
+            toRun = std::move(thunk);
+            toStep = std::move(step);
+            stepOperands = std::move(operands);
+            stepScope = std::move(scope);
+        }
+
+        std::unique_ptr<Expression> result;
+        std::exception_ptr failure;
+
+        try
+        {
+            if (toRun)
+            {
+                auto function = dynamic_cast<FunctionExpression *>(toRun.get());
+                result = Interpreter::interpret(function->call(expression_vector()));
+            }
+            else result = toStep(stepOperands, stepScope);
+        }
+        catch (...)
+        {
+            failure = std::current_exception();
+        }
+
+        // What the value was computed from can go, only the value is needed from now on
+        toRun.reset();
+        stepOperands.clear();
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            value = std::move(result);
+            error = failure;
+            status = Status::forced;
+        }
+
+        finished.notify_all();
+
+        if (failure) std::rethrow_exception(failure);
+        return value->clone();
+    }
+
+    bool PromiseState::isForced()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return status == Status::forced;
+    }
+
+    void PromiseState::trace(Memory::Tracer &tracer)
+    {
+        if (!tracer.firstVisit(markEpoch)) return;
+
+        std::lock_guard<std::mutex> guard(lock);
+        traceSources(*this, tracer);
+        tracer.mark(value.get());
+    }
+
+    std::shared_ptr<PromiseState> PromiseState::ofValue(std::unique_ptr<Expression> value)
+    {
+        auto state = std::make_shared<PromiseState>();
+        state->value = std::move(value);
+        state->status = Status::forced;
+
+        return state;
+    }
+
+    std::shared_ptr<PromiseState> PromiseState::ofThunk(std::unique_ptr<Expression> thunk)
+    {
+        if (!dynamic_cast<FunctionExpression *>(thunk.get()))
+            throw std::invalid_argument("Expected function, found " + thunk->toString());
+
+        auto state = std::make_shared<PromiseState>();
+        state->thunk = std::move(thunk);
+
+        return state;
+    }
+
+    std::shared_ptr<PromiseState> PromiseState::ofStep(step_function step, expression_vector operands,
+                                                       std::shared_ptr<Scope> scope)
+    {
+        auto state = std::make_shared<PromiseState>();
+        state->step = std::move(step);
+        state->operands = std::move(operands);
+        state->scope = std::move(scope);
+
+        return state;
+    }
+
+/* PromiseExpression */
+
+    bool PromiseExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> PromiseExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string PromiseExpression::toString() const
+    {
+        return "#<promise>";
+    }
+
+    std::unique_ptr<Expression> PromiseExpression::clone()
+    {
+        return std::make_unique<PromiseExpression>(state, localScope);
+    }
+
+    bool PromiseExpression::equals(const Expression &other) const
+    {
+        auto promise = dynamic_cast<const PromiseExpression *>(&other);
+        return promise && promise->state == state;
+    }
+
+    size_t PromiseExpression::hash() const
+    {
+        return std::hash<PromiseState *>()(state.get());
+    }
+
+    bool PromiseExpression::isMutable() const
+    {
+        return true;
+    }
+
+    void PromiseExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+        state->trace(tracer);
+    }
+
+/* StreamExpression */
+
+    bool StreamExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> StreamExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string StreamExpression::toString() const
+    {
+        return "#<stream>";
+    }
+
+    std::unique_ptr<Expression> StreamExpression::clone()
+    {
+        return std::make_unique<StreamExpression>(first, rest, localScope);
+    }
+
+    bool StreamExpression::equals(const Expression &other) const
+    {
+        auto stream = dynamic_cast<const StreamExpression *>(&other);
+        return stream && stream->first == first && stream->rest == rest;
+    }
+
+    size_t StreamExpression::hash() const
+    {
+        return std::hash<PromiseState *>()(first.get()) ^ std::hash<PromiseState *>()(rest.get());
+    }
+
+    bool StreamExpression::isMutable() const
+    {
+        return true;
+    }
+
+    void StreamExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+
+        for (StreamExpression *cell = this; cell; cell = traceRest(*cell->rest, tracer))
+        {
+            cell->first->trace(tracer);
+        }
+    }
+}
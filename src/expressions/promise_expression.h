@@ -0,0 +1,127 @@
+#ifndef RACKET_INTERPRETER_PROMISE_EXPRESSION_H
+#define RACKET_INTERPRETER_PROMISE_EXPRESSION_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "expressions.h"
+
+namespace Expressions
+{
+    /**
+     * What a promise computes and, once forced, its value. Shared by every copy of the promise, so forcing any of
+     * them forces all of them. The value comes either from a procedure of no arguments or, for promises made by
+     * builtins, from a step function over a few operands.
+     */
+    struct PromiseState
+    {
+        typedef std::function<std::unique_ptr<Expression>(expression_vector &operands,
+                                                          const std::shared_ptr<Scope> &scope)> step_function;
+
+        enum class Status
+        {
+            pending, running, forced
+        };
+
+        std::mutex lock;
+        std::condition_variable finished;
+        Status status = Status::pending;
+        std::thread::id runner;
+
+        std::unique_ptr<Expression> thunk;
+
+        step_function step;
+        expression_vector operands;
+        std::shared_ptr<Scope> scope;
+
+        std::unique_ptr<Expression> value;
+        std::exception_ptr error;
+
+        unsigned int markEpoch = 0;
+
+        /* Unlinks a forced stream cell by cell, dropping a long one must not recurse once per cell */
+        ~PromiseState();
+
+        /**
+         * The value, computed on the first call only. Every later call, from any thread, gets a copy of the same
+         * value, or the same error again if computing it failed. Waits if another thread is computing it, throws
+         * if this thread already is.
+         */
+        std::unique_ptr<Expression> force();
+
+        bool isForced();
+
+        void trace(Memory::Tracer &tracer);
+
+        static std::shared_ptr<PromiseState> ofValue(std::unique_ptr<Expression> value);
+
+        static std::shared_ptr<PromiseState> ofThunk(std::unique_ptr<Expression> thunk);
+
+        static std::shared_ptr<PromiseState> ofStep(step_function step, expression_vector operands,
+                                                    std::shared_ptr<Scope> scope);
+    };
+
+    class PromiseExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        bool isMutable() const override;
+
+        void trace(Memory::Tracer &tracer) override;
+
+        PromiseExpression(std::shared_ptr<PromiseState> state, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "PromiseExpression"), state(std::move(state))
+        {}
+
+        std::shared_ptr<PromiseState> state;
+    };
+
+    /**
+     * A non-empty stream: a promise of its first element and a promise of the stream after it. The empty stream
+     * is the empty list, and lists work as streams everywhere.
+     */
+    class StreamExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        bool isMutable() const override;
+
+        /* Follows the forced part of the stream in a loop rather than recursively */
+        void trace(Memory::Tracer &tracer) override;
+
+        StreamExpression(std::shared_ptr<PromiseState> first, std::shared_ptr<PromiseState> rest,
+                         std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "StreamExpression"), first(std::move(first)), rest(std::move(rest))
+        {}
+
+        std::shared_ptr<PromiseState> first, rest;
+    };
+}
+
+#endif //RACKET_INTERPRETER_PROMISE_EXPRESSION_H
@@ -5,6 +5,11 @@
 #include "../functions/functions.h"
 #include "../interpret/parser.h"
 #include "struct_expression.h"
+#include "../memory/gc.h"
+#include "../interpret/context.h"
+#include "../interpret/thread_pool.h"
+
+#include "boost/functional/hash.hpp"
 
 typedef std::unique_ptr<Expressions::Expression> expr_ptr;
 typedef std::shared_ptr<Expressions::Scope> scope_ptr;
@@ -49,6 +54,45 @@ namespace Expressions
         return std::make_unique<StructExpression>
                 (StructExpression(this->structName, std::move(fieldClone), this->localScope));
     }
+
+    bool StructExpression::equals(const Expression &other) const
+    {
+        auto otherStruct = dynamic_cast<const StructExpression *>(&other);
+        if (!otherStruct || structName != otherStruct->structName
+            || structFields.size() != otherStruct->structFields.size())
+            return false;
+
+        for (size_t i = 0; i < structFields.size(); ++i)
+            if (!structFields[i]->equals(*otherStruct->structFields[i])) return false;
+
+        return true;
+    }
+
+    size_t StructExpression::hash() const
+    {
+        size_t seed = std::hash<std::string>()(structName);
+        for (auto &field : structFields) boost::hash_combine(seed, field->hash());
+
+        return seed;
+    }
+
+    bool StructExpression::isMutable() const
+    {
+        for (auto &field : structFields)
+            if (field->isMutable()) return true;
+
+        return false;
+    }
+
+    void StructExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+
+        for (auto &field : this->structFields)
+        {
+            tracer.mark(field.get());
+        }
+    }
 }
 
 namespace StructFunctions
@@ -108,17 +152,18 @@ namespace StructFunctions
         };
     }
 
-    void defineStruct(const std::string &structName, const std::vector<std::string> &structFields)
+    void addStructFunctions(Functions::builtin_table &table, const std::string &structName,
+                            const std::vector<std::string> &structFields)
     {
-        Functions::funcMap["make-" + structName] = makeStructFn(structName, structFields.size());
-        Functions::funcMap[structName + "?"] = structPredicateFn(structName);
+        table["make-" + structName] = makeStructFn(structName, structFields.size());
+        table[structName + "?"] = structPredicateFn(structName);
 
         int fieldCount = 0;
         for (auto &fieldName : structFields)
         {
             std::stringstream getterName;
             getterName << structName << "-" << fieldName;
-            Functions::funcMap[getterName.str()] = getStructFieldFn(structName, fieldCount);
+            table[getterName.str()] = getStructFieldFn(structName, fieldCount);
             ++fieldCount;
         }
     }
@@ -131,7 +176,11 @@ namespace StructFunctions
         std::string structFieldTuple = args[1]->toString();
         std::vector<std::string> structFields = Parser::parseTuple(structFieldTuple);
 
-        defineStruct(structName, structFields);
+        /** Other threads read the builtins without locking while a parallel loop or a future runs */
+        if (Interpreter::ThreadPool::inParallel())
+            throw std::invalid_argument("define-struct: Can't define " + structName + " while running in parallel");
+
+        Interpreter::Context::of(*scope).defineStruct(structName, structFields);
 
         return std::make_unique<Expressions::VoidValueExpression>
                 (Expressions::VoidValueExpression(std::move(scope)));
@@ -8,9 +8,13 @@
 #include <string>
 #include <vector>
 
+#include "../functions/functions.h"
+
 namespace StructFunctions
 {
-    void defineStruct(const std::string &structName, const std::vector<std::string> &structFields);
+    /* Adds make-<name>, <name>? and a getter for every field to table */
+    void addStructFunctions(Functions::builtin_table &table, const std::string &structName,
+                            const std::vector<std::string> &structFields);
 }
 
 #endif //RACKET_INTERPRETER_STRUCT_EXPRESSION_H
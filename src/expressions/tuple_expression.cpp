@@ -4,6 +4,7 @@
 
 #include "expressions.h"
 #include "../interpret/parser.h"
+#include "../memory/gc.h"
 
 namespace Expressions
 {
@@ -54,4 +55,14 @@ namespace Expressions
     {
         return std::unique_ptr<Expression>(new TupleExpression(*this, this->localScope));
     }
+
+    void TupleExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+
+        for (auto &expr : mTupleMembers)
+        {
+            tracer.mark(expr.get());
+        }
+    }
 }
\ No newline at end of file
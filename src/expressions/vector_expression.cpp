@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+#include "boost/functional/hash.hpp"
+
+#include "vector_expression.h"
+#include "../memory/gc.h"
+
+namespace Expressions
+{
+/* VectorStorage */
+
+    size_t VectorStorage::size() const
+    {
+        switch (kind)
+        {
+            case Kind::fixnum:
+                return fixnums.size();
+            case Kind::flonum:
+                return flonums.size();
+            default:
+                return boxed.size();
+        }
+    }
+
+/* VectorExpression */
+
+    namespace
+    {
+        /**
+         * Marks a vector as being visited by this thread for as long as it is alive, unless it already was.
+         * Doesn't lock the storage, so walking nested vectors never holds one vector's lock while waiting for
+         * another's.
+         */
+        class VisitGuard
+        {
+        public:
+            explicit VisitGuard(const VectorStorage &storage) : storage(storage)
+            {
+                cycle = std::find(visiting.begin(), visiting.end(), &storage) != visiting.end();
+                if (!cycle) visiting.push_back(&storage);
+            }
+
+            ~VisitGuard()
+            {
+                if (!cycle) visiting.pop_back();
+            }
+
+            /* The vector is already being visited further up, so it contains itself */
+            bool cycle = false;
+
+        private:
+            const VectorStorage &storage;
+
+            /* The vectors this thread is inside of, innermost last */
+            static thread_local std::vector<const VectorStorage *> visiting;
+        };
+
+        thread_local std::vector<const VectorStorage *> VisitGuard::visiting;
+
+        /* Inexact numbers are GMP floats, which have no infinities or NaN */
+        void requireFinite(double value)
+        {
+            if (std::isfinite(value)) return;
+
+            std::string name = std::isnan(value) ? "+nan.0" : value > 0 ? "+inf.0" : "-inf.0";
+            throw std::invalid_argument("Inexact numbers must be finite, found " + name);
+        }
+
+        /* Read back through the shortest decimal that round trips, so 0.1 doesn't show its binary expansion */
+        InexactNumberExpression::numerical_type flonumValue(double value)
+        {
+            requireFinite(value);
+
+            char buffer[32];
+            for (int precision = 15;; ++precision)
+            {
+                snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+                if (precision == 17 || strtod(buffer, nullptr) == value) break;
+            }
+
+            return InexactNumberExpression::numerical_type(buffer);
+        }
+    }
+
+    bool VectorExpression::isValue()
+    {
+        return true;
+    }
+
+    std::unique_ptr<Expression> VectorExpression::evaluate(std::unique_ptr<Expression> obj_ref)
+    {
+        return obj_ref;
+    }
+
+    std::string VectorExpression::toString() const
+    {
+        std::string rtn = storage->kind == VectorStorage::Kind::flonum ? "(flvector" : "(vector";
+
+        VisitGuard guard(*storage);
+        if (guard.cycle) return rtn + " ...)";
+
+        // Printed from copies, so no lock is held while nested vectors are printed
+        for (auto &element : elements()) rtn += " " + element->toString();
+
+        return rtn + ")";
+    }
+
+    std::unique_ptr<Expression> VectorExpression::clone()
+    {
+        return std::unique_ptr<Expression>(new VectorExpression(*this, this->localScope));
+    }
+
+    bool VectorExpression::equals(const Expression &other) const
+    {
+        auto otherVector = dynamic_cast<const VectorExpression *>(&other);
+        if (!otherVector) return false;
+        if (storage == otherVector->storage) return true;
+
+        VisitGuard guard(*storage);
+        if (guard.cycle) return false;
+
+        // Unboxed elements are compared with both vectors locked, boxed ones are copied out and compared after
+        expression_vector elements, otherElements;
+        {
+            // Both locked in the same order, so two threads comparing the same two vectors can't deadlock
+            VectorStorage *first = storage.get(), *second = otherVector->storage.get();
+            if (std::less<VectorStorage *>()(second, first)) std::swap(first, second);
+            std::lock_guard<std::recursive_mutex> firstGuard(first->lock), secondGuard(second->lock);
+
+            if (size() != otherVector->size()) return false;
+
+            VectorStorage &a = *storage, &b = *otherVector->storage;
+            if (a.kind == VectorStorage::Kind::fixnum && b.kind == VectorStorage::Kind::fixnum)
+                return a.fixnums == b.fixnums;
+            if (a.kind == VectorStorage::Kind::flonum && b.kind == VectorStorage::Kind::flonum)
+                return a.flonums == b.flonums;
+
+            elements = this->elements();
+            otherElements = otherVector->elements();
+        }
+
+        for (size_t i = 0; i < elements.size(); ++i)
+            if (!elements[i]->equals(*otherElements[i])) return false;
+
+        return true;
+    }
+
+    size_t VectorExpression::hash() const
+    {
+        VisitGuard guard(*storage);
+        if (guard.cycle) return 0;
+
+        // Hashed through copies of the elements, so a vector hashes the same whichever way it is stored and no
+        // lock is held while nested vectors are hashed
+        size_t seed = 0;
+        for (auto &element : elements()) boost::hash_combine(seed, element->hash());
+
+        return seed;
+    }
+
+    bool VectorExpression::isMutable() const
+    {
+        return true;
+    }
+
+    void VectorExpression::trace(Memory::Tracer &tracer)
+    {
+        Expression::trace(tracer);
+
+        VisitGuard guard(*storage);
+        if (guard.cycle) return;
+
+        std::lock_guard<std::recursive_mutex> lock(storage->lock);
+        for (auto &expr : storage->boxed) tracer.mark(expr.get());
+    }
+
+    size_t VectorExpression::size() const
+    {
+        std::lock_guard<std::recursive_mutex> guard(storage->lock);
+        return storage->size();
+    }
+
+    VectorStorage::Kind VectorExpression::kind() const
+    {
+        std::lock_guard<std::recursive_mutex> guard(storage->lock);
+        return storage->kind;
+    }
+
+    std::unique_ptr<Expression> VectorExpression::element(size_t index) const
+    {
+        switch (storage->kind)
+        {
+            case VectorStorage::Kind::fixnum:
+                return std::make_unique<NumericalValueExpression>
+                        (NumericalValueExpression::numerical_type(storage->fixnums[index]), nullptr);
+            case VectorStorage::Kind::flonum:
+                return makeFlonum(storage->flonums[index], nullptr);
+            default:
+                return storage->boxed[index]->clone();
+        }
+    }
+
+    std::unique_ptr<Expression> VectorExpression::ref(size_t index) const
+    {
+        std::lock_guard<std::recursive_mutex> guard(storage->lock);
+
+        if (index >= storage->size())
+            throw std::invalid_argument("Index " + std::to_string(index) + " is out of range for a vector of length "
+                                        + std::to_string(storage->size()));
+
+        return element(index);
+    }
+
+    void VectorExpression::set(size_t index, std::unique_ptr<Expression> value)
+    {
+        std::lock_guard<std::recursive_mutex> guard(storage->lock);
+
+        if (index >= storage->size())
+            throw std::invalid_argument("Index " + std::to_string(index) + " is out of range for a vector of length "
+                                        + std::to_string(storage->size()));
+
+        switch (storage->kind)
+        {
+            case VectorStorage::Kind::fixnum:
+                if (asFixnum(*value, storage->fixnums[index])) return;
+
+                // The vector holds something other than fixnums from now on
+                for (size_t i = 0; i < storage->fixnums.size(); ++i) storage->boxed.push_back(element(i));
+                storage->fixnums.clear();
+                storage->fixnums.shrink_to_fit();
+                storage->kind = VectorStorage::Kind::boxed;
+                break;
+
+            case VectorStorage::Kind::flonum:
+            {
+                double flonum;
+                if (!asFlonum(*value, flonum))
+                    throw std::invalid_argument("Expected number for an flvector, found " + value->toString());
+
+                requireFinite(flonum);
+                storage->flonums[index] = flonum;
+                return;
+            }
+
+            default:
+                break;
+        }
+
+        storage->boxed[index] = std::move(value);
+    }
+
+    expression_vector VectorExpression::elements() const
+    {
+        std::lock_guard<std::recursive_mutex> guard(storage->lock);
+
+        expression_vector rtn;
+        rtn.reserve(storage->size());
+        for (size_t i = 0; i < storage->size(); ++i) rtn.push_back(element(i));
+
+        return rtn;
+    }
+
+    bool VectorExpression::numbers(std::vector<double> &out) const
+    {
+        std::lock_guard<std::recursive_mutex> guard(storage->lock);
+
+        switch (storage->kind)
+        {
+            case VectorStorage::Kind::fixnum:
+                out.assign(storage->fixnums.begin(), storage->fixnums.end());
+                return true;
+            case VectorStorage::Kind::flonum:
+                out = storage->flonums;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool VectorExpression::fixnums(std::vector<long> &out) const
+    {
+        std::lock_guard<std::recursive_mutex> guard(storage->lock);
+
+        if (storage->kind != VectorStorage::Kind::fixnum) return false;
+
+        out = storage->fixnums;
+        return true;
+    }
+
+    std::unique_ptr<VectorExpression> VectorExpression::fromElements(expression_vector elements,
+                                                                     std::shared_ptr<Scope> scope)
+    {
+        std::unique_ptr<VectorExpression> vector(new VectorExpression(std::move(scope)));
+        VectorStorage &storage = *vector->storage;
+
+        std::vector<long> fixnums(elements.size());
+        bool unboxed = !elements.empty();
+        for (size_t i = 0; i < elements.size() && unboxed; ++i) unboxed = asFixnum(*elements[i], fixnums[i]);
+
+        if (unboxed)
+        {
+            storage.kind = VectorStorage::Kind::fixnum;
+            storage.fixnums = std::move(fixnums);
+        }
+        else storage.boxed = std::move(elements);
+
+        return vector;
+    }
+
+    std::unique_ptr<VectorExpression> VectorExpression::fromFlonums(std::vector<double> flonums,
+                                                                    std::shared_ptr<Scope> scope)
+    {
+        for (double flonum : flonums) requireFinite(flonum);
+
+        std::unique_ptr<VectorExpression> vector(new VectorExpression(std::move(scope)));
+        vector->storage->kind = VectorStorage::Kind::flonum;
+        vector->storage->flonums = std::move(flonums);
+
+        return vector;
+    }
+
+    std::unique_ptr<VectorExpression> VectorExpression::fromFixnums(std::vector<long> fixnums,
+                                                                    std::shared_ptr<Scope> scope)
+    {
+        std::unique_ptr<VectorExpression> vector(new VectorExpression(std::move(scope)));
+        vector->storage->kind = VectorStorage::Kind::fixnum;
+        vector->storage->fixnums = std::move(fixnums);
+
+        return vector;
+    }
+
+    bool VectorExpression::asFixnum(const Expression &expr, long &out)
+    {
+        auto number = dynamic_cast<const NumericalValueExpression *>(&expr);
+        if (!number) return false;
+
+        auto rational = number->value.backend().data();
+        if (mpz_cmp_ui(mpq_denref(rational), 1) != 0 || !mpz_fits_slong_p(mpq_numref(rational))) return false;
+
+        out = mpz_get_si(mpq_numref(rational));
+        return true;
+    }
+
+    bool VectorExpression::asFlonum(const Expression &expr, double &out)
+    {
+        if (auto number = dynamic_cast<const NumericalValueExpression *>(&expr))
+        {
+            auto rational = number->value.backend().data();
+
+            // Both halves are exact as doubles up to 2^53, so the division rounds correctly where mpq_get_d truncates
+            if (mpz_sizeinbase(mpq_numref(rational), 2) <= 53 && mpz_sizeinbase(mpq_denref(rational), 2) <= 53)
+                out = mpz_get_d(mpq_numref(rational)) / mpz_get_d(mpq_denref(rational));
+            else out = mpq_get_d(rational);
+
+            return true;
+        }
+
+        if (auto inexact = dynamic_cast<const InexactNumberExpression *>(&expr))
+        {
+            // mpf_get_d truncates, parsing the digits rounds to the nearest double
+            out = strtod(inexact->value.str(20, std::ios_base::scientific).c_str(), nullptr);
+            return true;
+        }
+
+        return false;
+    }
+
+    std::unique_ptr<Expression> VectorExpression::makeFlonum(double value, std::shared_ptr<Scope> scope)
+    {
+        return std::make_unique<InexactNumberExpression>(flonumValue(value), std::move(scope));
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef RACKET_INTERPRETER_VECTOR_EXPRESSION_H
+#define RACKET_INTERPRETER_VECTOR_EXPRESSION_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "expressions.h"
+
+namespace Expressions
+{
+    /**
+     * Contiguous storage of a vector. Exact integers that fit in a long and inexact numbers of a flvector are
+     * stored unboxed, anything else is stored as expressions.
+     */
+    struct VectorStorage
+    {
+        enum class Kind
+        {
+            boxed, fixnum, flonum
+        };
+
+        Kind kind = Kind::boxed;
+
+        std::vector<std::unique_ptr<Expression>> boxed;
+        std::vector<long> fixnums;
+        std::vector<double> flonums;
+
+        /* Guards every access, storage is shared between copies and may be shared between threads */
+        std::recursive_mutex lock;
+
+        size_t size() const;
+    };
+
+    class VectorExpression : public Expression
+    {
+    public:
+        bool isValue() override;
+
+        std::unique_ptr<Expression> evaluate(std::unique_ptr<Expression> obj_ref) override;
+
+        std::string toString() const override;
+
+        std::unique_ptr<Expression> clone() override;
+
+        bool equals(const Expression &other) const override;
+
+        size_t hash() const override;
+
+        bool isMutable() const override;
+
+        void trace(Memory::Tracer &tracer) override;
+
+        size_t size() const;
+
+        VectorStorage::Kind kind() const;
+
+        /* A copy of the element at index, throws if it is out of range */
+        std::unique_ptr<Expression> ref(size_t index) const;
+
+        /* Changes the storage every copy shares. A fixnum vector is boxed if the value isn't a fixnum. */
+        void set(size_t index, std::unique_ptr<Expression> value);
+
+        /* Copies of every element, in order */
+        expression_vector elements() const;
+
+        /* The numbers of a fixnum or flonum vector as doubles, false for boxed vectors */
+        bool numbers(std::vector<double> &out) const;
+
+        /* The numbers of a fixnum vector, false for any other */
+        bool fixnums(std::vector<long> &out) const;
+
+        /* What the copies of this vector share, two vectors are the same vector if they share it */
+        const VectorStorage *sharedStorage() const
+        {
+            return storage.get();
+        }
+
+        /* Stores the elements unboxed when they are all fixnums */
+        static std::unique_ptr<VectorExpression> fromElements(expression_vector elements, std::shared_ptr<Scope> scope);
+
+        /**
+         * A flvector, every element has to be a number and is rounded to a double. Throws for infinities and NaN,
+         * which inexact numbers can't hold.
+         */
+        static std::unique_ptr<VectorExpression> fromFlonums(std::vector<double> flonums, std::shared_ptr<Scope> scope);
+
+        static std::unique_ptr<VectorExpression> fromFixnums(std::vector<long> fixnums, std::shared_ptr<Scope> scope);
+
+        /* The value of an exact integer that fits in a long */
+        static bool asFixnum(const Expression &expr, long &out);
+
+        /* The value of any real number, rounded to a double */
+        static bool asFlonum(const Expression &expr, double &out);
+
+        /* An inexact number holding a double, throws if it isn't finite */
+        static std::unique_ptr<Expression> makeFlonum(double value, std::shared_ptr<Scope> scope);
+
+    private:
+        explicit VectorExpression(std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "VectorExpression"), storage(std::make_shared<VectorStorage>())
+        {}
+
+        VectorExpression(const VectorExpression &old_expr, std::shared_ptr<Scope> scope)
+                : Expression(std::move(scope), "VectorExpression"), storage(old_expr.storage)
+        {}
+
+        std::unique_ptr<Expression> element(size_t index) const;
+
+        std::shared_ptr<VectorStorage> storage;
+    };
+}
+
+#endif //RACKET_INTERPRETER_VECTOR_EXPRESSION_H
@@ -0,0 +1,45 @@
+#include "functions.h"
+#include "../interpret/binary_format.h"
+#include "../expressions/port_expression.h"
+
+namespace BinaryFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+    using Functions::arg_range_check;
+
+    expr_ptr writeBinaryFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+
+        // Encoded in full first, so nothing is written for a value that turns out not to be writable
+        std::string data;
+        BinaryFormat::Encoder(data).write(*args[0]);
+        PortFunctions::print(args, 1, data);
+
+        return std::make_unique<Expressions::VoidValueExpression>(std::move(scope));
+    }
+
+    expr_ptr readBinaryFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        expr_ptr value = PortFunctions::inputPort(args, 0).readWith([&scope](std::istream &in)
+                                                                    {
+                                                                        return BinaryFormat::Decoder(*in.rdbuf(),
+                                                                                                     scope).read();
+                                                                    });
+
+        if (!value) return std::make_unique<Expressions::EofExpression>(std::move(scope));
+        return value;
+    }
+}
+
+void register_binary_functions()
+{
+    Functions::funcMap["write-binary"] = BinaryFunctions::writeBinaryFn;
+    Functions::funcMap["read-binary"] = BinaryFunctions::readBinaryFn;
+
+    Functions::impureFunctions.insert({"write-binary", "read-binary"});
+}
@@ -27,7 +27,7 @@ namespace BooleanOperations
     void makeCompFunction(const std::string &comp)
     {
         Functions::funcMap[comp] = [comp](Expressions::expression_vector expr,
-                                          std::shared_ptr<Expressions::Scope> scope) -> std::unique_ptr<Expressions::Expression>
+                                          const std::shared_ptr<Expressions::Scope> & /* scope */) -> std::unique_ptr<Expressions::Expression>
         {
             if (expr.size() < 2) throw std::invalid_argument("Expected at least two arguments"); //TODO: arg count
             Expressions::NumericalValueExpression::numerical_type compVal;
@@ -51,10 +51,7 @@ namespace BooleanOperations
                 else throw std::invalid_argument("Expected number, found " + expr[i]->toString());
             }
 
-            return std::unique_ptr<Expressions::Expression>(new Expressions::BooleanValueExpression(retValue,
-                                                                                                    std::shared_ptr<Expressions::Scope>(
-                                                                                                            new Expressions::Scope(
-                                                                                                                    scope))));
+            return std::unique_ptr<Expressions::Expression>(new Expressions::BooleanValueExpression(retValue, nullptr));
         };
     }
 
@@ -0,0 +1,270 @@
+#include <iostream>
+#include <set>
+#include <thread>
+
+#include "functions.h"
+#include "../interpret/interpret.h"
+#include "../interpret/parser.h"
+#include "../interpret/context.h"
+#include "../expressions/concurrency_expression.h"
+
+namespace ConcurrencyFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+
+    Expressions::PlaceChannelExpression *asChannel(const expr_ptr &expr)
+    {
+        if (auto channel = dynamic_cast<Expressions::PlaceChannelExpression *>(expr.get())) return channel;
+
+        throw std::invalid_argument("Expected place channel, found " + expr->toString());
+    }
+
+    expr_ptr futureFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        if (!dynamic_cast<Expressions::FunctionExpression *>(args[0].get()))
+            throw std::invalid_argument("Expected function, found " + args[0]->toString());
+
+        return std::make_unique<Expressions::FutureExpression>(std::move(args[0]), std::move(scope));
+    }
+
+    expr_ptr touchFn(expression_vector args, scope_ptr /* scope */)
+    {
+        Functions::arg_count_check(args, 1);
+
+        if (auto future = dynamic_cast<Expressions::FutureExpression *>(args[0].get())) return future->touch();
+
+        throw std::invalid_argument("Expected future, found " + args[0]->toString());
+    }
+
+    expr_ptr futurePredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(args[0]->type() == "FutureExpression", std::move(scope)));
+    }
+
+    expr_ptr processorCountFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 0);
+
+        return std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(
+                        std::max(1u, std::thread::hardware_concurrency())), std::move(scope));
+    }
+
+    /* A global function to rebuild from its source in a new place, with copies of the variables it captured */
+    struct PlaceFunction
+    {
+        std::string name, source;
+        std::vector<std::pair<std::string, expr_ptr>> captured;
+    };
+
+    /**
+     * What a new place starts with: the structs and global definitions of the place creating it. Functions are
+     * rebuilt from their source in the new place, values are copied. Futures, channels, and closures over
+     * anything that can't be copied stay behind.
+     */
+    struct PlaceStart
+    {
+        std::map<std::string, std::vector<std::string>> structs;
+        std::vector<PlaceFunction> functions;
+        std::vector<std::pair<std::string, expr_ptr>> values;
+        std::string channelName;
+        std::vector<std::string> body;
+    };
+
+    /* Copies the variables function closes over, the definitions of its scopes below the global scope */
+    void snapshotCaptured(Expressions::FunctionExpression &function, PlaceFunction &copy)
+    {
+        std::set<std::string> seen;
+
+        for (Expressions::Scope *scope = function.localScope.get(); scope && scope->globalScope;
+             scope = scope->parent.get())
+        {
+            for (auto &definition : scope->definitions)
+            {
+                // An inner definition shadows the outer ones
+                if (!seen.insert(definition.first).second) continue;
+
+                copy.captured.emplace_back(definition.first,
+                                           Expressions::copyAcrossPlaces(*definition.second, nullptr));
+            }
+        }
+    }
+
+    void snapshotGlobals(const scope_ptr &scope, PlaceStart &start)
+    {
+        Interpreter::Context &context = Interpreter::Context::of(*scope);
+        start.structs = context.structs;
+
+        for (auto &definition : context.globalScope->definitions)
+        {
+            try
+            {
+                if (auto function = dynamic_cast<Expressions::FunctionExpression *>(definition.second.get()))
+                {
+                    PlaceFunction copy{definition.first, function->toString(), {}};
+                    snapshotCaptured(*function, copy);
+
+                    start.functions.push_back(std::move(copy));
+                    continue;
+                }
+
+                start.values.emplace_back(definition.first, Expressions::copyAcrossPlaces(*definition.second, nullptr));
+            }
+            catch (std::invalid_argument &)
+            {
+            }
+        }
+    }
+
+    void runPlace(PlaceStart &start, const std::shared_ptr<Expressions::PlaceChannelExpression> &channel)
+    {
+        Interpreter::Context context;
+        scope_ptr &global = context.globalScope;
+
+        for (auto &structure : start.structs) context.defineStruct(structure.first, structure.second);
+
+        for (auto &value : start.values)
+            global->define(value.first, Expressions::copyAcrossPlaces(*value.second, global));
+
+        for (auto &function : start.functions)
+        {
+            // The captured variables get a scope of their own, the rebuilt lambda closes over it again
+            scope_ptr closure = global;
+            if (!function.captured.empty())
+            {
+                closure = std::make_shared<Expressions::Scope>(global);
+                for (auto &captured : function.captured)
+                    closure->define(captured.first, Expressions::copyAcrossPlaces(*captured.second, closure));
+            }
+
+            expr_ptr rebuilt = Interpreter::interpret(Parser::parse(function.source, closure));
+            if (auto lambda = dynamic_cast<Expressions::LambdaExpression *>(rebuilt.get()))
+                lambda->setBindingName(function.name);
+
+            global->define(function.name, std::move(rebuilt));
+        }
+
+        global->define(start.channelName, channel->clone());
+
+        for (auto &form : start.body) Interpreter::interpret(Parser::parse(form, global));
+    }
+
+    /**
+     * (place channel body ...) runs body in a context of its own on a thread of its own, with channel bound to
+     * its end of the channel
+     */
+    expr_ptr placeForm(expression_vector args, scope_ptr scope)
+    {
+        if (args.size() < 2)
+            throw std::invalid_argument("place: Expected a channel name and a body, found "
+                                        + std::to_string(args.size()) + " argument(s)");
+
+        std::shared_ptr<PlaceStart> start = std::make_shared<PlaceStart>();
+        start->channelName = args[0]->toString();
+        for (size_t i = 1; i < args.size(); ++i) start->body.push_back(args[i]->toString());
+
+        snapshotGlobals(scope, *start);
+
+        auto toPlace = std::make_shared<Expressions::Mailbox>(), fromPlace = std::make_shared<Expressions::Mailbox>();
+        auto state = std::make_shared<Expressions::PlaceState>();
+        auto placeEnd = std::make_shared<Expressions::PlaceChannelExpression>(toPlace, fromPlace, nullptr, nullptr);
+        auto work = std::make_shared<Interpreter::BackgroundWork>(false);
+
+        // The place spends what is left of this thread's budget, and stops when this context does
+        state->budget.reset(new Interpreter::SharedBudget());
+        Interpreter::Context::of(*scope).addPlace(state);
+
+        std::thread([start, placeEnd, state, work]
+                    {
+                        int exitCode = 0;
+
+                        try
+                        {
+                            Interpreter::BudgetScope budget(*state->budget);
+                            runPlace(*start, placeEnd);
+                        }
+                        catch (std::exception &error)
+                        {
+                            std::cerr << "place: " << error.what() << std::endl;
+                            exitCode = 1;
+                        }
+
+                        // Nothing more can come from the place, a get waiting on it fails instead of blocking
+                        placeEnd->close();
+
+                        {
+                            std::lock_guard<std::mutex> guard(state->lock);
+                            state->done = true;
+                            state->exitCode = exitCode;
+                        }
+
+                        state->finished.notify_all();
+                    }).detach();
+
+        return std::make_unique<Expressions::PlaceChannelExpression>(fromPlace, toPlace, state, scope->parent);
+    }
+
+    expr_ptr placeChannelPutFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        asChannel(args[0])->put(*args[1]);
+        return std::make_unique<Expressions::VoidValueExpression>(Expressions::VoidValueExpression(std::move(scope)));
+    }
+
+    expr_ptr placeChannelGetFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return asChannel(args[0])->get(scope);
+    }
+
+    expr_ptr placeWaitFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(asChannel(args[0])->wait()), std::move(scope));
+    }
+
+    expr_ptr placePredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto channel = dynamic_cast<Expressions::PlaceChannelExpression *>(args[0].get());
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(channel && channel->isPlace(), std::move(scope)));
+    }
+
+    expr_ptr placeChannelPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(args[0]->type() == "PlaceChannelExpression", std::move(scope)));
+    }
+}
+
+void register_concurrency_functions()
+{
+    Functions::funcMap["future"] = ConcurrencyFunctions::futureFn;
+    Functions::funcMap["touch"] = ConcurrencyFunctions::touchFn;
+    Functions::funcMap["future?"] = ConcurrencyFunctions::futurePredicate;
+    Functions::funcMap["processor-count"] = ConcurrencyFunctions::processorCountFn;
+    Functions::specialFormMap["place"] = ConcurrencyFunctions::placeForm;
+    Functions::funcMap["place-channel-put"] = ConcurrencyFunctions::placeChannelPutFn;
+    Functions::funcMap["place-channel-get"] = ConcurrencyFunctions::placeChannelGetFn;
+    Functions::funcMap["place-wait"] = ConcurrencyFunctions::placeWaitFn;
+    Functions::funcMap["place?"] = ConcurrencyFunctions::placePredicate;
+    Functions::funcMap["place-channel?"] = ConcurrencyFunctions::placeChannelPredicate;
+
+    Functions::impureFunctions.insert({"future", "touch", "place", "place-channel-put", "place-channel-get",
+                                       "place-wait"});
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+
+#include "functions.h"
+#include "../interpret/interpret.h"
+#include "../interpret/csv_reader.h"
+#include "../expressions/port_expression.h"
+#include "../expressions/promise_expression.h"
+
+namespace CsvFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    typedef Expressions::NumericalValueExpression::numerical_type numerical_type;
+    using Expressions::expression_vector;
+    using Functions::asFunction;
+    using Expressions::PortExpression;
+    using boost::multiprecision::mpz_int;
+
+    /* Digits that always fit in an unsigned long long */
+    const size_t fastDigits = 18;
+
+    char asSeparator(const expression_vector &args, size_t index)
+    {
+        if (args.size() <= index) return ',';
+
+        auto chr = dynamic_cast<Expressions::CharacterExpression *>(args[index].get());
+        if (!chr) throw std::invalid_argument("Expected character, found " + args[index]->toString());
+        if (chr->character == '"' || chr->character == '\n' || chr->character == '\r')
+            throw std::invalid_argument("Expected a separator, found " + args[index]->toString());
+
+        return chr->character;
+    }
+
+    /* The port to read from: an input port as given, or a path to open */
+    expr_ptr asSource(expr_ptr source, const scope_ptr &scope)
+    {
+        if (auto str = dynamic_cast<Expressions::StringExpression *>(source.get()))
+            return PortExpression::openMappedFile(str->str, scope);
+
+        auto port = dynamic_cast<PortExpression *>(source.get());
+        if (!port || !port->isInput())
+            throw std::invalid_argument("Expected a path or an input port, found " + source->toString());
+
+        return source;
+    }
+
+    /**
+     * A field matching the number syntax of the parser. Short integers and decimals are built from machine
+     * integers, only long ones and fractions go through GMP's string conversion.
+     */
+    expr_ptr number(const std::string &text, const scope_ptr &scope)
+    {
+        bool negative = text[0] == '-';
+        bool decimal = false;
+        size_t digits = 0;
+        unsigned long long numerator = 0, denominator = 1;
+
+        for (size_t i = negative ? 1 : 0; i < text.size(); ++i)
+        {
+            char chr = text[i];
+            if (chr == '/') return std::make_unique<Expressions::NumericalValueExpression>(text, scope);
+            if (chr == '.')
+            {
+                decimal = true;
+                continue;
+            }
+
+            if (++digits > fastDigits)
+            {
+                std::string allDigits = text;
+                allDigits.erase(std::remove(allDigits.begin(), allDigits.end(), '.'), allDigits.end());
+
+                size_t point = text.find('.');
+                unsigned fractionDigits = point == std::string::npos ? 0 : text.size() - point - 1;
+
+                return std::make_unique<Expressions::NumericalValueExpression>
+                        (mpz_int(allDigits), boost::multiprecision::pow(mpz_int(10), fractionDigits), scope);
+            }
+
+            numerator = numerator * 10 + (chr - '0');
+            if (decimal) denominator *= 10;
+        }
+
+        long long value = negative ? -static_cast<long long>(numerator) : static_cast<long long>(numerator);
+        if (denominator == 1)
+            return std::make_unique<Expressions::NumericalValueExpression>(numerical_type(value), scope);
+
+        return std::make_unique<Expressions::NumericalValueExpression>(mpz_int(value), mpz_int(denominator), scope);
+    }
+
+    /* Whether text is a fraction like 1/0, which has no value as a number */
+    bool zeroDenominator(const std::string &text)
+    {
+        size_t slash = text.find('/');
+        return slash != std::string::npos && text.find_first_not_of('0', slash + 1) == std::string::npos;
+    }
+
+    expr_ptr fieldValue(const Interpreter::CsvField &field, const scope_ptr &scope)
+    {
+        // A fraction with a zero denominator keeps its text
+        if (!field.quoted && Parser::isNumber(field.text) && !zeroDenominator(field.text))
+            return number(field.text, scope);
+
+        return std::make_unique<Expressions::StringExpression>(field.text, scope);
+    }
+
+    expr_ptr record(const Interpreter::CsvReader &reader, const scope_ptr &scope)
+    {
+        std::list<expr_ptr> fields;
+        for (size_t i = 0; i < reader.size(); ++i) fields.push_back(fieldValue(reader[i], scope));
+
+        return std::make_unique<Expressions::ListExpression>(std::move(fields), scope);
+    }
+
+    bool readRecord(PortExpression &port, Interpreter::CsvReader &reader)
+    {
+        return port.state->readWith([&reader](std::istream &in) { return reader.next(*in.rdbuf()); });
+    }
+
+    expr_ptr readCsvRecordFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.empty() || args.size() > 2)
+            throw std::invalid_argument("Error: Expected 1 to 2 argument(s), found " + std::to_string(args.size())
+                                        + ".");
+
+        auto port = dynamic_cast<PortExpression *>(args[0].get());
+        if (!port || !port->isInput()) throw std::invalid_argument("Expected input port, found " + args[0]->toString());
+
+        Interpreter::CsvReader reader(asSeparator(args, 1));
+        if (!readRecord(*port, reader)) return std::make_unique<Expressions::EofExpression>(std::move(scope));
+
+        return record(reader, scope);
+    }
+
+    /* Reads a record only when the cell before it is taken apart */
+    expr_ptr recordStream(expr_ptr port, expr_ptr separator, const scope_ptr &scope)
+    {
+        Interpreter::CsvReader reader(dynamic_cast<Expressions::CharacterExpression &>(*separator).character);
+        if (!readRecord(dynamic_cast<PortExpression &>(*port), reader))
+            return std::make_unique<Expressions::ListExpression>(std::list<expr_ptr>(), scope);
+
+        auto first = Expressions::PromiseState::ofValue(record(reader, scope));
+
+        expression_vector restOperands;
+        restOperands.push_back(std::move(port));
+        restOperands.push_back(std::move(separator));
+
+        auto rest = Expressions::PromiseState::ofStep([](expression_vector &operands, const scope_ptr &scope)
+                                                      {
+                                                          return recordStream(std::move(operands[0]),
+                                                                              std::move(operands[1]), scope);
+                                                      }, std::move(restOperands), scope);
+
+        return std::make_unique<Expressions::StreamExpression>(std::move(first), std::move(rest), scope);
+    }
+
+    expr_ptr inCsvFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.empty() || args.size() > 2)
+            throw std::invalid_argument("Error: Expected 1 to 2 argument(s), found " + std::to_string(args.size())
+                                        + ".");
+
+        char separator = asSeparator(args, 1);
+        return recordStream(asSource(std::move(args[0]), scope),
+                            std::make_unique<Expressions::CharacterExpression>(separator, scope), scope);
+    }
+
+    expr_ptr csvFoldFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.size() < 3 || args.size() > 4)
+            throw std::invalid_argument("Error: Expected 3 to 4 argument(s), found " + std::to_string(args.size())
+                                        + ".");
+
+        Expressions::FunctionExpression *proc = asFunction(args[0]);
+        Interpreter::CsvReader reader(asSeparator(args, 3));
+        expr_ptr source = asSource(std::move(args[2]), scope);
+        auto &port = dynamic_cast<PortExpression &>(*source);
+
+        // Like foldl, the record comes first and the accumulator second
+        expr_ptr accumulator = std::move(args[1]);
+        while (readRecord(port, reader))
+        {
+            expression_vector params;
+            params.push_back(record(reader, scope));
+            params.push_back(std::move(accumulator));
+            accumulator = Interpreter::interpret(proc->call(std::move(params)));
+        }
+
+        return accumulator;
+    }
+}
+
+void register_csv_functions()
+{
+    Functions::funcMap["read-csv-record"] = CsvFunctions::readCsvRecordFn;
+    Functions::funcMap["in-csv"] = CsvFunctions::inCsvFn;
+    Functions::funcMap["csv-fold"] = CsvFunctions::csvFoldFn;
+
+    Functions::impureFunctions.insert({"read-csv-record", "in-csv", "csv-fold"});
+}
@@ -2,9 +2,16 @@
 // Created by Antonio on 2019-01-09.
 //
 
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
 #include "functions.h"
 #include "../interpret/parser.h"
 #include "../interpret/interpret.h"
+#include "../interpret/context.h"
+#include "../expressions/vector_expression.h"
+#include "../expressions/port_expression.h"
 
 void register_boolean_ops();
 
@@ -20,13 +27,68 @@ void register_struct_functions();
 
 void register_list_functions();
 
+void register_memory_functions();
+
+void register_hash_functions();
+
+void register_vector_functions();
+
+void register_parallel_functions();
+
+void register_concurrency_functions();
+
+void register_port_functions();
+
+void register_stream_functions();
+
+void register_csv_functions();
+
+void register_json_functions();
+
+void register_binary_functions();
+
 namespace Functions
 {
-    std::map<std::string, std::function<std::unique_ptr<Expressions::Expression>(expression_vector,
-                                                                                 std::shared_ptr<Expressions::Scope>)>> funcMap;
+    builtin_table funcMap;
 
-    std::map<std::string, std::function<std::unique_ptr<Expressions::Expression>(expression_vector,
-                                                                                 std::shared_ptr<Expressions::Scope>)>> specialFormMap;
+    builtin_table specialFormMap;
+
+    MemoOptions memoOptions;
+
+    std::set<std::string> impureFunctions{"display", "newline", "flush-output", "current-milliseconds", "run-tests",
+                                          "check-expect", "check-within", "collect-garbage", "heap-stats",
+                                          "runtime-stats"};
+
+    std::vector<std::string> commandLineArguments;
+
+    std::atomic<std::ostream *> defaultOutputStream(&std::cout);
+
+    thread_local std::ostream *outputStream = nullptr;
+
+    std::ostream &output()
+    {
+        return outputStream ? *outputStream : *defaultOutputStream;
+    }
+
+    void setOutput(std::ostream *stream)
+    {
+        outputStream = stream;
+    }
+
+    void setDefaultOutput(std::ostream *stream)
+    {
+        defaultOutputStream = stream;
+    }
+
+    OutputRedirect::OutputRedirect(std::ostream *stream) : previous(outputStream)
+    {
+        outputStream = stream;
+    }
+
+    OutputRedirect::~OutputRedirect()
+    {
+        outputStream = previous;
+    }
 
     void arg_count_check(const expression_vector &args, int expectedCount)
     {
@@ -35,26 +97,18 @@ namespace Functions
                                         + " argument(s), found " + std::to_string(args.size()) + ".");
     }
 
-    std::unique_ptr<Expressions::Expression> display_func(expression_vector expr,
-                                                          std::shared_ptr<Expressions::Scope> scope)
+    void arg_range_check(const expression_vector &args, size_t min, size_t max)
     {
-        arg_count_check(expr, 1);
-
-        std::cout << *expr.front();
-
-        return std::unique_ptr<Expressions::Expression>(new Expressions::VoidValueExpression(
-                std::make_unique<Expressions::Scope>(Expressions::Scope(std::move(scope)))));
+        if (args.size() < min || args.size() > max)
+            throw std::invalid_argument("Error: Expected " + std::to_string(min) + " to " + std::to_string(max)
+                                        + " argument(s), found " + std::to_string(args.size()) + ".");
     }
 
-    std::unique_ptr<Expressions::Expression> newline_func(const expression_vector &expr,
-                                                          std::shared_ptr<Expressions::Scope> scope)
+    Expressions::FunctionExpression *asFunction(const std::unique_ptr<Expressions::Expression> &expr)
     {
-        arg_count_check(expr, 0);
+        if (auto func = dynamic_cast<Expressions::FunctionExpression *>(expr.get())) return func;
 
-        std::cout << std::endl;
-
-        return std::unique_ptr<Expressions::Expression>(new Expressions::VoidValueExpression(
-                std::make_unique<Expressions::Scope>(Expressions::Scope(std::move(scope)))));
+        throw std::invalid_argument("Expected function, found " + expr->toString());
     }
 
     std::unique_ptr<Expressions::Expression> begin_func(expression_vector expr,
@@ -70,8 +124,45 @@ namespace Functions
         return Expressions::evaluate(std::move(expr.back()));
     }
 
+    const builtin_table &functionsFor(const Expressions::Scope *scope)
+    {
+        Interpreter::Context *context = Interpreter::Context::find(scope);
+        return context ? context->functions : funcMap;
+    }
+
+    const builtin_table &specialFormsFor(const Expressions::Scope *scope)
+    {
+        Interpreter::Context *context = Interpreter::Context::find(scope);
+        return context ? context->specialForms : specialFormMap;
+    }
+
+    bool isBuiltin(const std::string &name, const std::shared_ptr<Expressions::Scope> &scope)
+    {
+        return functionsFor(scope.get()).count(name) > 0 || specialFormsFor(scope.get()).count(name) > 0;
+    }
+
+    /* Whether a free variable of a function body can be relied on to always mean the same thing */
+    bool isPureName(const std::string &name, const std::string &self, const std::shared_ptr<Expressions::Scope> &scope)
+    {
+        if (name == self) return true;
+        if (impureFunctions.count(name) > 0) return false;
+        if (isBuiltin(name, scope)) return true;
+
+        /** Definitions can't be changed, so constants are safe unless their contents can. Of the user's functions
+         * only memoized ones are known to be pure. */
+        Expressions::Scope *owner = scope->find(name);
+        if (!owner) return false;
+
+        auto &definition = owner->definitions.find(name)->second;
+        if (auto function = dynamic_cast<Expressions::FunctionExpression *>(definition.get()))
+            return dynamic_cast<Expressions::MemoizedLambdaExpression *>(function) != nullptr;
+
+        return !definition->isMutable();
+    }
+
     std::unique_ptr<Expressions::Expression> define_lambda(const std::string &raw, expression_vector expr,
-                                                           const std::shared_ptr<Expressions::Scope> &scope)
+                                                           const std::shared_ptr<Expressions::Scope> &scope,
+                                                           bool memoize)
     {
         std::vector<std::string> fnSignature = Parser::parseTuple(raw);
 
@@ -79,7 +170,7 @@ namespace Functions
         std::string name = fnSignature[0];
         fnSignature.erase(fnSignature.begin());
 
-        if (scope->contains(name) || funcMap.count(name) > 0 || specialFormMap.count(name) > 0)
+        if (scope->contains(name) || isBuiltin(name, scope))
             throw std::invalid_argument("Error: Scope already contains key for " + name);
 
         /** Next, we need to parse the lambda body */
@@ -100,10 +191,30 @@ namespace Functions
             lambdaBody.push_back(lambdaArgs);
             lambdaBody.push_back(expr[1]->toString());
 
-            auto binding = std::unique_ptr<Expressions::Expression>
-                    (new Expressions::LambdaExpression(lambdaBody, fnSignature,
-                                                       std::make_unique<Expressions::Scope>(
-                                                               Expressions::Scope(scope))));
+            if (!memoize && memoOptions.automatic)
+            {
+                memoize = Parser::isPure(lambdaBody, [&name, &scope](const std::string &var)
+                {
+                    return isPureName(var, name, scope);
+                });
+            }
+
+            Expressions::LambdaExpression *lambda;
+            if (memoize)
+            {
+                lambda = new Expressions::MemoizedLambdaExpression(lambdaBody, fnSignature,
+                                                                   std::make_unique<Expressions::Scope>(
+                                                                           Expressions::Scope(scope)),
+                                                                   memoOptions.capacity);
+            }
+            else
+            {
+                lambda = new Expressions::LambdaExpression(lambdaBody, fnSignature,
+                                                           std::make_unique<Expressions::Scope>(
+                                                                   Expressions::Scope(scope)));
+            }
+            lambda->setBindingName(name);
+            auto binding = std::unique_ptr<Expressions::Expression>(lambda);
 
             // scope->parent is the tuple, we need to go further up to make our definition
             scope->parent->parent->define(name, std::move(binding));
@@ -129,17 +240,20 @@ namespace Functions
             name = expr[0]->toString();
             if (name.front() == '(' || name.front() == '[')
             {
-                return define_lambda(name, std::move(expr), scope);
+                return define_lambda(name, std::move(expr), scope, false);
             }
         }
         else throw std::invalid_argument("Error: Special form given parsed expression: " + expr[0]->toString());
 
-        if (scope->definitions.count(name) > 0 || funcMap.count(name) > 0 || specialFormMap.count(name) > 0)
+        if (scope->definitions.count(name) > 0 || isBuiltin(name, scope))
             throw std::invalid_argument("Error: Scope already contains key for " + name);
 
         if (expr[1]->type() == "UnparsedExpression")
         {
-            binding = Expressions::evaluate(std::move(expr[1]));
+            binding = Interpreter::interpret(Expressions::evaluate(std::move(expr[1])));
+
+            auto lambda = dynamic_cast<Expressions::LambdaExpression *>(binding.get());
+            if (lambda && lambda->profileLabel() == lambda->toString()) lambda->setBindingName(name);
         }
         else throw std::invalid_argument("Error: Special form given parsed expression: " + expr[1]->toString());
 
@@ -151,6 +265,18 @@ namespace Functions
                                                              (Expressions::Scope(scope))));
     }
 
+    std::unique_ptr<Expressions::Expression> define_memo_form(expression_vector expr,
+                                                              const std::shared_ptr<Expressions::Scope> &scope)
+    {
+        arg_count_check(expr, 2);
+
+        std::string signature = expr[0]->toString();
+        if (expr[0]->type() != "UnparsedExpression" || (signature.front() != '(' && signature.front() != '['))
+            throw std::invalid_argument("define/memo: Expected a function signature, found: " + signature);
+
+        return define_lambda(signature, std::move(expr), scope, true);
+    }
+
     std::unique_ptr<Expressions::Expression> local_form(expression_vector args,
                                                         const std::shared_ptr<Expressions::Scope> &scope)
     {
@@ -181,7 +307,7 @@ namespace Functions
         Functions::arg_count_check(args, 2);
 
         return std::make_unique<Expressions::BooleanValueExpression>
-                (args[0]->toString() == args[1]->toString(), std::move(scope));
+                (args[0]->equals(*args[1]), std::move(scope));
     }
 
     std::unique_ptr<Expressions::Expression> error(const expression_vector &args,
@@ -197,9 +323,33 @@ namespace Functions
         return std::move(args[0]);
     }
 
-    void registerFunctions()
+    std::unique_ptr<Expressions::Expression> currentMilliseconds(expression_vector args,
+                                                                 std::shared_ptr<Expressions::Scope> scope)
+    {
+        arg_count_check(args, 0);
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch());
+
+        return std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type((long) now.count()), std::move(scope));
+    }
+
+    std::unique_ptr<Expressions::Expression> currentCommandLineArguments(expression_vector args,
+                                                                         std::shared_ptr<Expressions::Scope> scope)
+    {
+        arg_count_check(args, 0);
+
+        expression_vector arguments;
+        for (auto &argument : commandLineArguments)
+            arguments.push_back(std::make_unique<Expressions::StringExpression>(argument, scope));
+
+        return Expressions::VectorExpression::fromElements(std::move(arguments), std::move(scope));
+    }
+
+    void registerAll()
     {
         specialFormMap["define"] = define_form;
+        specialFormMap["define/memo"] = define_memo_form;
         specialFormMap["local"] = local_form;
 
         register_math_functions();
@@ -209,20 +359,63 @@ namespace Functions
         register_testing_functions();
         register_struct_functions();
         register_list_functions();
+        register_memory_functions();
+        register_hash_functions();
+        register_vector_functions();
+        register_parallel_functions();
+        register_concurrency_functions();
+        register_port_functions();
+        register_stream_functions();
+        register_csv_functions();
+        register_json_functions();
+        register_binary_functions();
 
-        funcMap["display"] = display_func;
-        funcMap["newline"] = newline_func;
         funcMap["begin"] = begin_func;
         funcMap["procedure?"] = procedurePredicate;
         funcMap["equal?"] = equalComparator;
         funcMap["error"] = error;
         funcMap["identity"] = identity;
+        funcMap["current-milliseconds"] = currentMilliseconds;
+        funcMap["current-command-line-arguments"] = currentCommandLineArguments;
+    }
+
+    void registerFunctions()
+    {
+        static std::once_flag registered;
+        std::call_once(registered, registerAll);
+    }
+
+    void defineConstants(std::shared_ptr<Expressions::Scope> &globalScope)
+    {
+        globalScope->define("e", std::make_unique<Expressions::InexactNumberExpression>
+                (Expressions::InexactNumberExpression(M_E,
+                                                      std::make_shared<Expressions::Scope>(
+                                                              Expressions::Scope(globalScope)))));
+        globalScope->define("pi", std::make_unique<Expressions::InexactNumberExpression>
+                (Expressions::InexactNumberExpression(M_PI,
+                                                      std::make_shared<Expressions::Scope>(
+                                                              Expressions::Scope(globalScope)))));
+
+        Interpreter::Context::of(*globalScope).defineStruct("posn", std::vector<std::string>{"x", "y"});
+
+        globalScope->define("empty", std::make_unique<Expressions::ListExpression>
+                (Expressions::ListExpression(std::list<std::unique_ptr<Expressions::Expression>>(),
+                                             std::make_shared<Expressions::Scope>(
+                                                     Expressions::Scope(globalScope)))));
+
+        globalScope->define("empty-stream", std::make_unique<Expressions::ListExpression>
+                (Expressions::ListExpression(std::list<std::unique_ptr<Expressions::Expression>>(),
+                                             std::make_shared<Expressions::Scope>(
+                                                     Expressions::Scope(globalScope)))));
+
+        globalScope->define("eof", std::make_unique<Expressions::EofExpression>
+                (std::make_shared<Expressions::Scope>(Expressions::Scope(globalScope))));
     }
 
     std::unique_ptr<Expressions::Expression>
     getFormByName(const std::string &name, std::shared_ptr<Expressions::Scope> parent)
     {
-        auto m = specialFormMap.at(name);
+        auto m = specialFormsFor(parent.get()).at(name);
         std::shared_ptr<Expressions::Scope> localScope(new Expressions::Scope(std::move(parent)));
 
         return std::unique_ptr<Expressions::Expression>(
@@ -232,7 +425,7 @@ namespace Functions
     std::unique_ptr<Expressions::Expression>
     getFuncByName(const std::string &name, std::shared_ptr<Expressions::Scope> parent)
     {
-        auto m = funcMap.at(name);
+        auto m = functionsFor(parent.get()).at(name);
         std::shared_ptr<Expressions::Scope> localScope(new Expressions::Scope(std::move(parent)));
 
         return std::unique_ptr<Expressions::Expression>(
@@ -5,25 +5,129 @@
 #ifndef RACKET_INTERPRETER_FUNCTIONS_H
 #define RACKET_INTERPRETER_FUNCTIONS_H
 
+#include <set>
+
 #include "../expressions/expressions.h"
 
 namespace Functions
 {
     using Expressions::expression_vector;
 
-    extern std::map<std::string, std::function<std::unique_ptr<Expressions::Expression>(expression_vector,
-                                                                                        std::shared_ptr<Expressions::Scope>)>> funcMap;
+    typedef std::function<std::unique_ptr<Expressions::Expression>(expression_vector,
+                                                                   std::shared_ptr<Expressions::Scope>)> builtin;
+
+    typedef std::map<std::string, builtin> builtin_table;
+
+    /* The registered builtins, every interpreter context starts out with a copy. Read-only once registered. */
+    extern builtin_table funcMap;
 
-    extern std::map<std::string, std::function<std::unique_ptr<Expressions::Expression>(expression_vector,
-                                                                                        std::shared_ptr<Expressions::Scope>)>> specialFormMap;
+    extern builtin_table specialFormMap;
 
+    /* Fills the builtin tables, only the first call does anything */
     void registerFunctions();
 
+    /* The builtins in effect for scope: those of its context, or the registered ones outside of any context */
+    const builtin_table &functionsFor(const Expressions::Scope *scope);
+
+    const builtin_table &specialFormsFor(const Expressions::Scope *scope);
+
+    /* Defines e, pi, empty, empty-stream, eof and the posn struct */
+    void defineConstants(std::shared_ptr<Expressions::Scope> &globalScope);
+
+    /* The stream builtins print to. Defaults to std::cout, threads may redirect their own output. */
+    std::ostream &output();
+
+    void setOutput(std::ostream *);
+
+    /* Replaces std::cout as the output of every thread that doesn't redirect its own */
+    void setDefaultOutput(std::ostream *);
+
+    /* Points this thread's output at another stream for as long as it is alive */
+    class OutputRedirect
+    {
+    public:
+        explicit OutputRedirect(std::ostream *stream);
+
+        ~OutputRedirect();
+
+        OutputRedirect(const OutputRedirect &) = delete;
+
+        OutputRedirect &operator=(const OutputRedirect &) = delete;
+
+    private:
+        /* nullptr if the thread was printing to the default output */
+        std::ostream *previous;
+    };
+
+    /* The arguments following the script given to racquet run */
+    extern std::vector<std::string> commandLineArguments;
+
     void arg_count_check(const expression_vector &args, int expectedCount);
 
+    void arg_range_check(const expression_vector &args, size_t min, size_t max);
+
+    /* The function an argument holds, throws for anything else */
+    Expressions::FunctionExpression *asFunction(const std::unique_ptr<Expressions::Expression> &expr);
+
     std::unique_ptr<Expressions::Expression> getFormByName(const std::string &, std::shared_ptr<Expressions::Scope>);
 
     std::unique_ptr<Expressions::Expression> getFuncByName(const std::string &, std::shared_ptr<Expressions::Scope>);
+
+    struct MemoOptions
+    {
+        /* Results kept per memoized function */
+        size_t capacity = 10000;
+
+        /* Memoize every function defined with define whose body is provably pure */
+        bool automatic = false;
+    };
+
+    extern MemoOptions memoOptions;
+
+    /* Builtins with side effects, a function calling one of them is never memoized automatically */
+    extern std::set<std::string> impureFunctions;
+}
+
+namespace Expressions
+{
+    struct PortState;
+}
+
+/* What the builtins of other files read from and write to when they are given no port */
+namespace PortFunctions
+{
+    /* The port given at index, or the current input port */
+    Expressions::PortState &inputPort(const Expressions::expression_vector &args, size_t index);
+
+    /* Writes to the port given at index, or to the current output */
+    void print(const Expressions::expression_vector &args, size_t index, const std::string &text);
+}
+
+namespace TestingFunctions
+{
+    struct TestCase
+    {
+        std::unique_ptr<Expressions::Expression> test, expected;
+        Expressions::InexactNumberExpression::numerical_type within;
+    };
+
+    struct TestOptions
+    {
+        /* Number of threads run-tests spreads the queued test cases across */
+        size_t jobs = 1;
+
+        /* Budget of every test case, 0 for none */
+        size_t stepLimit = 0;
+        long timeoutMs = 0;
+
+        /* How many of the slowest test cases to list after a run */
+        size_t slowest = 0;
+
+        /* File to write a JSON report of every run to, if not empty */
+        std::string jsonReport;
+    };
+
+    extern TestOptions testOptions;
 }
 
 #endif //RACKET_INTERPRETER_FUNCTIONS_H
@@ -0,0 +1,245 @@
+#include "functions.h"
+#include "../interpret/interpret.h"
+#include "../expressions/hash_expression.h"
+
+namespace HashFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+    using Functions::arg_range_check;
+    using Functions::asFunction;
+
+    Expressions::HashExpression *asHash(const expr_ptr &expr)
+    {
+        if (auto hash = dynamic_cast<Expressions::HashExpression *>(expr.get())) return hash;
+
+        throw std::invalid_argument("Expected hash, found " + expr->toString());
+    }
+
+    /* A failure result given as a procedure is called, anything else is the result itself */
+    expr_ptr failureResult(expr_ptr failure)
+    {
+        if (auto thunk = dynamic_cast<Expressions::FunctionExpression *>(failure.get()))
+            return Interpreter::interpret(thunk->call(expression_vector()));
+
+        return failure;
+    }
+
+    expr_ptr voidResult(scope_ptr scope)
+    {
+        return std::make_unique<Expressions::VoidValueExpression>(Expressions::VoidValueExpression(std::move(scope)));
+    }
+
+    /* Fills a hash from a list of (list key value) pairs */
+    std::unique_ptr<Expressions::HashExpression> fromAssociations(bool mutableTable, const expression_vector &args,
+                                                                  const scope_ptr &scope)
+    {
+        arg_range_check(args, 0, 1);
+        std::unique_ptr<Expressions::HashExpression> hash(new Expressions::HashExpression(mutableTable, scope));
+
+        if (args.empty()) return hash;
+
+        auto list = dynamic_cast<Expressions::ListExpression *>(args[0].get());
+        if (!list) throw std::invalid_argument("Expected list, found " + args[0]->toString());
+
+        for (auto &pair : list->list)
+        {
+            auto entry = dynamic_cast<Expressions::ListExpression *>(pair.get());
+            if (!entry || entry->list.size() != 2)
+                throw std::invalid_argument("Expected a list of key and value, found " + pair->toString());
+
+            expr_ptr key = entry->list.front()->clone(), value = entry->list.back()->clone();
+            if (mutableTable) hash->set(std::move(key), std::move(value));
+            else hash = hash->with(std::move(key), std::move(value), scope);
+        }
+
+        return hash;
+    }
+
+    expr_ptr makeHashFn(expression_vector args, scope_ptr scope)
+    {
+        return fromAssociations(true, args, scope);
+    }
+
+    expr_ptr makeImmutableHashFn(expression_vector args, scope_ptr scope)
+    {
+        return fromAssociations(false, args, scope);
+    }
+
+    expr_ptr hashFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.size() % 2 != 0) throw std::invalid_argument("hash: Expected keys and values in pairs");
+
+        std::unique_ptr<Expressions::HashExpression> hash(new Expressions::HashExpression(false, scope));
+        for (size_t i = 0; i < args.size(); i += 2) hash = hash->with(std::move(args[i]), std::move(args[i + 1]), scope);
+
+        return hash;
+    }
+
+    expr_ptr hashPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(args[0]->type() == "HashExpression", std::move(scope)));
+    }
+
+    expr_ptr hashRefFn(expression_vector args, scope_ptr /* scope */)
+    {
+        arg_range_check(args, 2, 3);
+
+        if (auto value = asHash(args[0])->lookup(*args[1])) return value;
+        if (args.size() == 3) return failureResult(std::move(args[2]));
+
+        throw std::invalid_argument("hash-ref: No value found for key " + args[1]->toString());
+    }
+
+    expr_ptr hashHasKeyFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(asHash(args[0])->lookup(*args[1]) != nullptr, std::move(scope)));
+    }
+
+    expr_ptr hashSetBangFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 3);
+
+        asHash(args[0])->set(std::move(args[1]), std::move(args[2]));
+        return voidResult(std::move(scope));
+    }
+
+    expr_ptr hashSetFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 3);
+
+        return asHash(args[0])->with(std::move(args[1]), std::move(args[2]), std::move(scope));
+    }
+
+    expr_ptr hashRemoveBangFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        asHash(args[0])->remove(*args[1]);
+        return voidResult(std::move(scope));
+    }
+
+    expr_ptr hashRemoveFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        return asHash(args[0])->without(*args[1], std::move(scope));
+    }
+
+    /* The updater applied to the current value of the key, or to the failure result if there is none */
+    expr_ptr updatedValue(expression_vector &args)
+    {
+        arg_range_check(args, 3, 4);
+        Expressions::FunctionExpression *updater = asFunction(args[2]);
+
+        expr_ptr current = asHash(args[0])->lookup(*args[1]);
+        if (!current)
+        {
+            if (args.size() < 4) throw std::invalid_argument("hash-update: No value found for key " + args[1]->toString());
+            current = failureResult(std::move(args[3]));
+        }
+
+        expression_vector params;
+        params.push_back(std::move(current));
+        return Interpreter::interpret(updater->call(std::move(params)));
+    }
+
+    expr_ptr hashUpdateBangFn(expression_vector args, scope_ptr scope)
+    {
+        expr_ptr value = updatedValue(args);
+
+        asHash(args[0])->set(std::move(args[1]), std::move(value));
+        return voidResult(std::move(scope));
+    }
+
+    expr_ptr hashUpdateFn(expression_vector args, scope_ptr scope)
+    {
+        expr_ptr value = updatedValue(args);
+
+        return asHash(args[0])->with(std::move(args[1]), std::move(value), std::move(scope));
+    }
+
+    expr_ptr hashCountFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(asHash(args[0])->size()), std::move(scope));
+    }
+
+    /* A list with one element per entry of the hash */
+    template<typename Element>
+    expr_ptr entryList(expression_vector &args, scope_ptr scope, Element element)
+    {
+        Functions::arg_count_check(args, 1);
+
+        std::list<expr_ptr> list;
+        asHash(args[0])->forEach([&list, &element, &scope](Expressions::Expression &key,
+                                                           Expressions::Expression &value)
+                                 {
+                                     list.push_back(element(key, value, scope));
+                                 });
+
+        return std::make_unique<Expressions::ListExpression>(std::move(list), std::move(scope));
+    }
+
+    expr_ptr hashKeysFn(expression_vector args, scope_ptr scope)
+    {
+        return entryList(args, std::move(scope), [](Expressions::Expression &key, Expressions::Expression &,
+                                                    const scope_ptr &)
+        {
+            return key.clone();
+        });
+    }
+
+    expr_ptr hashValuesFn(expression_vector args, scope_ptr scope)
+    {
+        return entryList(args, std::move(scope), [](Expressions::Expression &, Expressions::Expression &value,
+                                                    const scope_ptr &)
+        {
+            return value.clone();
+        });
+    }
+
+    expr_ptr hashToListFn(expression_vector args, scope_ptr scope)
+    {
+        return entryList(args, std::move(scope), [](Expressions::Expression &key, Expressions::Expression &value,
+                                                    const scope_ptr &entryScope)
+        {
+            std::list<expr_ptr> pair;
+            pair.push_back(key.clone());
+            pair.push_back(value.clone());
+
+            return expr_ptr(new Expressions::ListExpression(std::move(pair), entryScope));
+        });
+    }
+}
+
+void register_hash_functions()
+{
+    Functions::funcMap["make-hash"] = HashFunctions::makeHashFn;
+    Functions::funcMap["make-immutable-hash"] = HashFunctions::makeImmutableHashFn;
+    Functions::funcMap["hash"] = HashFunctions::hashFn;
+    Functions::funcMap["hash?"] = HashFunctions::hashPredicate;
+    Functions::funcMap["hash-ref"] = HashFunctions::hashRefFn;
+    Functions::funcMap["hash-has-key?"] = HashFunctions::hashHasKeyFn;
+    Functions::funcMap["hash-set!"] = HashFunctions::hashSetBangFn;
+    Functions::funcMap["hash-set"] = HashFunctions::hashSetFn;
+    Functions::funcMap["hash-remove!"] = HashFunctions::hashRemoveBangFn;
+    Functions::funcMap["hash-remove"] = HashFunctions::hashRemoveFn;
+    Functions::funcMap["hash-update!"] = HashFunctions::hashUpdateBangFn;
+    Functions::funcMap["hash-update"] = HashFunctions::hashUpdateFn;
+    Functions::funcMap["hash-count"] = HashFunctions::hashCountFn;
+    Functions::funcMap["hash-keys"] = HashFunctions::hashKeysFn;
+    Functions::funcMap["hash-values"] = HashFunctions::hashValuesFn;
+    Functions::funcMap["hash->list"] = HashFunctions::hashToListFn;
+
+    Functions::impureFunctions.insert({"hash-set!", "hash-remove!", "hash-update!"});
+}
@@ -0,0 +1,105 @@
+#include "functions.h"
+#include "../interpret/json.h"
+#include "../expressions/port_expression.h"
+
+namespace JsonFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+    using Functions::arg_range_check;
+
+    std::string asString(const expr_ptr &expr)
+    {
+        if (auto str = dynamic_cast<Expressions::StringExpression *>(expr.get())) return str->str;
+
+        throw std::invalid_argument("Expected string, found " + expr->toString());
+    }
+
+    /* Parses all of text as one value, only whitespace may follow it */
+    expr_ptr parseAll(const std::string &text, const scope_ptr &scope)
+    {
+        size_t position = 0;
+        expr_ptr value = Json::parse(text, position, scope);
+
+        while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position]))) ++position;
+        if (position < text.size())
+            throw std::invalid_argument("Invalid JSON: Unexpected text after the value at offset "
+                                        + std::to_string(position));
+
+        return value;
+    }
+
+    expr_ptr readJsonFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        std::string text;
+        bool found = PortFunctions::inputPort(args, 0).readWith([&text](std::istream &in)
+                                                                {
+                                                                    return Json::readValue(*in.rdbuf(), text);
+                                                                });
+
+        if (!found) return std::make_unique<Expressions::EofExpression>(std::move(scope));
+        return parseAll(text, scope);
+    }
+
+    expr_ptr writeJsonFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+
+        Json::Writer writer([&args](const std::string &block) { PortFunctions::print(args, 1, block); });
+        writer.write(*args[0]);
+        writer.flush();
+
+        return std::make_unique<Expressions::VoidValueExpression>(std::move(scope));
+    }
+
+    expr_ptr stringToJsexprFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return parseAll(asString(args[0]), scope);
+    }
+
+    expr_ptr jsexprToStringFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        std::string text;
+        Json::Writer writer([&text](const std::string &block) { text += block; });
+        writer.write(*args[0]);
+        writer.flush();
+
+        return std::make_unique<Expressions::StringExpression>(text, std::move(scope));
+    }
+
+    expr_ptr jsexprPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        bool valid = true;
+        try
+        {
+            Json::Writer writer([](const std::string &) {});
+            writer.write(*args[0]);
+        }
+        catch (std::invalid_argument &)
+        {
+            valid = false;
+        }
+
+        return std::make_unique<Expressions::BooleanValueExpression>(valid, std::move(scope));
+    }
+}
+
+void register_json_functions()
+{
+    Functions::funcMap["read-json"] = JsonFunctions::readJsonFn;
+    Functions::funcMap["write-json"] = JsonFunctions::writeJsonFn;
+    Functions::funcMap["string->jsexpr"] = JsonFunctions::stringToJsexprFn;
+    Functions::funcMap["jsexpr->string"] = JsonFunctions::jsexprToStringFn;
+    Functions::funcMap["jsexpr?"] = JsonFunctions::jsexprPredicate;
+
+    Functions::impureFunctions.insert({"read-json", "write-json"});
+}
@@ -163,11 +163,10 @@ namespace ListFunctions
 
         if (auto list = dynamic_cast<Expressions::ListExpression *>(args[1].get()))
         {
-            std::string test = args[0]->toString();
             bool member = false;
             for (auto &expr : list->list)
             {
-                member = expr->toString() == test;
+                member = expr->equals(*args[0]);
                 if (member) break;
             }
 
@@ -449,6 +448,15 @@ namespace ListFunctions
 
     bool n2Smaller(const expr_ptr &number1, const expr_ptr &number2)
     {
+        // Numbers of the same kind compare directly, only mixed ones need the rational converted
+        auto rational1 = dynamic_cast<Expressions::NumericalValueExpression *>(number1.get());
+        auto rational2 = dynamic_cast<Expressions::NumericalValueExpression *>(number2.get());
+        if (rational1 && rational2) return rational1->value > rational2->value;
+
+        auto inexact1 = dynamic_cast<Expressions::InexactNumberExpression *>(number1.get());
+        auto inexact2 = dynamic_cast<Expressions::InexactNumberExpression *>(number2.get());
+        if (inexact1 && inexact2) return inexact1->value > inexact2->value;
+
         Expressions::InexactNumberExpression::numerical_type n1Val, n2Val;
 
         if (auto n1Rational = dynamic_cast<Expressions::NumericalValueExpression *>(number1.get()))
@@ -4,7 +4,9 @@
 
 #include "functions.h"
 #include "../interpret/parser.h"
+#include "../expressions/vector_expression.h"
 #include <cmath>
+#include <functional>
 
 #include "boost/multiprecision/gmp.hpp"
 
@@ -15,7 +17,16 @@ namespace MathFunctions
     typedef std::shared_ptr<Expressions::Scope> scope_ptr;
     using Expressions::expression_vector;
 
-    expr_ptr plus_func(expression_vector expr, scope_ptr scope)
+    /* Every exact number is a GMP rational, this counts the results that wouldn't fit in a fixnum */
+    void countPromotion(const Expressions::NumericalValueExpression::numerical_type &value)
+    {
+        auto rational = value.backend().data();
+
+        if (!mpz_fits_slong_p(mpq_numref(rational)) || mpz_cmp_ui(mpq_denref(rational), 1) != 0)
+            Interpreter::bumpCounter(Interpreter::runtimeCounters().gmpPromotions);
+    }
+
+    expr_ptr plus_func(expression_vector expr, const scope_ptr & /* scope */)
     {
         Expressions::NumericalValueExpression::numerical_type sum = 0;
         Expressions::InexactNumberExpression::numerical_type dSum = 0.0;
@@ -42,18 +53,15 @@ namespace MathFunctions
             auto inexactSum = Expressions::InexactNumberExpression::numerical_type(numerator);
             inexactSum /= Expressions::InexactNumberExpression::numerical_type(denominator);
             return std::make_unique<Expressions::InexactNumberExpression>
-                    (Expressions::InexactNumberExpression(inexactSum + dSum,
-                                                          std::move(scope)));
+                    (Expressions::InexactNumberExpression(inexactSum + dSum, nullptr));
         }
 
+        countPromotion(sum);
         return std::unique_ptr<Expressions::Expression>
-                (new Expressions::NumericalValueExpression(sum,
-                                                           std::make_unique<Expressions::Scope>(
-                                                                   Expressions::Scope(
-                                                                           std::move(scope)))));
+                (new Expressions::NumericalValueExpression(std::move(sum), nullptr));
     }
 
-    expr_ptr sub_func(expression_vector expr, scope_ptr scope)
+    expr_ptr sub_func(expression_vector expr, const scope_ptr & /* scope */)
     {
         if (expr.empty()) throw std::invalid_argument("- expected at least 1 arg.");
 
@@ -66,9 +74,7 @@ namespace MathFunctions
             if (expr.size() == 1)
             {
                 return std::unique_ptr<Expressions::Expression>
-                        (new Expressions::NumericalValueExpression(-1 * first->value,
-                                                                   std::make_unique<Expressions::Scope>(
-                                                                           Expressions::Scope(std::move(scope)))));
+                        (new Expressions::NumericalValueExpression(-1 * first->value, nullptr));
             }
 
             diff = first->value;
@@ -78,9 +84,7 @@ namespace MathFunctions
             if (expr.size() == 1)
             {
                 return std::unique_ptr<Expressions::Expression>
-                        (new Expressions::InexactNumberExpression(-1 * dFirst->value,
-                                                                  std::make_unique<Expressions::Scope>(
-                                                                          Expressions::Scope(std::move(scope)))));
+                        (new Expressions::InexactNumberExpression(-1 * dFirst->value, nullptr));
             }
 
             returnFloating = true;
@@ -110,18 +114,15 @@ namespace MathFunctions
             auto inexactSum = Expressions::InexactNumberExpression::numerical_type(numerator);
             inexactSum /= Expressions::InexactNumberExpression::numerical_type(denominator);
             return std::make_unique<Expressions::InexactNumberExpression>
-                    (Expressions::InexactNumberExpression(inexactSum + dDiff,
-                                                          std::move(scope)));
+                    (Expressions::InexactNumberExpression(inexactSum + dDiff, nullptr));
         }
 
+        countPromotion(diff);
         return std::unique_ptr<Expressions::Expression>
-                (new Expressions::NumericalValueExpression(diff,
-                                                           std::make_unique<Expressions::Scope>(
-                                                                   Expressions::Scope(
-                                                                           std::move(scope)))));
+                (new Expressions::NumericalValueExpression(std::move(diff), nullptr));
     }
 
-    expr_ptr mult_func(expression_vector expr, scope_ptr scope)
+    expr_ptr mult_func(expression_vector expr, const scope_ptr & /* scope */)
     {
         Expressions::NumericalValueExpression::numerical_type product(1);
         Expressions::InexactNumberExpression::numerical_type dProd = 1.0;
@@ -148,18 +149,15 @@ namespace MathFunctions
             auto inexactSum = Expressions::InexactNumberExpression::numerical_type(numerator);
             inexactSum /= Expressions::InexactNumberExpression::numerical_type(denominator);
             return std::make_unique<Expressions::InexactNumberExpression>
-                    (Expressions::InexactNumberExpression(inexactSum * dProd,
-                                                          std::move(scope)));
+                    (Expressions::InexactNumberExpression(inexactSum * dProd, nullptr));
         }
 
+        countPromotion(product);
         return std::unique_ptr<Expressions::Expression>
-                (new Expressions::NumericalValueExpression(product,
-                                                           std::make_unique<Expressions::Scope>(
-                                                                   Expressions::Scope(
-                                                                           std::move(scope)))));
+                (new Expressions::NumericalValueExpression(std::move(product), nullptr));
     }
 
-    expr_ptr div_func(expression_vector expr, scope_ptr scope)
+    expr_ptr div_func(expression_vector expr, const scope_ptr & /* scope */)
     {
         if (expr.empty()) throw std::invalid_argument("/ expected at least 1 arg.");
 
@@ -172,9 +170,7 @@ namespace MathFunctions
             if (expr.size() == 1)
             {
                 return std::unique_ptr<Expressions::Expression>
-                        (new Expressions::NumericalValueExpression(quotient / first->value,
-                                                                   std::make_unique<Expressions::Scope>(
-                                                                           Expressions::Scope(std::move(scope)))));
+                        (new Expressions::NumericalValueExpression(quotient / first->value, nullptr));
             }
 
             quotient = first->value;
@@ -184,9 +180,7 @@ namespace MathFunctions
             if (expr.size() == 1)
             {
                 return std::unique_ptr<Expressions::Expression>
-                        (new Expressions::InexactNumberExpression(dQuot / dFirst->value,
-                                                                  std::make_unique<Expressions::Scope>(
-                                                                          Expressions::Scope(std::move(scope)))));
+                        (new Expressions::InexactNumberExpression(dQuot / dFirst->value, nullptr));
             }
 
             returnFloating = true;
@@ -216,12 +210,12 @@ namespace MathFunctions
             auto inexactQuot = Expressions::InexactNumberExpression::numerical_type(numerator);
             inexactQuot /= Expressions::InexactNumberExpression::numerical_type(denominator);
             return std::make_unique<Expressions::InexactNumberExpression>
-                    (Expressions::InexactNumberExpression(inexactQuot * dQuot,
-                                                          std::move(scope)));
+                    (Expressions::InexactNumberExpression(inexactQuot * dQuot, nullptr));
         }
 
+        countPromotion(quotient);
         return std::unique_ptr<Expressions::Expression>(new Expressions::NumericalValueExpression
-                                                                (quotient, std::move(scope)));
+                                                                (std::move(quotient), nullptr));
     }
 
     expr_ptr funcSqrt(expression_vector args, scope_ptr scope)
@@ -307,10 +301,35 @@ namespace MathFunctions
         }
     }
 
+    /* Index of the argument that is better than all others when every argument is a fixnum, args.size() if not */
+    template<typename Better>
+    size_t fixnumExtreme(const expression_vector &args, Better better)
+    {
+        long value, bestValue = 0;
+        size_t best = 0;
+
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            if (!Expressions::VectorExpression::asFixnum(*args[i], value)) return args.size();
+
+            if (i == 0 || better(value, bestValue))
+            {
+                best = i;
+                bestValue = value;
+            }
+        }
+
+        return best;
+    }
+
     expr_ptr funcMax(expression_vector args, scope_ptr scope)
     {
         if (args.empty()) throw std::invalid_argument("Error: Expected at least 1 argument, but found none.");
 
+        // Fixnums compare as longs, without copying GMP values around
+        size_t best = fixnumExtreme(args, std::greater<long>());
+        if (best < args.size()) return std::move(args[best]);
+
         Expressions::NumericalValueExpression::numerical_type rationalMax;
         Expressions::InexactNumberExpression::numerical_type inexactMax = 0;
         bool firstRational = true, firstInexact = true;
@@ -363,6 +382,9 @@ namespace MathFunctions
     {
         if (args.empty()) throw std::invalid_argument("Error: Expected at least 1 argument, but found none.");
 
+        size_t best = fixnumExtreme(args, std::less<long>());
+        if (best < args.size()) return std::move(args[best]);
+
         Expressions::NumericalValueExpression::numerical_type rationalMax;
         Expressions::InexactNumberExpression::numerical_type inexactMax = 0;
         bool firstRational = true, firstInexact = true;
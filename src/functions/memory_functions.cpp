@@ -0,0 +1,92 @@
+#include "functions.h"
+#include "../expressions/struct_expression.h"
+#include "../memory/gc.h"
+
+namespace MemoryFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+
+    expr_ptr heapStatsFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 0);
+        Memory::HeapStats stats = Memory::heapStats();
+        Memory::NurseryStats nursery = Memory::nurseryStats();
+
+        expression_vector fields;
+        fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(stats.liveScopes), scope));
+        fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(stats.collections), scope));
+        fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(stats.scopesReclaimed), scope));
+        fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type((long) (stats.lastPauseMs * 1000)), scope));
+        fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type((long) (stats.totalPauseMs * 1000)), scope));
+        fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(nursery.allocations), scope));
+        fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(nursery.chunkBytes), scope));
+
+        return Functions::functionsFor(scope.get()).at("make-heap-stats")(std::move(fields), std::move(scope));
+    }
+
+    expr_ptr runtimeStatsFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 0);
+        Interpreter::RuntimeStats stats = Interpreter::runtimeStats();
+
+        expression_vector fields;
+        for (size_t count : {stats.steps, stats.lambdaCalls, stats.builtinCalls, stats.scopeAllocations, stats.clones,
+                             stats.parses, stats.gmpPromotions})
+        {
+            fields.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                    (Expressions::NumericalValueExpression::numerical_type(count), scope));
+        }
+
+        /** Calls by builtin become a list of (name count) pairs */
+        std::list<expr_ptr> builtins;
+        for (auto &builtin : stats.callsByBuiltin)
+        {
+            std::list<expr_ptr> pair;
+            pair.push_back(std::make_unique<Expressions::StringExpression>(builtin.first, scope));
+            pair.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                    (Expressions::NumericalValueExpression::numerical_type(builtin.second), scope));
+
+            builtins.push_back(std::make_unique<Expressions::ListExpression>(std::move(pair), scope));
+        }
+        fields.push_back(std::make_unique<Expressions::ListExpression>(std::move(builtins), scope));
+
+        return Functions::functionsFor(scope.get()).at("make-runtime-stats")(std::move(fields), std::move(scope));
+    }
+
+    expr_ptr collectGarbageFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 0);
+
+        // Expressions being evaluated right now aren't roots, so the collection runs once this input is done
+        Memory::requestCollection();
+
+        return std::make_unique<Expressions::VoidValueExpression>
+                (Expressions::VoidValueExpression(std::move(scope)));
+    }
+}
+
+void register_memory_functions()
+{
+    StructFunctions::addStructFunctions(Functions::funcMap, "heap-stats",
+                                        std::vector<std::string>{"live-scopes", "collections", "reclaimed",
+                                                                 "last-pause-us", "total-pause-us",
+                                                                 "nursery-allocations", "nursery-bytes"});
+
+    StructFunctions::addStructFunctions(Functions::funcMap, "runtime-stats",
+                                        std::vector<std::string>{"steps", "lambda-calls", "builtin-calls",
+                                                                 "scope-allocations", "clones", "parses",
+                                                                 "gmp-promotions", "calls-by-builtin"});
+
+    Functions::funcMap["heap-stats"] = MemoryFunctions::heapStatsFn;
+    Functions::funcMap["runtime-stats"] = MemoryFunctions::runtimeStatsFn;
+    Functions::funcMap["collect-garbage"] = MemoryFunctions::collectGarbageFn;
+}
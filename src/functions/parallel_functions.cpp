@@ -0,0 +1,157 @@
+#include <thread>
+
+#include "functions.h"
+#include "../interpret/interpret.h"
+#include "../interpret/budget.h"
+#include "../interpret/profiler.h"
+#include "../interpret/thread_pool.h"
+
+namespace ParallelFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+    using Functions::asFunction;
+
+    Expressions::ListExpression *asList(const expr_ptr &expr)
+    {
+        if (auto list = dynamic_cast<Expressions::ListExpression *>(expr.get())) return list;
+
+        throw std::invalid_argument("Expected list, found " + expr->toString());
+    }
+
+    /**
+     * Runs body(i) for every i across the shared pool. Work done on other threads prints where the caller
+     * prints, and every thread draws from the caller's step allowance and stops at its deadline.
+     */
+    void parallelApply(size_t count, const std::function<void(size_t)> &body)
+    {
+        std::ostream *out = &Functions::output();
+        std::thread::id caller = std::this_thread::get_id();
+        Interpreter::SharedBudget share;
+
+        Interpreter::ThreadPool::shared().parallelFor(count, [&](size_t i)
+        {
+            Interpreter::BudgetScope scope(share);
+
+            if (std::this_thread::get_id() == caller)
+            {
+                body(i);
+                return;
+            }
+
+            if (Profiler::enabled) Profiler::resetClock();
+
+            Functions::OutputRedirect redirect(out);
+            body(i);
+        });
+
+        share.chargeHelpers();
+    }
+
+    expr_ptr call(Expressions::FunctionExpression *func, expression_vector params)
+    {
+        return Interpreter::interpret(func->call(std::move(params)));
+    }
+
+    expr_ptr toList(expression_vector elements, scope_ptr scope)
+    {
+        std::list<expr_ptr> list;
+        for (auto &element : elements) list.push_back(std::move(element));
+
+        return std::make_unique<Expressions::ListExpression>(std::move(list), std::move(scope));
+    }
+
+    expr_ptr pmapFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.size() < 2)
+            throw std::invalid_argument("Expected at least 2 arguments, found " + std::to_string(args.size()));
+
+        Expressions::FunctionExpression *func = asFunction(args[0]);
+
+        /** Lay the lists out so every call's arguments can be found by index */
+        std::vector<expression_vector> columns;
+        for (size_t i = 1; i < args.size(); ++i)
+        {
+            expression_vector column;
+            for (auto &element : asList(args[i])->list) column.push_back(std::move(element));
+
+            if (!columns.empty() && column.size() != columns.front().size())
+                throw std::invalid_argument("List length mismatch, expected " + std::to_string(columns.front().size())
+                                            + ", found " + std::to_string(column.size()));
+
+            columns.push_back(std::move(column));
+        }
+
+        expression_vector results(columns.front().size());
+        parallelApply(results.size(), [&](size_t i)
+        {
+            expression_vector params;
+            for (auto &column : columns) params.push_back(std::move(column[i]));
+
+            results[i] = call(func, std::move(params));
+        });
+
+        return toList(std::move(results), std::move(scope));
+    }
+
+    expr_ptr pfilterFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        Expressions::FunctionExpression *func = asFunction(args[0]);
+
+        expression_vector elements;
+        for (auto &element : asList(args[1])->list) elements.push_back(std::move(element));
+
+        std::vector<char> keep(elements.size());
+        parallelApply(elements.size(), [&](size_t i)
+        {
+            expression_vector params;
+            params.push_back(elements[i]->clone());
+            expr_ptr test = call(func, std::move(params));
+
+            auto result = dynamic_cast<Expressions::BooleanValueExpression *>(test.get());
+            if (!result) throw std::invalid_argument("Expected boolean, found " + test->toString());
+
+            keep[i] = result->value;
+        });
+
+        expression_vector kept;
+        for (size_t i = 0; i < elements.size(); ++i)
+            if (keep[i]) kept.push_back(std::move(elements[i]));
+
+        return toList(std::move(kept), std::move(scope));
+    }
+
+    expr_ptr buildListParFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        auto count = dynamic_cast<Expressions::NumericalValueExpression *>(args[0].get());
+        if (!count || boost::multiprecision::denominator(count->value) != 1 || count->value < 0
+            || count->value > std::numeric_limits<long>::max())
+            throw std::invalid_argument("Expected natural number, found " + args[0]->toString());
+
+        Expressions::FunctionExpression *func = asFunction(args[1]);
+
+        expression_vector results(boost::multiprecision::numerator(count->value).convert_to<size_t>());
+        parallelApply(results.size(), [&](size_t i)
+        {
+            expression_vector params;
+            params.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                                     (Expressions::NumericalValueExpression::numerical_type(i), scope));
+
+            results[i] = call(func, std::move(params));
+        });
+
+        return toList(std::move(results), std::move(scope));
+    }
+}
+
+void register_parallel_functions()
+{
+    Functions::funcMap["pmap"] = ParallelFunctions::pmapFn;
+    Functions::funcMap["pfilter"] = ParallelFunctions::pfilterFn;
+    Functions::funcMap["build-list/par"] = ParallelFunctions::buildListParFn;
+}
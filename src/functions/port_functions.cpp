@@ -0,0 +1,498 @@
+#include <fstream>
+#include <iostream>
+
+#include "functions.h"
+#include "../interpret/interpret.h"
+#include "../expressions/port_expression.h"
+
+namespace PortFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+    using Functions::arg_range_check;
+    using Functions::asFunction;
+    using Expressions::PortExpression;
+
+    /* The port read-line, read-char, peek-char and read use when given none, stdin unless redirected */
+    thread_local std::shared_ptr<Expressions::PortState> currentInput;
+
+    std::shared_ptr<Expressions::PortState> standardInput()
+    {
+        static std::shared_ptr<Expressions::PortState> state = []
+        {
+            auto stdinState = std::make_shared<Expressions::PortState>();
+            stdinState->name = "stdin";
+            stdinState->input = &std::cin;
+            return stdinState;
+        }();
+
+        return state;
+    }
+
+    /* Points this thread's current input port at another port for as long as it is alive */
+    class InputRedirect
+    {
+    public:
+        explicit InputRedirect(std::shared_ptr<Expressions::PortState> port) : previous(std::move(currentInput))
+        {
+            currentInput = std::move(port);
+        }
+
+        ~InputRedirect()
+        {
+            currentInput = std::move(previous);
+        }
+
+    private:
+        std::shared_ptr<Expressions::PortState> previous;
+    };
+
+    PortExpression *asPort(const expr_ptr &expr)
+    {
+        if (auto port = dynamic_cast<PortExpression *>(expr.get())) return port;
+
+        throw std::invalid_argument("Expected port, found " + expr->toString());
+    }
+
+    std::string asString(const expr_ptr &expr)
+    {
+        if (auto str = dynamic_cast<Expressions::StringExpression *>(expr.get())) return str->str;
+
+        throw std::invalid_argument("Expected string, found " + expr->toString());
+    }
+
+    expr_ptr call(Expressions::FunctionExpression *func, expression_vector params)
+    {
+        return Interpreter::interpret(func->call(std::move(params)));
+    }
+
+    /* The port given at index, or the current input port */
+    Expressions::PortState &inputPort(const expression_vector &args, size_t index)
+    {
+        if (args.size() > index) return *asPort(args[index])->state;
+
+        return currentInput ? *currentInput : *standardInput();
+    }
+
+    /* Writes to the port given at index, or to the current output */
+    void print(const expression_vector &args, size_t index, const std::string &text)
+    {
+        if (args.size() > index) asPort(args[index])->state->write(text);
+        else Functions::output() << text;
+    }
+
+    expr_ptr voidValue(scope_ptr scope)
+    {
+        return std::make_unique<Expressions::VoidValueExpression>(Expressions::VoidValueExpression(std::move(scope)));
+    }
+
+    expr_ptr boolean(bool value, scope_ptr scope)
+    {
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(value, std::move(scope)));
+    }
+
+    /* Strings and characters are displayed as their contents, everything else as it is written */
+    std::string displayString(const Expressions::Expression &expr)
+    {
+        if (auto str = dynamic_cast<const Expressions::StringExpression *>(&expr)) return str->str;
+        if (auto chr = dynamic_cast<const Expressions::CharacterExpression *>(&expr))
+            return std::string(1, chr->character);
+
+        return expr.toString();
+    }
+
+    expr_ptr displayFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+
+        print(args, 1, displayString(*args[0]));
+        return voidValue(std::move(scope));
+    }
+
+    expr_ptr writeFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+
+        print(args, 1, args[0]->toString());
+        return voidValue(std::move(scope));
+    }
+
+    expr_ptr writeStringFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+
+        print(args, 1, asString(args[0]));
+        return voidValue(std::move(scope));
+    }
+
+    expr_ptr newlineFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        // Not std::endl, flushing every line would make printing a system call per line
+        print(args, 0, "\n");
+        return voidValue(std::move(scope));
+    }
+
+    expr_ptr flushOutputFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        if (!args.empty()) asPort(args[0])->state->flush();
+        else Functions::output().flush();
+
+        return voidValue(std::move(scope));
+    }
+
+    expr_ptr readLineFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        std::string line;
+        if (!inputPort(args, 0).readLine(line))
+            return std::make_unique<Expressions::EofExpression>(std::move(scope));
+
+        return std::make_unique<Expressions::StringExpression>(line, std::move(scope));
+    }
+
+    expr_ptr character(int chr, scope_ptr scope)
+    {
+        if (chr == EOF) return std::make_unique<Expressions::EofExpression>(std::move(scope));
+
+        return std::make_unique<Expressions::CharacterExpression>
+                (Expressions::CharacterExpression(static_cast<char>(chr), std::move(scope)));
+    }
+
+    expr_ptr readCharFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        return character(inputPort(args, 0).readChar(), std::move(scope));
+    }
+
+    expr_ptr peekCharFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        return character(inputPort(args, 0).peekChar(), std::move(scope));
+    }
+
+    /**
+     * The value of a datum's text, as if it had been quoted. Lists are read element by element, so booleans
+     * inside them are booleans, and 'datum reads as (quote datum).
+     */
+    expr_ptr datumValue(const std::string &datum, const scope_ptr &scope)
+    {
+        if (datum == "#t" || datum == "#true" || datum == "true") return boolean(true, scope);
+        if (datum == "#f" || datum == "#false" || datum == "false") return boolean(false, scope);
+
+        char first = datum.front();
+        if (first == '(' || first == '[')
+        {
+            std::list<expr_ptr> elements;
+            for (auto &element : Parser::parseTuple(datum)) elements.push_back(datumValue(element, scope));
+
+            return std::make_unique<Expressions::ListExpression>(std::move(elements), scope);
+        }
+
+        if ((first == '\'' || first == '`') && datum.size() > 1)
+        {
+            std::list<expr_ptr> quoted;
+            quoted.push_back(Parser::parse(first == '\'' ? "'quote" : "'quasiquote", scope));
+            quoted.push_back(datumValue(datum.substr(1), scope));
+
+            return std::make_unique<Expressions::ListExpression>(std::move(quoted), scope);
+        }
+
+        if (first == '"' || (first == '#' && datum.size() > 2 && datum[1] == '\\') || Parser::isNumber(datum))
+            return Parser::parse(datum, scope);
+
+        return Parser::parse("'" + datum, scope);
+    }
+
+    expr_ptr readFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 0, 1);
+
+        std::string datum;
+        if (!inputPort(args, 0).readDatum(datum))
+            return std::make_unique<Expressions::EofExpression>(std::move(scope));
+
+        return datumValue(datum, scope);
+    }
+
+    expr_ptr openInputFileFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return PortExpression::openInputFile(asString(args[0]), std::move(scope));
+    }
+
+    /* (open-output-file path [mode]), mode being 'replace or 'truncate (the default) or 'append */
+    expr_ptr openOutputFileFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+
+        bool append = false;
+        if (args.size() == 2)
+        {
+            auto mode = dynamic_cast<Expressions::SymbolExpression *>(args[1].get());
+            // The symbol keeps the quote it was written with
+            std::string name = mode ? mode->symbol.substr(1) : "";
+            if (name != "append" && name != "replace" && name != "truncate")
+                throw std::invalid_argument("Expected 'append, 'replace or 'truncate, found " + args[1]->toString());
+
+            append = name == "append";
+        }
+
+        return PortExpression::openOutputFile(asString(args[0]), append, std::move(scope));
+    }
+
+    expr_ptr closeInputPortFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        PortExpression *port = asPort(args[0]);
+        if (!port->isInput()) throw std::invalid_argument("Expected input port, found " + port->toString());
+
+        port->state->close();
+        return voidValue(std::move(scope));
+    }
+
+    expr_ptr closeOutputPortFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        PortExpression *port = asPort(args[0]);
+        if (!port->isOutput()) throw std::invalid_argument("Expected output port, found " + port->toString());
+
+        port->state->close();
+        return voidValue(std::move(scope));
+    }
+
+    expr_ptr openInputStringFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return PortExpression::inputString(asString(args[0]), std::move(scope));
+    }
+
+    expr_ptr openOutputStringFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 0);
+
+        return PortExpression::outputString(std::move(scope));
+    }
+
+    expr_ptr getOutputStringFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::StringExpression>(asPort(args[0])->state->outputString(), std::move(scope));
+    }
+
+    /* The current output, only valid for as long as the thread prints there */
+    expr_ptr currentOutputPortFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 0);
+
+        return PortExpression::wrap(nullptr, &Functions::output(), "stdout", std::move(scope));
+    }
+
+    expr_ptr currentInputPortFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 0);
+
+        return std::make_unique<PortExpression>(currentInput ? currentInput : standardInput(), std::move(scope));
+    }
+
+    /* Closes a port when leaving the function that opened it, however it is left */
+    class PortCloser
+    {
+    public:
+        explicit PortCloser(PortExpression &port) : port(port)
+        {}
+
+        ~PortCloser()
+        {
+            port.state->close();
+        }
+
+    private:
+        PortExpression &port;
+    };
+
+    expr_ptr withOutputToStringFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        std::ostringstream output;
+        {
+            Functions::OutputRedirect redirect(&output);
+            call(asFunction(args[0]), expression_vector());
+        }
+
+        return std::make_unique<Expressions::StringExpression>(output.str(), std::move(scope));
+    }
+
+    expr_ptr withOutputToFileFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        Expressions::FunctionExpression *thunk = asFunction(args[1]);
+        auto port = PortExpression::openOutputFile(asString(args[0]), false, scope);
+        PortCloser closer(*port);
+
+        Functions::OutputRedirect redirect(port->state->output);
+        return call(thunk, expression_vector());
+    }
+
+    expr_ptr withInputFromFileFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        Expressions::FunctionExpression *thunk = asFunction(args[1]);
+        auto port = PortExpression::openInputFile(asString(args[0]), scope);
+        PortCloser closer(*port);
+
+        InputRedirect redirect(port->state);
+        return call(thunk, expression_vector());
+    }
+
+    expr_ptr withInputFromStringFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        Expressions::FunctionExpression *thunk = asFunction(args[1]);
+        InputRedirect redirect(PortExpression::inputString(asString(args[0]), scope)->state);
+
+        return call(thunk, expression_vector());
+    }
+
+    /* Calls proc with port, then closes port */
+    expr_ptr callWithPort(Expressions::FunctionExpression *proc, std::unique_ptr<PortExpression> port)
+    {
+        PortCloser closer(*port);
+
+        expression_vector params;
+        params.push_back(port->clone());
+        return call(proc, std::move(params));
+    }
+
+    expr_ptr callWithInputFileFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        Expressions::FunctionExpression *proc = asFunction(args[1]);
+        return callWithPort(proc, PortExpression::openInputFile(asString(args[0]), std::move(scope)));
+    }
+
+    expr_ptr callWithOutputFileFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        Expressions::FunctionExpression *proc = asFunction(args[1]);
+        return callWithPort(proc, PortExpression::openOutputFile(asString(args[0]), false, std::move(scope)));
+    }
+
+    expr_ptr callWithOutputStringFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto port = PortExpression::outputString(scope);
+        expression_vector params;
+        params.push_back(port->clone());
+        call(asFunction(args[0]), std::move(params));
+
+        return std::make_unique<Expressions::StringExpression>(port->state->outputString(), std::move(scope));
+    }
+
+    expr_ptr portPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return boolean(args[0]->type() == "PortExpression", std::move(scope));
+    }
+
+    expr_ptr inputPortPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto port = dynamic_cast<PortExpression *>(args[0].get());
+        return boolean(port && port->isInput(), std::move(scope));
+    }
+
+    expr_ptr outputPortPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto port = dynamic_cast<PortExpression *>(args[0].get());
+        return boolean(port && port->isOutput(), std::move(scope));
+    }
+
+    expr_ptr portClosedPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return boolean(asPort(args[0])->state->isClosed(), std::move(scope));
+    }
+
+    expr_ptr eofObjectPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return boolean(args[0]->type() == "EofExpression", std::move(scope));
+    }
+
+    expr_ptr fileExistsPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return boolean(std::ifstream(asString(args[0])).good(), std::move(scope));
+    }
+}
+
+void register_port_functions()
+{
+    Functions::funcMap["display"] = PortFunctions::displayFn;
+    Functions::funcMap["write"] = PortFunctions::writeFn;
+    Functions::funcMap["write-string"] = PortFunctions::writeStringFn;
+    Functions::funcMap["newline"] = PortFunctions::newlineFn;
+    Functions::funcMap["flush-output"] = PortFunctions::flushOutputFn;
+    Functions::funcMap["read-line"] = PortFunctions::readLineFn;
+    Functions::funcMap["read-char"] = PortFunctions::readCharFn;
+    Functions::funcMap["peek-char"] = PortFunctions::peekCharFn;
+    Functions::funcMap["read"] = PortFunctions::readFn;
+    Functions::funcMap["open-input-file"] = PortFunctions::openInputFileFn;
+    Functions::funcMap["open-output-file"] = PortFunctions::openOutputFileFn;
+    Functions::funcMap["close-input-port"] = PortFunctions::closeInputPortFn;
+    Functions::funcMap["close-output-port"] = PortFunctions::closeOutputPortFn;
+    Functions::funcMap["open-input-string"] = PortFunctions::openInputStringFn;
+    Functions::funcMap["open-output-string"] = PortFunctions::openOutputStringFn;
+    Functions::funcMap["get-output-string"] = PortFunctions::getOutputStringFn;
+    Functions::funcMap["current-output-port"] = PortFunctions::currentOutputPortFn;
+    Functions::funcMap["current-input-port"] = PortFunctions::currentInputPortFn;
+    Functions::funcMap["with-output-to-string"] = PortFunctions::withOutputToStringFn;
+    Functions::funcMap["with-output-to-file"] = PortFunctions::withOutputToFileFn;
+    Functions::funcMap["with-input-from-file"] = PortFunctions::withInputFromFileFn;
+    Functions::funcMap["with-input-from-string"] = PortFunctions::withInputFromStringFn;
+    Functions::funcMap["call-with-input-file"] = PortFunctions::callWithInputFileFn;
+    Functions::funcMap["call-with-output-file"] = PortFunctions::callWithOutputFileFn;
+    Functions::funcMap["call-with-output-string"] = PortFunctions::callWithOutputStringFn;
+    Functions::funcMap["port?"] = PortFunctions::portPredicate;
+    Functions::funcMap["input-port?"] = PortFunctions::inputPortPredicate;
+    Functions::funcMap["output-port?"] = PortFunctions::outputPortPredicate;
+    Functions::funcMap["port-closed?"] = PortFunctions::portClosedPredicate;
+    Functions::funcMap["eof-object?"] = PortFunctions::eofObjectPredicate;
+    Functions::funcMap["file-exists?"] = PortFunctions::fileExistsPredicate;
+
+    Functions::impureFunctions.insert({"write", "write-string", "read-line", "read-char", "peek-char", "read",
+                                       "open-input-file", "open-output-file", "close-input-port",
+                                       "close-output-port", "open-input-string", "open-output-string",
+                                       "get-output-string", "current-output-port", "current-input-port",
+                                       "with-output-to-string", "with-output-to-file", "with-input-from-file",
+                                       "with-input-from-string", "call-with-input-file", "call-with-output-file",
+                                       "call-with-output-string", "port-closed?", "file-exists?"});
+}
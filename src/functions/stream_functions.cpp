@@ -0,0 +1,491 @@
+#include "functions.h"
+#include "../interpret/interpret.h"
+#include "../expressions/port_expression.h"
+#include "../expressions/promise_expression.h"
+
+namespace StreamFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    typedef Expressions::NumericalValueExpression::numerical_type numerical_type;
+    using Expressions::expression_vector;
+    using Functions::asFunction;
+    using Expressions::PromiseState;
+    using Expressions::StreamExpression;
+
+    numerical_type asNumber(const expr_ptr &expr)
+    {
+        if (auto num = dynamic_cast<Expressions::NumericalValueExpression *>(expr.get())) return num->value;
+
+        throw std::invalid_argument("Expected number, found " + expr->toString());
+    }
+
+    expr_ptr number(const numerical_type &value, scope_ptr scope)
+    {
+        return std::make_unique<Expressions::NumericalValueExpression>(value, std::move(scope));
+    }
+
+    expr_ptr boolean(bool value, scope_ptr scope)
+    {
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(value, std::move(scope)));
+    }
+
+    expr_ptr emptyStream(scope_ptr scope)
+    {
+        return std::make_unique<Expressions::ListExpression>(std::list<expr_ptr>(), std::move(scope));
+    }
+
+    expr_ptr call(const expr_ptr &func, expression_vector params)
+    {
+        return Interpreter::interpret(asFunction(func)->call(std::move(params)));
+    }
+
+    /* A procedure of no arguments evaluating body where the special form was used, built the way lambda would */
+    expr_ptr makeThunk(const std::string &body, const scope_ptr &scope)
+    {
+        return Interpreter::interpret(Parser::parse("(lambda () " + body + ")", scope));
+    }
+
+    bool isStream(const Expressions::Expression &expr)
+    {
+        return dynamic_cast<const StreamExpression *>(&expr)
+               || dynamic_cast<const Expressions::ListExpression *>(&expr);
+    }
+
+    void stream_check(const expr_ptr &expr)
+    {
+        if (!isStream(*expr)) throw std::invalid_argument("Expected stream, found " + expr->toString());
+    }
+
+    bool isEmpty(const Expressions::Expression &stream)
+    {
+        auto list = dynamic_cast<const Expressions::ListExpression *>(&stream);
+        return list && list->list.empty();
+    }
+
+    expr_ptr firstOf(Expressions::Expression &stream)
+    {
+        if (auto cell = dynamic_cast<StreamExpression *>(&stream)) return cell->first->force();
+
+        auto &list = dynamic_cast<Expressions::ListExpression &>(stream).list;
+        if (list.empty()) throw std::invalid_argument("Expected non-empty stream, found empty");
+
+        return list.front()->clone();
+    }
+
+    /* Takes the stream apart, a list loses its first element in place instead of being copied */
+    expr_ptr restOf(expr_ptr stream)
+    {
+        if (auto cell = dynamic_cast<StreamExpression *>(stream.get()))
+        {
+            expr_ptr rest = cell->rest->force();
+            if (!isStream(*rest))
+                throw std::invalid_argument("Expected the rest of a stream, found " + rest->toString());
+
+            return rest;
+        }
+
+        auto &list = dynamic_cast<Expressions::ListExpression &>(*stream).list;
+        if (list.empty()) throw std::invalid_argument("Expected non-empty stream, found empty");
+
+        list.pop_front();
+        return stream;
+    }
+
+    /* The stream's first element without the rest, to give a promise that only needs the first element */
+    expr_ptr headOf(const expr_ptr &stream)
+    {
+        if (auto cell = dynamic_cast<StreamExpression *>(stream.get()))
+            return std::make_unique<StreamExpression>(cell->first, PromiseState::ofValue(emptyStream(nullptr)),
+                                                      stream->localScope);
+
+        std::list<expr_ptr> head;
+        head.push_back(firstOf(*stream));
+        return std::make_unique<Expressions::ListExpression>(std::move(head), stream->localScope);
+    }
+
+    expr_ptr cell(std::shared_ptr<PromiseState> first, std::shared_ptr<PromiseState> rest, scope_ptr scope)
+    {
+        return std::make_unique<StreamExpression>(std::move(first), std::move(rest), std::move(scope));
+    }
+
+    expr_ptr delayForm(expression_vector args, scope_ptr scope)
+    {
+        if (args.empty()) throw std::invalid_argument("delay: Expected a body, found none");
+
+        std::string body = args[0]->toString();
+        if (args.size() > 1)
+        {
+            body = "(begin";
+            for (auto &arg : args) body += " " + arg->toString();
+            body += ")";
+        }
+
+        auto state = PromiseState::ofThunk(makeThunk(body, scope));
+        return std::make_unique<Expressions::PromiseExpression>(std::move(state), std::move(scope));
+    }
+
+    expr_ptr forceFn(expression_vector args, scope_ptr /* scope */)
+    {
+        Functions::arg_count_check(args, 1);
+
+        if (auto promise = dynamic_cast<Expressions::PromiseExpression *>(args[0].get()))
+            return promise->state->force();
+
+        return std::move(args[0]);
+    }
+
+    expr_ptr makePromiseFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto state = PromiseState::ofValue(std::move(args[0]));
+        return std::make_unique<Expressions::PromiseExpression>(std::move(state), std::move(scope));
+    }
+
+    expr_ptr promisePredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return boolean(args[0]->type() == "PromiseExpression", std::move(scope));
+    }
+
+    expr_ptr promiseForcedPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto promise = dynamic_cast<Expressions::PromiseExpression *>(args[0].get());
+        if (!promise) throw std::invalid_argument("Expected promise, found " + args[0]->toString());
+
+        return boolean(promise->state->isForced(), std::move(scope));
+    }
+
+    expr_ptr streamConsForm(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        auto first = PromiseState::ofThunk(makeThunk(args[0]->toString(), scope));
+        auto rest = PromiseState::ofThunk(makeThunk(args[1]->toString(), scope));
+        return cell(std::move(first), std::move(rest), std::move(scope));
+    }
+
+    expr_ptr streamPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return boolean(isStream(*args[0]), std::move(scope));
+    }
+
+    expr_ptr streamEmptyPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+        stream_check(args[0]);
+
+        return boolean(isEmpty(*args[0]), std::move(scope));
+    }
+
+    expr_ptr streamFirstFn(expression_vector args, scope_ptr /* scope */)
+    {
+        Functions::arg_count_check(args, 1);
+        stream_check(args[0]);
+
+        return firstOf(*args[0]);
+    }
+
+    expr_ptr streamRestFn(expression_vector args, scope_ptr /* scope */)
+    {
+        Functions::arg_count_check(args, 1);
+        stream_check(args[0]);
+
+        return restOf(std::move(args[0]));
+    }
+
+    expr_ptr streamRefFn(expression_vector args, scope_ptr /* scope */)
+    {
+        Functions::arg_count_check(args, 2);
+        stream_check(args[0]);
+
+        numerical_type index = asNumber(args[1]);
+        if (index < 0 || denominator(index) != 1)
+            throw std::invalid_argument("Expected a natural number, found " + args[1]->toString());
+
+        expr_ptr stream = std::move(args[0]);
+        for (numerical_type i = 0; i < index; ++i) stream = restOf(std::move(stream));
+
+        return firstOf(*stream);
+    }
+
+    expr_ptr mapStream(expr_ptr func, expr_ptr stream, const scope_ptr &scope)
+    {
+        if (isEmpty(*stream)) return stream;
+
+        expression_vector firstOperands;
+        firstOperands.push_back(func->clone());
+        firstOperands.push_back(headOf(stream));
+
+        auto first = PromiseState::ofStep([](expression_vector &operands, const scope_ptr &)
+                                          {
+                                              expression_vector params;
+                                              params.push_back(firstOf(*operands[1]));
+                                              return call(operands[0], std::move(params));
+                                          }, std::move(firstOperands), nullptr);
+
+        expression_vector restOperands;
+        restOperands.push_back(std::move(func));
+        restOperands.push_back(std::move(stream));
+
+        auto rest = PromiseState::ofStep([](expression_vector &operands, const scope_ptr &scope)
+                                         {
+                                             return mapStream(std::move(operands[0]),
+                                                              restOf(std::move(operands[1])), scope);
+                                         }, std::move(restOperands), scope);
+
+        return cell(std::move(first), std::move(rest), scope);
+    }
+
+    expr_ptr streamMapFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+        asFunction(args[0]);
+        stream_check(args[1]);
+
+        return mapStream(std::move(args[0]), std::move(args[1]), scope);
+    }
+
+    /* Forces the stream up to the first element kept, the search for the next one waits until it is needed */
+    expr_ptr filterStream(expr_ptr func, expr_ptr stream, const scope_ptr &scope)
+    {
+        while (!isEmpty(*stream))
+        {
+            expr_ptr elem = firstOf(*stream);
+
+            expression_vector params;
+            params.push_back(elem->clone());
+            expr_ptr test = call(func, std::move(params));
+
+            auto keep = dynamic_cast<Expressions::BooleanValueExpression *>(test.get());
+            if (!keep) throw std::invalid_argument("Expected boolean, found " + test->toString());
+
+            if (keep->value)
+            {
+                expression_vector restOperands;
+                restOperands.push_back(std::move(func));
+                restOperands.push_back(std::move(stream));
+
+                auto rest = PromiseState::ofStep([](expression_vector &operands, const scope_ptr &scope)
+                                                 {
+                                                     return filterStream(std::move(operands[0]),
+                                                                         restOf(std::move(operands[1])), scope);
+                                                 }, std::move(restOperands), scope);
+
+                return cell(PromiseState::ofValue(std::move(elem)), std::move(rest), scope);
+            }
+
+            stream = restOf(std::move(stream));
+        }
+
+        return stream;
+    }
+
+    expr_ptr streamFilterFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+        asFunction(args[0]);
+        stream_check(args[1]);
+
+        return filterStream(std::move(args[0]), std::move(args[1]), scope);
+    }
+
+    expr_ptr takeStream(expr_ptr stream, const numerical_type &count, const scope_ptr &scope)
+    {
+        if (count <= 0 || isEmpty(*stream)) return emptyStream(scope);
+
+        auto first = PromiseState::ofValue(firstOf(*stream));
+
+        expression_vector restOperands;
+        restOperands.push_back(std::move(stream));
+        restOperands.push_back(number(count - 1, scope));
+
+        auto rest = PromiseState::ofStep([](expression_vector &operands, const scope_ptr &scope)
+                                         {
+                                             return takeStream(restOf(std::move(operands[0])),
+                                                               asNumber(operands[1]), scope);
+                                         }, std::move(restOperands), scope);
+
+        return cell(std::move(first), std::move(rest), scope);
+    }
+
+    expr_ptr streamTakeFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+        stream_check(args[0]);
+
+        return takeStream(std::move(args[0]), asNumber(args[1]), scope);
+    }
+
+    expr_ptr streamToListFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+        stream_check(args[0]);
+
+        std::list<expr_ptr> elements;
+        for (expr_ptr stream = std::move(args[0]); !isEmpty(*stream); stream = restOf(std::move(stream)))
+            elements.push_back(firstOf(*stream));
+
+        return std::make_unique<Expressions::ListExpression>(std::move(elements), std::move(scope));
+    }
+
+    expr_ptr streamFoldFn(expression_vector args, scope_ptr /* scope */)
+    {
+        Functions::arg_count_check(args, 3);
+        asFunction(args[0]);
+        stream_check(args[2]);
+
+        expr_ptr accumulator = std::move(args[1]);
+        for (expr_ptr stream = std::move(args[2]); !isEmpty(*stream); stream = restOf(std::move(stream)))
+        {
+            expression_vector params;
+            params.push_back(std::move(accumulator));
+            params.push_back(firstOf(*stream));
+            accumulator = call(args[0], std::move(params));
+        }
+
+        return accumulator;
+    }
+
+    expr_ptr streamForEachFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+        asFunction(args[0]);
+        stream_check(args[1]);
+
+        for (expr_ptr stream = std::move(args[1]); !isEmpty(*stream); stream = restOf(std::move(stream)))
+        {
+            expression_vector params;
+            params.push_back(firstOf(*stream));
+            call(args[0], std::move(params));
+        }
+
+        return std::make_unique<Expressions::VoidValueExpression>(std::move(scope));
+    }
+
+    expr_ptr rangeStream(const numerical_type &start, const numerical_type &end, const numerical_type &step,
+                         const scope_ptr &scope)
+    {
+        if (step > 0 ? start >= end : start <= end) return emptyStream(scope);
+
+        expression_vector restOperands;
+        restOperands.push_back(number(start + step, scope));
+        restOperands.push_back(number(end, scope));
+        restOperands.push_back(number(step, scope));
+
+        auto rest = PromiseState::ofStep([](expression_vector &operands, const scope_ptr &scope)
+                                         {
+                                             return rangeStream(asNumber(operands[0]), asNumber(operands[1]),
+                                                                asNumber(operands[2]), scope);
+                                         }, std::move(restOperands), scope);
+
+        return cell(PromiseState::ofValue(number(start, scope)), std::move(rest), scope);
+    }
+
+    expr_ptr inRangeFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.empty() || args.size() > 3)
+            throw std::invalid_argument("Error: Expected 1 to 3 argument(s), found " + std::to_string(args.size())
+                                        + ".");
+
+        numerical_type start = 0, end, step = 1;
+        if (args.size() == 1) end = asNumber(args[0]);
+        else
+        {
+            start = asNumber(args[0]);
+            end = asNumber(args[1]);
+        }
+        if (args.size() == 3) step = asNumber(args[2]);
+
+        if (step == 0) throw std::invalid_argument("in-range: Expected a non-zero step");
+
+        return rangeStream(start, end, step, scope);
+    }
+
+    expr_ptr naturalsStream(const numerical_type &start, const scope_ptr &scope)
+    {
+        expression_vector restOperands;
+        restOperands.push_back(number(start + 1, scope));
+
+        auto rest = PromiseState::ofStep([](expression_vector &operands, const scope_ptr &scope)
+                                         {
+                                             return naturalsStream(asNumber(operands[0]), scope);
+                                         }, std::move(restOperands), scope);
+
+        return cell(PromiseState::ofValue(number(start, scope)), std::move(rest), scope);
+    }
+
+    expr_ptr inNaturalsFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.size() > 1)
+            throw std::invalid_argument("Error: Expected 0 to 1 argument(s), found " + std::to_string(args.size())
+                                        + ".");
+
+        return naturalsStream(args.empty() ? numerical_type(0) : asNumber(args[0]), scope);
+    }
+
+    /* Reads a line only when the cell before it is taken apart */
+    expr_ptr linesStream(expr_ptr port, const scope_ptr &scope)
+    {
+        std::string line;
+        if (!dynamic_cast<Expressions::PortExpression &>(*port).state->readLine(line)) return emptyStream(scope);
+
+        expression_vector restOperands;
+        restOperands.push_back(std::move(port));
+
+        auto rest = PromiseState::ofStep([](expression_vector &operands, const scope_ptr &scope)
+                                         {
+                                             return linesStream(std::move(operands[0]), scope);
+                                         }, std::move(restOperands), scope);
+
+        return cell(PromiseState::ofValue(std::make_unique<Expressions::StringExpression>(line, scope)),
+                    std::move(rest), scope);
+    }
+
+    expr_ptr inLinesFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto port = dynamic_cast<Expressions::PortExpression *>(args[0].get());
+        if (!port || !port->isInput()) throw std::invalid_argument("Expected input port, found " + args[0]->toString());
+
+        return linesStream(std::move(args[0]), scope);
+    }
+}
+
+void register_stream_functions()
+{
+    Functions::specialFormMap["delay"] = StreamFunctions::delayForm;
+    Functions::specialFormMap["stream-cons"] = StreamFunctions::streamConsForm;
+
+    Functions::funcMap["force"] = StreamFunctions::forceFn;
+    Functions::funcMap["make-promise"] = StreamFunctions::makePromiseFn;
+    Functions::funcMap["promise?"] = StreamFunctions::promisePredicate;
+    Functions::funcMap["promise-forced?"] = StreamFunctions::promiseForcedPredicate;
+    Functions::funcMap["stream?"] = StreamFunctions::streamPredicate;
+    Functions::funcMap["stream-empty?"] = StreamFunctions::streamEmptyPredicate;
+    Functions::funcMap["stream-first"] = StreamFunctions::streamFirstFn;
+    Functions::funcMap["stream-rest"] = StreamFunctions::streamRestFn;
+    Functions::funcMap["stream-ref"] = StreamFunctions::streamRefFn;
+    Functions::funcMap["stream-map"] = StreamFunctions::streamMapFn;
+    Functions::funcMap["stream-filter"] = StreamFunctions::streamFilterFn;
+    Functions::funcMap["stream-take"] = StreamFunctions::streamTakeFn;
+    Functions::funcMap["stream->list"] = StreamFunctions::streamToListFn;
+    Functions::funcMap["stream-fold"] = StreamFunctions::streamFoldFn;
+    Functions::funcMap["stream-for-each"] = StreamFunctions::streamForEachFn;
+    Functions::funcMap["in-range"] = StreamFunctions::inRangeFn;
+    Functions::funcMap["in-naturals"] = StreamFunctions::inNaturalsFn;
+    Functions::funcMap["in-lines"] = StreamFunctions::inLinesFn;
+
+    // Forcing runs code that may have side effects, and whether a promise was forced changes as it is
+    Functions::impureFunctions.insert({"delay", "stream-cons", "force", "promise-forced?", "stream-first",
+                                       "stream-rest", "stream-ref", "stream-map", "stream-filter", "stream-take",
+                                       "stream->list", "stream-fold", "stream-for-each", "in-lines"});
+}
@@ -27,7 +27,7 @@ namespace StringFunctions
 
         return std::make_unique<Expressions::BooleanValueExpression>
                 (Expressions::BooleanValueExpression(
-                        args[0]->toString() == args[1]->toString(),
+                        args[0]->equals(*args[1]),
                         std::move(scope)));
     }
 
@@ -251,7 +251,7 @@ namespace CharacterFunctions
 
         return std::make_unique<Expressions::BooleanValueExpression>
                 (Expressions::BooleanValueExpression(
-                        args[0]->toString() == args[1]->toString(),
+                        args[0]->equals(*args[1]),
                         std::move(scope)));
     }
 
@@ -20,7 +20,7 @@ namespace SymbolFunctions
 
         return std::make_unique<Expressions::BooleanValueExpression>
                 (Expressions::BooleanValueExpression(
-                        args[0]->toString() == args[1]->toString(),
+                        args[0]->equals(*args[1]),
                         std::move(scope)));
     }
 
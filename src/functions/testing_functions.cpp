@@ -2,19 +2,29 @@
 // Created by Antonio Abbatangelo on 2019-06-02.
 //
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <list>
+#include <sstream>
 #include "functions.h"
 #include "../interpret/interpret.h"
+#include "../interpret/thread_pool.h"
+#include "../interpret/budget.h"
+#include "../interpret/context.h"
 
 namespace TestingFunctions
 {
-    struct TestCase
+    void queueTestCase(TestCase testCase, const std::shared_ptr<Expressions::Scope> &scope)
     {
-        std::unique_ptr<Expressions::Expression> test, expected;
-        Expressions::InexactNumberExpression::numerical_type within;
-    };
+        Interpreter::Context &context = Interpreter::Context::of(*scope);
 
-    std::list<TestCase> testCases;
+        std::lock_guard<std::mutex> guard(context.testCasesLock);
+        context.testCases.push_back(std::move(testCase));
+    }
+
+    TestOptions testOptions;
 
     std::unique_ptr<Expressions::Expression> check_expect_fn(Expressions::expression_vector expr,
                                                              std::shared_ptr<Expressions::Scope> scope)
@@ -22,7 +32,7 @@ namespace TestingFunctions
         if (expr.size() != 2) throw std::invalid_argument("check-expect: Expected 2 params");
 
         struct TestCase testCase = {std::move(expr[0]), std::move(expr[1]), 0};
-        testCases.push_back(std::move(testCase));
+        queueTestCase(std::move(testCase), scope);
 
         return std::unique_ptr<Expressions::Expression>
                 (new Expressions::VoidValueExpression(
@@ -43,7 +53,7 @@ namespace TestingFunctions
         else throw std::invalid_argument("Expected number, got " + expr[2]->toString());
 
         struct TestCase testCase = {std::move(expr[0]), std::move(expr[1]), within};
-        testCases.push_back(std::move(testCase));
+        queueTestCase(std::move(testCase), scope);
 
         return std::unique_ptr<Expressions::Expression>
                 (new Expressions::VoidValueExpression(
@@ -71,36 +81,214 @@ namespace TestingFunctions
         return boost::multiprecision::abs(n1 - n2) <= within;
     }
 
+    struct TestResult
+    {
+        std::string test, expected;
+        bool passed = false;
+        std::string failure;
+        double wallMs = 0;
+        size_t steps = 0;
+
+        std::string output;
+        std::exception_ptr error;
+    };
+
+    /**
+     * Evaluates a test case within the configured budget, printing its progress and any output of the test itself
+     * to Functions::output(). A test going over its own budget fails, any other exception is passed on.
+     */
+    void runTestCase(TestCase &testCase, TestResult &result)
+    {
+        result.test = testCase.test->toString();
+        result.expected = testCase.expected->toString();
+        Functions::output() << "Test case: " << result.test << " == " << result.expected << '\n';
+
+        size_t startSteps = Interpreter::stepBudget().steps.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        auto record = [&result, startSteps, start]
+        {
+            std::chrono::duration<double, std::milli> wallTime = std::chrono::steady_clock::now() - start;
+            result.wallMs = wallTime.count();
+            result.steps = Interpreter::stepBudget().steps.load(std::memory_order_relaxed) - startSteps;
+        };
+
+        try
+        {
+            Interpreter::BudgetScope budget(testOptions.stepLimit, testOptions.timeoutMs);
+
+            try
+            {
+                std::unique_ptr<Expressions::Expression> test = Interpreter::interpret(
+                        Expressions::evaluate(std::move(testCase.test)));
+                std::unique_ptr<Expressions::Expression> expected = Interpreter::interpret(
+                        Expressions::evaluate(std::move(testCase.expected)));
+
+                if (testCase.within != 0 && numbersWithin(test, expected, testCase.within)) result.passed = true;
+                else if (test->equals(*expected)) result.passed = true;
+                else
+                {
+                    result.failure = "Expected: " + expected->toString() + ", got: " + test->toString();
+                    Functions::output() << "Test failed- " << result.failure << '\n';
+                }
+            }
+            catch (Interpreter::BudgetExceeded &exceeded)
+            {
+                // Going over an enclosing budget, such as a server request's, stops more than this test
+                if (!budget.exceededHere(exceeded)) throw;
+
+                result.failure = exceeded.what();
+                Functions::output() << "Test failed- " << result.failure << '\n';
+            }
+        }
+        catch (...)
+        {
+            record();
+            throw;
+        }
+
+        record();
+    }
+
+    /**
+     * Runs the test cases across the shared pool. Each test writes to its own buffer, and the buffers are
+     * printed in queue order afterwards so the output matches a sequential run. The tests together stay within
+     * the caller's budget.
+     */
+    void runTestCasesParallel(std::vector<TestCase> &cases, std::vector<TestResult> &results)
+    {
+        Interpreter::SharedBudget share;
+
+        Interpreter::ThreadPool::shared().parallelFor(cases.size(), [&cases, &results, &share](size_t i)
+        {
+            if (Profiler::enabled) Profiler::resetClock();
+
+            std::ostringstream buffer;
+            std::ostream &previous = Functions::output();
+            Functions::setOutput(&buffer);
+
+            try
+            {
+                Interpreter::BudgetScope budget(share);
+                runTestCase(cases[i], results[i]);
+            }
+            catch (...)
+            {
+                results[i].error = std::current_exception();
+            }
+
+            Functions::setOutput(&previous);
+            results[i].output = buffer.str();
+        });
+
+        share.chargeHelpers();
+    }
+
+    void printSlowestTests(const std::vector<TestResult> &results, size_t count)
+    {
+        std::vector<const TestResult *> slowest;
+        for (auto &result : results) slowest.push_back(&result);
+
+        count = std::min(count, slowest.size());
+        std::partial_sort(slowest.begin(), slowest.begin() + count, slowest.end(),
+                          [](const TestResult *r1, const TestResult *r2) { return r1->wallMs > r2->wallMs; });
+
+        Functions::output() << "Slowest " << count << " test(s):\n";
+        for (size_t i = 0; i < count; ++i)
+        {
+            Functions::output() << "  " << std::fixed << std::setprecision(3) << slowest[i]->wallMs
+                                << std::defaultfloat << " ms, " << slowest[i]->steps << " steps: "
+                                << slowest[i]->test << '\n';
+        }
+    }
+
+    std::string jsonString(const std::string &str)
+    {
+        std::ostringstream out;
+        out << '"';
+
+        for (char chr : str)
+        {
+            if (chr == '"' || chr == '\\') out << '\\' << chr;
+            else if (chr == '\n') out << "\\n";
+            else if (chr == '\t') out << "\\t";
+            else if ((unsigned char) chr < 0x20)
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) chr << std::dec;
+            else out << chr;
+        }
+
+        out << '"';
+        return out.str();
+    }
+
+    void writeJsonReport(const std::vector<TestResult> &results, int passedTests, const std::string &path)
+    {
+        std::ofstream out(path);
+        if (!out) throw std::invalid_argument("run-tests: Unable to write test report to " + path);
+
+        out << "{\"passed\": " << passedTests << ", \"total\": " << results.size() << ", \"tests\": [";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const TestResult &result = results[i];
+            if (i > 0) out << ", ";
+
+            out << "{\"test\": " << jsonString(result.test)
+                << ", \"expected\": " << jsonString(result.expected)
+                << ", \"passed\": " << (result.passed ? "true" : "false")
+                << ", \"ms\": " << std::fixed << std::setprecision(3) << result.wallMs << std::defaultfloat
+                << ", \"steps\": " << result.steps;
+
+            if (!result.passed) out << ", \"failure\": " << jsonString(result.failure);
+            out << "}";
+        }
+
+        out << "]}" << std::endl;
+    }
+
     std::unique_ptr<Expressions::Expression> run_tests_fn(const Expressions::expression_vector &expr,
                                                           std::shared_ptr<Expressions::Scope> scope)
     {
         if (!expr.empty()) throw std::invalid_argument("run-tests expects no args");
-        int passedTests = 0, totalTests = 0;
+        int passedTests = 0;
 
-        for (auto &testCase : testCases)
+        /** Take the whole queue first, test cases queued while these run wait for the next run-tests */
+        std::vector<TestCase> cases;
         {
-            ++totalTests;
+            Interpreter::Context &context = Interpreter::Context::of(*scope);
 
-            std::cout << "Test case: " << testCase.test->toString() << " == " << testCase.expected->toString()
-                      << std::endl;
+            std::lock_guard<std::mutex> guard(context.testCasesLock);
+            for (auto &testCase : context.testCases) cases.push_back(std::move(testCase));
+            context.testCases.clear();
+        }
+
+        std::vector<TestResult> results(cases.size());
 
-            std::unique_ptr<Expressions::Expression> test = Interpreter::interpret(
-                    Expressions::evaluate(std::move(testCase.test)));
-            std::unique_ptr<Expressions::Expression> expected = Interpreter::interpret(
-                    Expressions::evaluate(std::move(testCase.expected)));
+        if (testOptions.jobs > 1 && cases.size() > 1)
+        {
+            runTestCasesParallel(cases, results);
 
-            //TODO: Replace naive comparison
-            if (testCase.within != 0 && numbersWithin(test, expected, testCase.within)) ++passedTests;
-            else if (test->toString() == expected->toString()) ++passedTests;
-            else
+            for (auto &result : results)
             {
-                std::cout << "Test failed- Expected: " << expected->toString() << ", got: "
-                          << test->toString() << std::endl;
+                Functions::output() << result.output;
+
+                if (result.error) std::rethrow_exception(result.error);
+                if (result.passed) ++passedTests;
             }
         }
+        else
+        {
+            for (size_t i = 0; i < cases.size(); ++i)
+            {
+                runTestCase(cases[i], results[i]);
+                if (results[i].passed) ++passedTests;
+            }
+        }
+
+        Interpreter::Context::of(*scope).failedTests += results.size() - passedTests;
+        Functions::output() << "Passed " << passedTests << " of " << results.size() << " test(s).\n";
 
-        testCases.clear();
-        std::cout << "Passed " << passedTests << " of " << totalTests << " test(s)." << std::endl;
+        if (testOptions.slowest > 0) printSlowestTests(results, testOptions.slowest);
+        if (!testOptions.jsonReport.empty()) writeJsonReport(results, passedTests, testOptions.jsonReport);
 
         return std::unique_ptr<Expressions::Expression>
                 (new Expressions::VoidValueExpression(
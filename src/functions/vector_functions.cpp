@@ -0,0 +1,357 @@
+#include "functions.h"
+#include "../interpret/interpret.h"
+#include "../expressions/vector_expression.h"
+#include "vector_kernels.h"
+
+namespace VectorFunctions
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using Expressions::expression_vector;
+    using Functions::arg_range_check;
+    using Functions::asFunction;
+
+    Expressions::VectorExpression *asVector(const expr_ptr &expr)
+    {
+        if (auto vector = dynamic_cast<Expressions::VectorExpression *>(expr.get())) return vector;
+
+        throw std::invalid_argument("Expected vector, found " + expr->toString());
+    }
+
+    size_t asNatural(const expr_ptr &expr)
+    {
+        long value;
+        if (Expressions::VectorExpression::asFixnum(*expr, value) && value >= 0) return static_cast<size_t>(value);
+
+        throw std::invalid_argument("Expected natural number, found " + expr->toString());
+    }
+
+    expr_ptr vectorFn(expression_vector args, scope_ptr scope)
+    {
+        return Expressions::VectorExpression::fromElements(std::move(args), std::move(scope));
+    }
+
+    expr_ptr makeVectorFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+        size_t length = asNatural(args[0]);
+
+        // Racket fills with 0 when no value is given
+        long fixnum = 0;
+        if (args.size() == 1 || Expressions::VectorExpression::asFixnum(*args[1], fixnum))
+            return Expressions::VectorExpression::fromFixnums(std::vector<long>(length, fixnum), std::move(scope));
+
+        expression_vector elements;
+        elements.reserve(length);
+        for (size_t i = 0; i < length; ++i) elements.push_back(args[1]->clone());
+
+        return Expressions::VectorExpression::fromElements(std::move(elements), std::move(scope));
+    }
+
+    expr_ptr buildVectorFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+        size_t length = asNatural(args[0]);
+        Expressions::FunctionExpression *func = asFunction(args[1]);
+
+        expression_vector elements;
+        elements.reserve(length);
+        for (size_t i = 0; i < length; ++i)
+        {
+            expression_vector params;
+            params.push_back(std::make_unique<Expressions::NumericalValueExpression>
+                                     (Expressions::NumericalValueExpression::numerical_type(i), scope));
+            elements.push_back(Interpreter::interpret(func->call(std::move(params))));
+        }
+
+        return Expressions::VectorExpression::fromElements(std::move(elements), std::move(scope));
+    }
+
+    expr_ptr vectorPredicate(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::BooleanValueExpression>
+                (Expressions::BooleanValueExpression(args[0]->type() == "VectorExpression", std::move(scope)));
+    }
+
+    expr_ptr vectorRefFn(expression_vector args, scope_ptr /* scope */)
+    {
+        Functions::arg_count_check(args, 2);
+
+        return asVector(args[0])->ref(asNatural(args[1]));
+    }
+
+    expr_ptr vectorSetBangFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 3);
+
+        asVector(args[0])->set(asNatural(args[1]), std::move(args[2]));
+        return std::make_unique<Expressions::VoidValueExpression>(Expressions::VoidValueExpression(std::move(scope)));
+    }
+
+    expr_ptr vectorLengthFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        return std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(asVector(args[0])->size()), std::move(scope));
+    }
+
+    expr_ptr vectorMapFn(expression_vector args, scope_ptr scope)
+    {
+        if (args.size() < 2)
+            throw std::invalid_argument("Expected at least 2 arguments, found " + std::to_string(args.size()));
+
+        Expressions::FunctionExpression *func = asFunction(args[0]);
+
+        std::vector<expression_vector> vectors;
+        for (size_t i = 1; i < args.size(); ++i)
+        {
+            vectors.push_back(asVector(args[i])->elements());
+            if (vectors.back().size() != vectors.front().size())
+                throw std::invalid_argument("vector-map: Expected vectors of the same length");
+        }
+
+        expression_vector elements;
+        elements.reserve(vectors.front().size());
+        for (size_t i = 0; i < vectors.front().size(); ++i)
+        {
+            expression_vector params;
+            for (auto &vector : vectors) params.push_back(std::move(vector[i]));
+
+            elements.push_back(Interpreter::interpret(func->call(std::move(params))));
+        }
+
+        return Expressions::VectorExpression::fromElements(std::move(elements), std::move(scope));
+    }
+
+    expr_ptr vectorToListFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        std::list<expr_ptr> list;
+        for (auto &element : asVector(args[0])->elements()) list.push_back(std::move(element));
+
+        return std::make_unique<Expressions::ListExpression>(std::move(list), std::move(scope));
+    }
+
+    expr_ptr listToVectorFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        auto list = dynamic_cast<Expressions::ListExpression *>(args[0].get());
+        if (!list) throw std::invalid_argument("Expected list, found " + args[0]->toString());
+
+        expression_vector elements;
+        elements.reserve(list->list.size());
+        for (auto &element : list->list) elements.push_back(element->clone());
+
+        return Expressions::VectorExpression::fromElements(std::move(elements), std::move(scope));
+    }
+
+    double asFlonum(const expr_ptr &expr)
+    {
+        double value;
+        if (Expressions::VectorExpression::asFlonum(*expr, value)) return value;
+
+        throw std::invalid_argument("Expected number, found " + expr->toString());
+    }
+
+    expr_ptr flvectorFn(expression_vector args, scope_ptr scope)
+    {
+        std::vector<double> flonums;
+        flonums.reserve(args.size());
+        for (auto &arg : args) flonums.push_back(asFlonum(arg));
+
+        return Expressions::VectorExpression::fromFlonums(std::move(flonums), std::move(scope));
+    }
+
+    expr_ptr makeFlvectorFn(expression_vector args, scope_ptr scope)
+    {
+        arg_range_check(args, 1, 2);
+
+        double fill = args.size() == 2 ? asFlonum(args[1]) : 0.0;
+        return Expressions::VectorExpression::fromFlonums(std::vector<double>(asNatural(args[0]), fill),
+                                                          std::move(scope));
+    }
+
+    /* The elements of a numeric vector as doubles, or a number repeated length times */
+    std::vector<double> flonumsOf(const expr_ptr &expr, size_t length)
+    {
+        double scalar;
+        if (Expressions::VectorExpression::asFlonum(*expr, scalar)) return std::vector<double>(length, scalar);
+
+        std::vector<double> flonums;
+        if (asVector(expr)->numbers(flonums)) return flonums;
+
+        for (auto &element : asVector(expr)->elements()) flonums.push_back(asFlonum(element));
+        return flonums;
+    }
+
+    /* The length every vector argument has, numbers in between are used for each element */
+    size_t operandLength(const expression_vector &args)
+    {
+        size_t length = std::string::npos;
+
+        for (auto &arg : args)
+        {
+            if (auto vector = dynamic_cast<Expressions::VectorExpression *>(arg.get()))
+            {
+                if (length != std::string::npos && vector->size() != length)
+                    throw std::invalid_argument("Expected vectors of the same length, found " + arg->toString());
+
+                length = vector->size();
+            }
+        }
+
+        if (length == std::string::npos) throw std::invalid_argument("Expected at least one vector");
+        return length;
+    }
+
+    template<VectorKernels::BinaryOp op>
+    expr_ptr flvectorBinaryFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        size_t length = operandLength(args);
+        std::vector<double> a = flonumsOf(args[0], length), b = flonumsOf(args[1], length), out(length);
+
+        VectorKernels::kernels().binary(op, a.data(), b.data(), out.data(), length);
+        return Expressions::VectorExpression::fromFlonums(std::move(out), std::move(scope));
+    }
+
+    template<VectorKernels::UnaryOp op>
+    expr_ptr flvectorUnaryFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        size_t length = operandLength(args);
+        std::vector<double> a = flonumsOf(args[0], length), out(length);
+
+        VectorKernels::kernels().unary(op, a.data(), out.data(), length);
+        return Expressions::VectorExpression::fromFlonums(std::move(out), std::move(scope));
+    }
+
+    /* A vector of booleans, one per element */
+    template<VectorKernels::CompareOp op>
+    expr_ptr flvectorCompareFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        size_t length = operandLength(args);
+        std::vector<double> a = flonumsOf(args[0], length), b = flonumsOf(args[1], length);
+        std::vector<unsigned char> mask(length);
+
+        VectorKernels::kernels().compare(op, a.data(), b.data(), mask.data(), length);
+
+        expression_vector elements;
+        elements.reserve(length);
+        for (unsigned char set : mask)
+            elements.push_back(std::make_unique<Expressions::BooleanValueExpression>
+                                       (Expressions::BooleanValueExpression(set != 0, scope)));
+
+        return Expressions::VectorExpression::fromElements(std::move(elements), std::move(scope));
+    }
+
+    expr_ptr flvectorSumFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 1);
+
+        std::vector<double> a = flonumsOf(args[0], operandLength(args));
+        return Expressions::VectorExpression::makeFlonum(VectorKernels::kernels().sum(a.data(), a.size()),
+                                                         std::move(scope));
+    }
+
+    expr_ptr flvectorDotFn(expression_vector args, scope_ptr scope)
+    {
+        Functions::arg_count_check(args, 2);
+
+        size_t length = operandLength(args);
+        std::vector<double> a = flonumsOf(args[0], length), b = flonumsOf(args[1], length);
+
+        return Expressions::VectorExpression::makeFlonum(VectorKernels::kernels().dot(a.data(), b.data(), length),
+                                                         std::move(scope));
+    }
+
+    std::vector<double> nonEmptyFlonums(const expression_vector &args)
+    {
+        Functions::arg_count_check(args, 1);
+
+        std::vector<double> a = flonumsOf(args[0], operandLength(args));
+        if (a.empty()) throw std::invalid_argument("Expected a non-empty vector");
+
+        return a;
+    }
+
+    expr_ptr flvectorMinimumFn(expression_vector args, scope_ptr scope)
+    {
+        std::vector<double> a = nonEmptyFlonums(args);
+        return Expressions::VectorExpression::makeFlonum(VectorKernels::kernels().min(a.data(), a.size()),
+                                                         std::move(scope));
+    }
+
+    expr_ptr flvectorMaximumFn(expression_vector args, scope_ptr scope)
+    {
+        std::vector<double> a = nonEmptyFlonums(args);
+        return Expressions::VectorExpression::makeFlonum(VectorKernels::kernels().max(a.data(), a.size()),
+                                                         std::move(scope));
+    }
+
+    expr_ptr flvectorArgminFn(expression_vector args, scope_ptr scope)
+    {
+        std::vector<double> a = nonEmptyFlonums(args);
+        return std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(VectorKernels::argmin(a.data(), a.size())),
+                 std::move(scope));
+    }
+
+    expr_ptr flvectorArgmaxFn(expression_vector args, scope_ptr scope)
+    {
+        std::vector<double> a = nonEmptyFlonums(args);
+        return std::make_unique<Expressions::NumericalValueExpression>
+                (Expressions::NumericalValueExpression::numerical_type(VectorKernels::argmax(a.data(), a.size())),
+                 std::move(scope));
+    }
+}
+
+void register_vector_functions()
+{
+    Functions::funcMap["vector"] = VectorFunctions::vectorFn;
+    Functions::funcMap["make-vector"] = VectorFunctions::makeVectorFn;
+    Functions::funcMap["build-vector"] = VectorFunctions::buildVectorFn;
+    Functions::funcMap["vector?"] = VectorFunctions::vectorPredicate;
+    Functions::funcMap["vector-ref"] = VectorFunctions::vectorRefFn;
+    Functions::funcMap["vector-set!"] = VectorFunctions::vectorSetBangFn;
+    Functions::funcMap["vector-length"] = VectorFunctions::vectorLengthFn;
+    Functions::funcMap["vector-map"] = VectorFunctions::vectorMapFn;
+    Functions::funcMap["vector->list"] = VectorFunctions::vectorToListFn;
+    Functions::funcMap["list->vector"] = VectorFunctions::listToVectorFn;
+    Functions::funcMap["flvector"] = VectorFunctions::flvectorFn;
+    Functions::funcMap["make-flvector"] = VectorFunctions::makeFlvectorFn;
+
+    using VectorKernels::BinaryOp;
+    using VectorKernels::UnaryOp;
+    using VectorKernels::CompareOp;
+
+    Functions::funcMap["flvector+"] = VectorFunctions::flvectorBinaryFn<BinaryOp::add>;
+    Functions::funcMap["flvector-"] = VectorFunctions::flvectorBinaryFn<BinaryOp::subtract>;
+    Functions::funcMap["flvector*"] = VectorFunctions::flvectorBinaryFn<BinaryOp::multiply>;
+    Functions::funcMap["flvector/"] = VectorFunctions::flvectorBinaryFn<BinaryOp::divide>;
+    Functions::funcMap["flvector-sqr"] = VectorFunctions::flvectorUnaryFn<UnaryOp::sqr>;
+    Functions::funcMap["flvector-sqrt"] = VectorFunctions::flvectorUnaryFn<UnaryOp::sqrt>;
+    Functions::funcMap["flvector-abs"] = VectorFunctions::flvectorUnaryFn<UnaryOp::abs>;
+    Functions::funcMap["flvector<"] = VectorFunctions::flvectorCompareFn<CompareOp::less>;
+    Functions::funcMap["flvector<="] = VectorFunctions::flvectorCompareFn<CompareOp::lessEqual>;
+    Functions::funcMap["flvector>"] = VectorFunctions::flvectorCompareFn<CompareOp::greater>;
+    Functions::funcMap["flvector>="] = VectorFunctions::flvectorCompareFn<CompareOp::greaterEqual>;
+    Functions::funcMap["flvector="] = VectorFunctions::flvectorCompareFn<CompareOp::equal>;
+    Functions::funcMap["flvector-sum"] = VectorFunctions::flvectorSumFn;
+    Functions::funcMap["flvector-dot"] = VectorFunctions::flvectorDotFn;
+    Functions::funcMap["flvector-minimum"] = VectorFunctions::flvectorMinimumFn;
+    Functions::funcMap["flvector-maximum"] = VectorFunctions::flvectorMaximumFn;
+    Functions::funcMap["flvector-argmin"] = VectorFunctions::flvectorArgminFn;
+    Functions::funcMap["flvector-argmax"] = VectorFunctions::flvectorArgmaxFn;
+
+    Functions::impureFunctions.insert("vector-set!");
+}
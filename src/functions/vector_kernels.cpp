@@ -0,0 +1,155 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "vector_kernels_impl.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace VectorKernels
+{
+#ifdef RACQUET_AVX2_KERNELS
+    /* Defined in vector_kernels_avx2.cpp, which is the only file compiled with AVX2 enabled */
+    KernelTable avx2Kernels();
+#endif
+
+    namespace
+    {
+        struct ScalarLanes
+        {
+            typedef double reg;
+            static const size_t width = 1;
+
+            static reg load(const double *p) { return *p; }
+
+            static void store(double *p, reg x) { *p = x; }
+
+            static reg broadcast(double x) { return x; }
+
+            static reg add(reg x, reg y) { return x + y; }
+
+            static reg subtract(reg x, reg y) { return x - y; }
+
+            static reg multiply(reg x, reg y) { return x * y; }
+
+            static reg divide(reg x, reg y) { return x / y; }
+
+            static reg sqrt(reg x) { return std::sqrt(x); }
+
+            static reg abs(reg x) { return std::fabs(x); }
+
+            static reg min(reg x, reg y) { return std::isnan(x) || x < y ? x : y; }
+
+            static reg max(reg x, reg y) { return std::isnan(x) || x > y ? x : y; }
+
+            static bool less(reg x, reg y) { return x < y; }
+
+            static bool lessEqual(reg x, reg y) { return x <= y; }
+
+            static bool equal(reg x, reg y) { return x == y; }
+
+            static int mask(bool x) { return x ? 1 : 0; }
+        };
+
+#ifdef __SSE2__
+        struct Sse2Lanes
+        {
+            typedef __m128d reg;
+            static const size_t width = 2;
+
+            static reg load(const double *p) { return _mm_loadu_pd(p); }
+
+            static void store(double *p, reg x) { _mm_storeu_pd(p, x); }
+
+            static reg broadcast(double x) { return _mm_set1_pd(x); }
+
+            static reg add(reg x, reg y) { return _mm_add_pd(x, y); }
+
+            static reg subtract(reg x, reg y) { return _mm_sub_pd(x, y); }
+
+            static reg multiply(reg x, reg y) { return _mm_mul_pd(x, y); }
+
+            static reg divide(reg x, reg y) { return _mm_div_pd(x, y); }
+
+            static reg sqrt(reg x) { return _mm_sqrt_pd(x); }
+
+            static reg abs(reg x) { return _mm_andnot_pd(_mm_set1_pd(-0.0), x); }
+
+            // minpd and maxpd return y when either is NaN, taking x where it is NaN makes any NaN win
+            static reg min(reg x, reg y) { return keepNaN(x, _mm_min_pd(x, y)); }
+
+            static reg max(reg x, reg y) { return keepNaN(x, _mm_max_pd(x, y)); }
+
+            static reg keepNaN(reg x, reg result)
+            {
+                reg nan = _mm_cmpunord_pd(x, x);
+                return _mm_or_pd(_mm_and_pd(nan, x), _mm_andnot_pd(nan, result));
+            }
+
+            static reg less(reg x, reg y) { return _mm_cmplt_pd(x, y); }
+
+            static reg lessEqual(reg x, reg y) { return _mm_cmple_pd(x, y); }
+
+            static reg equal(reg x, reg y) { return _mm_cmpeq_pd(x, y); }
+
+            static int mask(reg x) { return _mm_movemask_pd(x); }
+        };
+#endif
+
+        /* RACQUET_KERNELS=scalar, sse2 or avx2 caps the instruction set, for comparing the implementations */
+        bool allowed(const char *name)
+        {
+            const char *order[] = {"scalar", "sse2", "avx2"};
+            const char *cap = std::getenv("RACQUET_KERNELS");
+            if (!cap) return true;
+
+            int capIndex = -1, nameIndex = 0;
+            for (int i = 0; i < 3; ++i)
+            {
+                if (std::strcmp(cap, order[i]) == 0) capIndex = i;
+                if (std::strcmp(name, order[i]) == 0) nameIndex = i;
+            }
+
+            return capIndex < 0 || nameIndex <= capIndex;
+        }
+
+        KernelTable select()
+        {
+#if defined(RACQUET_AVX2_KERNELS)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && allowed("avx2")) return avx2Kernels();
+#endif
+#ifdef __SSE2__
+            if (allowed("sse2")) return Kernels<Sse2Lanes>::table("sse2");
+#endif
+            return Kernels<ScalarLanes>::table("scalar");
+        }
+
+        /* The first element equal to target, or the first NaN if the reduction produced one */
+        size_t indexOf(const double *a, size_t n, double target)
+        {
+            for (size_t i = 0; i < n; ++i)
+                if (a[i] == target || (std::isnan(target) && std::isnan(a[i]))) return i;
+
+            return 0;
+        }
+    }
+
+    const KernelTable &kernels()
+    {
+        static const KernelTable table = select();
+        return table;
+    }
+
+    size_t argmin(const double *a, size_t n)
+    {
+        return indexOf(a, n, kernels().min(a, n));
+    }
+
+    size_t argmax(const double *a, size_t n)
+    {
+        return indexOf(a, n, kernels().max(a, n));
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef RACKET_INTERPRETER_VECTOR_KERNELS_H
+#define RACKET_INTERPRETER_VECTOR_KERNELS_H
+
+#include <cstddef>
+
+/**
+ * Element-wise operations and reductions over arrays of doubles. Each operation is implemented once on top of
+ * a small set of lane operations, which are instantiated for AVX2, SSE2 and plain scalar code. The widest set
+ * the CPU supports is picked the first time a kernel is used.
+ */
+namespace VectorKernels
+{
+    enum class BinaryOp
+    {
+        add, subtract, multiply, divide
+    };
+
+    enum class UnaryOp
+    {
+        sqr, sqrt, abs
+    };
+
+    enum class CompareOp
+    {
+        less, lessEqual, greater, greaterEqual, equal
+    };
+
+    struct KernelTable
+    {
+        const char *name;
+
+        void (*binary)(BinaryOp op, const double *a, const double *b, double *out, size_t n);
+
+        void (*unary)(UnaryOp op, const double *a, double *out, size_t n);
+
+        /* Writes 1 where the comparison holds and 0 where it doesn't */
+        void (*compare)(CompareOp op, const double *a, const double *b, unsigned char *out, size_t n);
+
+        /* The lanes are summed separately, so results may differ from a left to right sum in the last bits */
+        double (*sum)(const double *a, size_t n);
+
+        double (*dot)(const double *a, const double *b, size_t n);
+
+        /* n has to be at least 1. NaN if any element is NaN, whichever instruction set runs. */
+        double (*min)(const double *a, size_t n);
+
+        double (*max)(const double *a, size_t n);
+    };
+
+    const KernelTable &kernels();
+
+    /* Index of the first smallest or largest element, or of the first NaN. n has to be at least 1. */
+    size_t argmin(const double *a, size_t n);
+
+    size_t argmax(const double *a, size_t n);
+}
+
+#endif //RACKET_INTERPRETER_VECTOR_KERNELS_H
@@ -0,0 +1,58 @@
+// Compiled with -mavx2, so nothing here may run before the CPU has been checked for AVX2 support
+
+#include <immintrin.h>
+
+#include "vector_kernels_impl.h"
+
+namespace VectorKernels
+{
+    namespace
+    {
+        struct Avx2Lanes
+        {
+            typedef __m256d reg;
+            static const size_t width = 4;
+
+            static reg load(const double *p) { return _mm256_loadu_pd(p); }
+
+            static void store(double *p, reg x) { _mm256_storeu_pd(p, x); }
+
+            static reg broadcast(double x) { return _mm256_set1_pd(x); }
+
+            static reg add(reg x, reg y) { return _mm256_add_pd(x, y); }
+
+            static reg subtract(reg x, reg y) { return _mm256_sub_pd(x, y); }
+
+            static reg multiply(reg x, reg y) { return _mm256_mul_pd(x, y); }
+
+            static reg divide(reg x, reg y) { return _mm256_div_pd(x, y); }
+
+            static reg sqrt(reg x) { return _mm256_sqrt_pd(x); }
+
+            static reg abs(reg x) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+
+            // Like the SSE2 lanes, a NaN in x is kept where vminpd and vmaxpd would return y
+            static reg min(reg x, reg y) { return keepNaN(x, _mm256_min_pd(x, y)); }
+
+            static reg max(reg x, reg y) { return keepNaN(x, _mm256_max_pd(x, y)); }
+
+            static reg keepNaN(reg x, reg result)
+            {
+                return _mm256_blendv_pd(result, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+            }
+
+            static reg less(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_LT_OQ); }
+
+            static reg lessEqual(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_LE_OQ); }
+
+            static reg equal(reg x, reg y) { return _mm256_cmp_pd(x, y, _CMP_EQ_OQ); }
+
+            static int mask(reg x) { return _mm256_movemask_pd(x); }
+        };
+    }
+
+    KernelTable avx2Kernels()
+    {
+        return Kernels<Avx2Lanes>::table("avx2");
+    }
+}
@@ -0,0 +1,191 @@
+#ifndef RACKET_INTERPRETER_VECTOR_KERNELS_IMPL_H
+#define RACKET_INTERPRETER_VECTOR_KERNELS_IMPL_H
+
+#include <cmath>
+
+#include "vector_kernels.h"
+
+/**
+ * The kernels, written against a Lanes type providing reg, width, load, store, broadcast, add, subtract,
+ * multiply, divide, sqrt, abs, min, max, less, lessEqual, equal and mask. Only included by the translation
+ * units that instantiate them, each one compiled for the instruction set of its Lanes.
+ */
+namespace VectorKernels
+{
+    template<typename Lanes>
+    struct Kernels
+    {
+        typedef typename Lanes::reg reg;
+
+        template<typename Vec, typename Scalar>
+        static void map2(const double *a, const double *b, double *out, size_t n, Vec vec, Scalar scalar)
+        {
+            size_t i = 0;
+            for (; i + Lanes::width <= n; i += Lanes::width)
+                Lanes::store(out + i, vec(Lanes::load(a + i), Lanes::load(b + i)));
+            for (; i < n; ++i) out[i] = scalar(a[i], b[i]);
+        }
+
+        template<typename Vec, typename Scalar>
+        static void map1(const double *a, double *out, size_t n, Vec vec, Scalar scalar)
+        {
+            size_t i = 0;
+            for (; i + Lanes::width <= n; i += Lanes::width) Lanes::store(out + i, vec(Lanes::load(a + i)));
+            for (; i < n; ++i) out[i] = scalar(a[i]);
+        }
+
+        template<typename Vec, typename Scalar>
+        static void mask(const double *a, const double *b, unsigned char *out, size_t n, Vec vec, Scalar scalar)
+        {
+            size_t i = 0;
+            for (; i + Lanes::width <= n; i += Lanes::width)
+            {
+                int bits = Lanes::mask(vec(Lanes::load(a + i), Lanes::load(b + i)));
+                for (size_t lane = 0; lane < Lanes::width; ++lane) out[i + lane] = (bits >> lane) & 1;
+            }
+            for (; i < n; ++i) out[i] = scalar(a[i], b[i]) ? 1 : 0;
+        }
+
+        static void binary(BinaryOp op, const double *a, const double *b, double *out, size_t n)
+        {
+            switch (op)
+            {
+                case BinaryOp::add:
+                    map2(a, b, out, n, [](reg x, reg y) { return Lanes::add(x, y); },
+                         [](double x, double y) { return x + y; });
+                    break;
+                case BinaryOp::subtract:
+                    map2(a, b, out, n, [](reg x, reg y) { return Lanes::subtract(x, y); },
+                         [](double x, double y) { return x - y; });
+                    break;
+                case BinaryOp::multiply:
+                    map2(a, b, out, n, [](reg x, reg y) { return Lanes::multiply(x, y); },
+                         [](double x, double y) { return x * y; });
+                    break;
+                case BinaryOp::divide:
+                    map2(a, b, out, n, [](reg x, reg y) { return Lanes::divide(x, y); },
+                         [](double x, double y) { return x / y; });
+                    break;
+            }
+        }
+
+        static void unary(UnaryOp op, const double *a, double *out, size_t n)
+        {
+            switch (op)
+            {
+                case UnaryOp::sqr:
+                    map1(a, out, n, [](reg x) { return Lanes::multiply(x, x); }, [](double x) { return x * x; });
+                    break;
+                case UnaryOp::sqrt:
+                    map1(a, out, n, [](reg x) { return Lanes::sqrt(x); },
+                         [](double x) { return __builtin_sqrt(x); });
+                    break;
+                case UnaryOp::abs:
+                    map1(a, out, n, [](reg x) { return Lanes::abs(x); }, [](double x) { return __builtin_fabs(x); });
+                    break;
+            }
+        }
+
+        static void compare(CompareOp op, const double *a, const double *b, unsigned char *out, size_t n)
+        {
+            switch (op)
+            {
+                case CompareOp::less:
+                    mask(a, b, out, n, [](reg x, reg y) { return Lanes::less(x, y); },
+                         [](double x, double y) { return x < y; });
+                    break;
+                case CompareOp::lessEqual:
+                    mask(a, b, out, n, [](reg x, reg y) { return Lanes::lessEqual(x, y); },
+                         [](double x, double y) { return x <= y; });
+                    break;
+                case CompareOp::greater:
+                    mask(a, b, out, n, [](reg x, reg y) { return Lanes::less(y, x); },
+                         [](double x, double y) { return x > y; });
+                    break;
+                case CompareOp::greaterEqual:
+                    mask(a, b, out, n, [](reg x, reg y) { return Lanes::lessEqual(y, x); },
+                         [](double x, double y) { return x >= y; });
+                    break;
+                case CompareOp::equal:
+                    mask(a, b, out, n, [](reg x, reg y) { return Lanes::equal(x, y); },
+                         [](double x, double y) { return x == y; });
+                    break;
+            }
+        }
+
+        /* Folds the full registers with vec, then the lanes and the remaining elements with scalar */
+        template<typename Vec, typename Scalar>
+        static double reduce(const double *a, size_t n, reg acc, size_t start, Vec vec, Scalar scalar)
+        {
+            size_t i = start;
+            for (; i + Lanes::width <= n; i += Lanes::width) acc = vec(acc, Lanes::load(a + i));
+
+            double lanes[Lanes::width];
+            Lanes::store(lanes, acc);
+
+            double result = lanes[0];
+            for (size_t lane = 1; lane < Lanes::width; ++lane) result = scalar(result, lanes[lane]);
+            for (; i < n; ++i) result = scalar(result, a[i]);
+
+            return result;
+        }
+
+        static double sum(const double *a, size_t n)
+        {
+            return reduce(a, n, Lanes::broadcast(0.0), 0, [](reg x, reg y) { return Lanes::add(x, y); },
+                          [](double x, double y) { return x + y; });
+        }
+
+        static double dot(const double *a, const double *b, size_t n)
+        {
+            reg acc = Lanes::broadcast(0.0);
+
+            size_t i = 0;
+            for (; i + Lanes::width <= n; i += Lanes::width)
+                acc = Lanes::add(acc, Lanes::multiply(Lanes::load(a + i), Lanes::load(b + i)));
+
+            double lanes[Lanes::width];
+            Lanes::store(lanes, acc);
+
+            double result = 0.0;
+            for (size_t lane = 0; lane < Lanes::width; ++lane) result += lanes[lane];
+            for (; i < n; ++i) result += a[i] * b[i];
+
+            return result;
+        }
+
+        static double min(const double *a, size_t n)
+        {
+            auto vec = [](reg x, reg y) { return Lanes::min(x, y); };
+
+            if (n < Lanes::width) return reduce(a, n, Lanes::broadcast(a[0]), 0, vec, scalarMin);
+            return reduce(a, n, Lanes::load(a), Lanes::width, vec, scalarMin);
+        }
+
+        static double max(const double *a, size_t n)
+        {
+            auto vec = [](reg x, reg y) { return Lanes::max(x, y); };
+
+            if (n < Lanes::width) return reduce(a, n, Lanes::broadcast(a[0]), 0, vec, scalarMax);
+            return reduce(a, n, Lanes::load(a), Lanes::width, vec, scalarMax);
+        }
+
+        /* The same as the lanes of every instruction set, so all of them agree on NaN */
+        static double scalarMin(double x, double y)
+        {
+            return std::isnan(x) || x < y ? x : y;
+        }
+
+        static double scalarMax(double x, double y)
+        {
+            return std::isnan(x) || x > y ? x : y;
+        }
+
+        static KernelTable table(const char *name)
+        {
+            return KernelTable{name, binary, unary, compare, sum, dot, min, max};
+        }
+    };
+}
+
+#endif //RACKET_INTERPRETER_VECTOR_KERNELS_IMPL_H
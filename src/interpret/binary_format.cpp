@@ -0,0 +1,489 @@
+#include <cstring>
+
+#include "binary_format.h"
+#include "context.h"
+#include "../expressions/hash_expression.h"
+#include "../expressions/vector_expression.h"
+
+namespace BinaryFormat
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    using boost::multiprecision::mpz_int;
+
+    namespace
+    {
+        const char magic[] = {'R', 'Q', 'B'};
+
+        /* Read in pieces of this size, so a corrupt length can't make a single huge allocation */
+        const size_t readBlockSize = 1u << 16u;
+
+        enum class Tag : unsigned char
+        {
+            voidValue, trueValue, falseValue, fixnum, bignum, rational, flonum, bigFloat, string, symbol, character,
+            list, structure, vector, fxvector, flvector, mutableHash, hash, reference
+        };
+    }
+
+/* Encoder */
+
+    void Encoder::write(Expressions::Expression &value)
+    {
+        out.append(magic, sizeof(magic));
+        out.push_back(static_cast<char>(version));
+
+        sharedIndex.clear();
+        writeValue(value);
+    }
+
+    void Encoder::writeValue(Expressions::Expression &value)
+    {
+        if (auto exact = dynamic_cast<Expressions::NumericalValueExpression *>(&value))
+        {
+            if (denominator(exact->value) == 1)
+            {
+                writeInteger(numerator(exact->value));
+                return;
+            }
+
+            out.push_back(static_cast<char>(Tag::rational));
+            writeInteger(numerator(exact->value));
+            writeInteger(denominator(exact->value));
+        }
+        else if (auto inexact = dynamic_cast<Expressions::InexactNumberExpression *>(&value))
+        {
+            // Most inexact numbers hold a double, the others keep every digit
+            auto flonum = inexact->value.convert_to<double>();
+            if (Expressions::InexactNumberExpression::numerical_type(flonum) == inexact->value)
+            {
+                out.push_back(static_cast<char>(Tag::flonum));
+                writeDouble(flonum);
+            }
+            else
+            {
+                // A binary float is a fraction with a power of two below, that keeps every bit
+                boost::multiprecision::mpq_rational exact;
+                mpq_set_f(exact.backend().data(), inexact->value.backend().data());
+
+                out.push_back(static_cast<char>(Tag::bigFloat));
+                writeInteger(numerator(exact));
+                writeInteger(denominator(exact));
+            }
+        }
+        else if (auto str = dynamic_cast<Expressions::StringExpression *>(&value))
+        {
+            out.push_back(static_cast<char>(Tag::string));
+            writeString(str->str);
+        }
+        else if (auto symbol = dynamic_cast<Expressions::SymbolExpression *>(&value))
+        {
+            out.push_back(static_cast<char>(Tag::symbol));
+            writeString(symbol->symbol);
+        }
+        else if (auto chr = dynamic_cast<Expressions::CharacterExpression *>(&value))
+        {
+            out.push_back(static_cast<char>(Tag::character));
+            out.push_back(chr->character);
+        }
+        else if (auto boolean = dynamic_cast<Expressions::BooleanValueExpression *>(&value))
+        {
+            out.push_back(static_cast<char>(boolean->value ? Tag::trueValue : Tag::falseValue));
+        }
+        else if (dynamic_cast<Expressions::VoidValueExpression *>(&value))
+        {
+            out.push_back(static_cast<char>(Tag::voidValue));
+        }
+        else if (auto list = dynamic_cast<Expressions::ListExpression *>(&value))
+        {
+            out.push_back(static_cast<char>(Tag::list));
+            writeUnsigned(list->list.size());
+            for (auto &element : list->list) writeValue(*element);
+        }
+        else if (auto structure = dynamic_cast<Expressions::StructExpression *>(&value))
+        {
+            out.push_back(static_cast<char>(Tag::structure));
+            writeString(structure->structName);
+            writeUnsigned(structure->structFields.size());
+            for (auto &field : structure->structFields) writeValue(*field);
+        }
+        else if (auto vector = dynamic_cast<Expressions::VectorExpression *>(&value))
+        {
+            if (writeShared(vector->sharedStorage())) return;
+
+            std::vector<long> fixnums;
+            std::vector<double> flonums;
+
+            if (vector->kind() == Expressions::VectorStorage::Kind::fixnum && vector->fixnums(fixnums))
+            {
+                out.push_back(static_cast<char>(Tag::fxvector));
+                writeUnsigned(fixnums.size());
+                for (long fixnum : fixnums) writeSigned(fixnum);
+            }
+            else if (vector->kind() == Expressions::VectorStorage::Kind::flonum && vector->numbers(flonums))
+            {
+                out.push_back(static_cast<char>(Tag::flvector));
+                writeUnsigned(flonums.size());
+
+                out.reserve(out.size() + flonums.size() * sizeof(double));
+                for (double flonum : flonums) writeDouble(flonum);
+            }
+            else
+            {
+                Expressions::expression_vector elements = vector->elements();
+
+                out.push_back(static_cast<char>(Tag::vector));
+                writeUnsigned(elements.size());
+                for (auto &element : elements) writeValue(*element);
+            }
+        }
+        else if (auto table = dynamic_cast<Expressions::HashExpression *>(&value))
+        {
+            if (table->isMutableTable())
+            {
+                if (writeShared(table->sharedTable())) return;
+                out.push_back(static_cast<char>(Tag::mutableHash));
+            }
+            else out.push_back(static_cast<char>(Tag::hash));
+
+            writeUnsigned(table->size());
+            table->forEach([this](Expressions::Expression &key, Expressions::Expression &entry)
+                           {
+                               writeValue(key);
+                               writeValue(entry);
+                           });
+        }
+        else throw std::invalid_argument("write-binary: Cannot write " + value.toString());
+    }
+
+    void Encoder::writeInteger(const mpz_int &value)
+    {
+        if (mpz_fits_slong_p(value.backend().data()))
+        {
+            out.push_back(static_cast<char>(Tag::fixnum));
+            writeSigned(mpz_get_si(value.backend().data()));
+            return;
+        }
+
+        out.push_back(static_cast<char>(Tag::bignum));
+        out.push_back(static_cast<char>(value < 0 ? 1 : 0));
+
+        size_t length = (mpz_sizeinbase(value.backend().data(), 2) + 7) / 8;
+        writeUnsigned(length);
+
+        size_t start = out.size();
+        out.resize(start + length);
+        mpz_export(&out[start], nullptr, -1, 1, 0, 0, value.backend().data());
+    }
+
+    void Encoder::writeUnsigned(unsigned long long value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7Fu) | 0x80u));
+            value >>= 7u;
+        }
+
+        out.push_back(static_cast<char>(value));
+    }
+
+    void Encoder::writeSigned(long long value)
+    {
+        // Zigzag, so small negative numbers are short as well
+        auto bits = static_cast<unsigned long long>(value);
+        writeUnsigned((bits << 1u) ^ (value < 0 ? ~0ull : 0ull));
+    }
+
+    void Encoder::writeString(const std::string &str)
+    {
+        writeUnsigned(str.size());
+        out += str;
+    }
+
+    void Encoder::writeDouble(double value)
+    {
+        unsigned long long bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (unsigned i = 0; i < 8; ++i) out.push_back(static_cast<char>((bits >> (8u * i)) & 0xFFu));
+    }
+
+    bool Encoder::writeShared(const void *shared)
+    {
+        auto found = sharedIndex.find(shared);
+        if (found == sharedIndex.end())
+        {
+            size_t index = sharedIndex.size();
+            sharedIndex[shared] = index;
+            return false;
+        }
+
+        out.push_back(static_cast<char>(Tag::reference));
+        writeUnsigned(found->second);
+        return true;
+    }
+
+/* Decoder */
+
+    expr_ptr Decoder::read()
+    {
+        typedef std::streambuf::traits_type traits;
+        if (traits::eq_int_type(source.sgetc(), traits::eof())) return nullptr;
+
+        for (char expected : magic)
+        {
+            if (byte() != static_cast<unsigned char>(expected))
+                throw std::invalid_argument("read-binary: Input isn't a written value");
+        }
+
+        unsigned char written = byte();
+        if (written != version)
+            throw std::invalid_argument("read-binary: Unsupported format version " + std::to_string(written));
+
+        shared.clear();
+        return readValue();
+    }
+
+    expr_ptr Decoder::readValue()
+    {
+        auto tag = static_cast<Tag>(byte());
+
+        switch (tag)
+        {
+            case Tag::voidValue:
+                return std::make_unique<Expressions::VoidValueExpression>(scope);
+
+            case Tag::trueValue:
+            case Tag::falseValue:
+                return std::make_unique<Expressions::BooleanValueExpression>(tag == Tag::trueValue, scope);
+
+            case Tag::fixnum:
+            case Tag::bignum:
+            {
+                source.sungetc();
+                return std::make_unique<Expressions::NumericalValueExpression>
+                        (Expressions::NumericalValueExpression::numerical_type(readInteger()), scope);
+            }
+
+            case Tag::rational:
+            {
+                mpz_int numerator = readInteger();
+                mpz_int denominator = readInteger();
+                if (denominator == 0) throw std::invalid_argument("read-binary: Zero denominator");
+
+                return std::make_unique<Expressions::NumericalValueExpression>(numerator, denominator, scope);
+            }
+
+            case Tag::flonum:
+                return Expressions::VectorExpression::makeFlonum(readDouble(), scope);
+
+            case Tag::bigFloat:
+            {
+                mpz_int numerator = readInteger();
+                mpz_int denominator = readInteger();
+                if (denominator == 0) throw std::invalid_argument("read-binary: Zero denominator");
+
+                boost::multiprecision::mpq_rational exact(numerator, denominator);
+                return std::make_unique<Expressions::InexactNumberExpression>
+                        (Expressions::InexactNumberExpression::numerical_type(exact), scope);
+            }
+
+            case Tag::string:
+                return std::make_unique<Expressions::StringExpression>(readString(), scope);
+
+            case Tag::symbol:
+                return std::make_unique<Expressions::SymbolExpression>(readString(), scope);
+
+            case Tag::character:
+                return std::make_unique<Expressions::CharacterExpression>(static_cast<char>(byte()), scope);
+
+            case Tag::list:
+            {
+                std::list<expr_ptr> elements;
+                for (unsigned long long count = readUnsigned(); count > 0; --count) elements.push_back(readValue());
+
+                return std::make_unique<Expressions::ListExpression>(std::move(elements), scope);
+            }
+
+            case Tag::structure:
+            {
+                std::string name = readString();
+                unsigned long long count = readUnsigned();
+
+                // The program reading a checkpoint has to define the same structs as the one that wrote it
+                if (Interpreter::Context *context = Interpreter::Context::find(scope.get()))
+                {
+                    auto definition = context->structs.find(name);
+                    if (definition == context->structs.end())
+                        throw std::invalid_argument("read-binary: No struct named " + name + " is defined");
+                    if (definition->second.size() != count)
+                        throw std::invalid_argument("read-binary: Struct " + name + " has "
+                                                    + std::to_string(definition->second.size())
+                                                    + " fields, the written one has " + std::to_string(count));
+                }
+
+                std::vector<expr_ptr> fields;
+                for (; count > 0; --count) fields.push_back(readValue());
+
+                return std::make_unique<Expressions::StructExpression>(name, std::move(fields), scope);
+            }
+
+            case Tag::vector:
+            {
+                unsigned long long count = readUnsigned();
+
+                // Made before its elements are read, so they can refer back to it
+                Expressions::expression_vector placeholders;
+                for (unsigned long long i = 0; i < count; ++i)
+                    placeholders.push_back(std::make_unique<Expressions::VoidValueExpression>(scope));
+
+                auto vector = Expressions::VectorExpression::fromElements(std::move(placeholders), scope);
+                shared.push_back(vector->clone());
+
+                for (size_t i = 0; i < count; ++i) vector->set(i, readValue());
+                return vector;
+            }
+
+            case Tag::fxvector:
+            {
+                std::vector<long> fixnums;
+                for (unsigned long long count = readUnsigned(); count > 0; --count)
+                    fixnums.push_back(static_cast<long>(readSigned()));
+
+                auto vector = Expressions::VectorExpression::fromFixnums(std::move(fixnums), scope);
+                shared.push_back(vector->clone());
+                return vector;
+            }
+
+            case Tag::flvector:
+            {
+                std::vector<double> flonums;
+                for (unsigned long long count = readUnsigned(); count > 0; --count) flonums.push_back(readDouble());
+
+                auto vector = Expressions::VectorExpression::fromFlonums(std::move(flonums), scope);
+                shared.push_back(vector->clone());
+                return vector;
+            }
+
+            case Tag::mutableHash:
+            {
+                auto table = std::make_unique<Expressions::HashExpression>(true, scope);
+                shared.push_back(table->clone());
+
+                for (unsigned long long count = readUnsigned(); count > 0; --count)
+                {
+                    expr_ptr key = readValue();
+                    table->set(std::move(key), readValue());
+                }
+
+                return table;
+            }
+
+            case Tag::hash:
+            {
+                auto table = std::make_unique<Expressions::HashExpression>(false, scope);
+
+                for (unsigned long long count = readUnsigned(); count > 0; --count)
+                {
+                    expr_ptr key = readValue();
+                    table = table->with(std::move(key), readValue(), scope);
+                }
+
+                return table;
+            }
+
+            case Tag::reference:
+            {
+                unsigned long long index = readUnsigned();
+                if (index >= shared.size()) throw std::invalid_argument("read-binary: Invalid back reference");
+
+                return shared[index]->clone();
+            }
+        }
+
+        throw std::invalid_argument("read-binary: Unknown tag " + std::to_string(static_cast<int>(tag)));
+    }
+
+    mpz_int Decoder::readInteger()
+    {
+        auto tag = static_cast<Tag>(byte());
+        if (tag == Tag::fixnum) return mpz_int(readSigned());
+        if (tag != Tag::bignum) throw std::invalid_argument("read-binary: Expected an integer");
+
+        bool negative = byte() != 0;
+        unsigned long long length = readUnsigned();
+
+        std::string magnitude;
+        while (magnitude.size() < length)
+        {
+            size_t start = magnitude.size();
+            size_t piece = std::min<unsigned long long>(length - start, readBlockSize);
+
+            magnitude.resize(start + piece);
+            if (source.sgetn(&magnitude[start], piece) != static_cast<std::streamsize>(piece))
+                throw std::invalid_argument("read-binary: Unexpected end of input");
+        }
+
+        mpz_int value;
+        mpz_import(value.backend().data(), magnitude.size(), -1, 1, 0, 0, magnitude.data());
+
+        return negative ? mpz_int(-value) : value;
+    }
+
+    unsigned long long Decoder::readUnsigned()
+    {
+        unsigned long long value = 0;
+
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            unsigned char next = byte();
+            value |= static_cast<unsigned long long>(next & 0x7Fu) << shift;
+
+            if ((next & 0x80u) == 0) return value;
+        }
+
+        throw std::invalid_argument("read-binary: Invalid length");
+    }
+
+    long long Decoder::readSigned()
+    {
+        unsigned long long bits = readUnsigned();
+        return static_cast<long long>((bits >> 1u) ^ (~(bits & 1u) + 1));
+    }
+
+    std::string Decoder::readString()
+    {
+        unsigned long long length = readUnsigned();
+        std::string str;
+
+        while (str.size() < length)
+        {
+            size_t start = str.size();
+            size_t piece = std::min<unsigned long long>(length - start, readBlockSize);
+
+            str.resize(start + piece);
+            if (source.sgetn(&str[start], piece) != static_cast<std::streamsize>(piece))
+                throw std::invalid_argument("read-binary: Unexpected end of input");
+        }
+
+        return str;
+    }
+
+    double Decoder::readDouble()
+    {
+        unsigned long long bits = 0;
+        for (unsigned i = 0; i < 8; ++i) bits |= static_cast<unsigned long long>(byte()) << (8u * i);
+
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    unsigned char Decoder::byte()
+    {
+        typedef std::streambuf::traits_type traits;
+
+        int chr = source.sbumpc();
+        if (traits::eq_int_type(chr, traits::eof()))
+            throw std::invalid_argument("read-binary: Unexpected end of input");
+
+        return static_cast<unsigned char>(chr);
+    }
+}
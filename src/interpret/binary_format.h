@@ -0,0 +1,85 @@
+#ifndef RACKET_INTERPRETER_BINARY_FORMAT_H
+#define RACKET_INTERPRETER_BINARY_FORMAT_H
+
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../expressions/expressions.h"
+
+/**
+ * A compact encoding of plain values, for checkpoints that have to be written and read back quickly. Every value
+ * starts with a magic number and the format version, followed by a tag byte per part of it. Integers are
+ * variable length, flvector and fxvector contents are stored unboxed. Mutable vectors and hash tables are
+ * written once and referred back to after that, so values sharing one still share it when read back, even if
+ * it contains itself.
+ */
+namespace BinaryFormat
+{
+    const unsigned char version = 1;
+
+    class Encoder
+    {
+    public:
+        explicit Encoder(std::string &out) : out(out)
+        {}
+
+        /* Appends value to out, throws for anything that can't be written, e.g. a procedure */
+        void write(Expressions::Expression &value);
+
+    private:
+        void writeValue(Expressions::Expression &value);
+
+        void writeInteger(const boost::multiprecision::mpz_int &value);
+
+        void writeUnsigned(unsigned long long value);
+
+        void writeSigned(long long value);
+
+        void writeString(const std::string &str);
+
+        /* Little-endian whatever the host's byte order, like readDouble expects */
+        void writeDouble(double value);
+
+        /* Writes a back reference and returns true if shared was written before, remembers it otherwise */
+        bool writeShared(const void *shared);
+
+        std::string &out;
+        std::unordered_map<const void *, size_t> sharedIndex;
+    };
+
+    class Decoder
+    {
+    public:
+        Decoder(std::streambuf &source, std::shared_ptr<Expressions::Scope> scope)
+                : source(source), scope(std::move(scope))
+        {}
+
+        /* The next value, or nullptr if the input is at its end. Throws if the input isn't a written value. */
+        std::unique_ptr<Expressions::Expression> read();
+
+    private:
+        std::unique_ptr<Expressions::Expression> readValue();
+
+        boost::multiprecision::mpz_int readInteger();
+
+        unsigned long long readUnsigned();
+
+        long long readSigned();
+
+        std::string readString();
+
+        double readDouble();
+
+        unsigned char byte();
+
+        std::streambuf &source;
+        std::shared_ptr<Expressions::Scope> scope;
+
+        /* Mutable vectors and hash tables in the order they were first written */
+        std::vector<std::unique_ptr<Expressions::Expression>> shared;
+    };
+}
+
+#endif //RACKET_INTERPRETER_BINARY_FORMAT_H
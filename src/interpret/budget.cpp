@@ -0,0 +1,204 @@
+#include <algorithm>
+
+#include "budget.h"
+
+namespace Interpreter
+{
+    namespace
+    {
+        /* Steps between two clock reads when only a deadline is set */
+        const size_t deadlineCheckInterval = 256;
+
+        /* Steps a thread takes between two draws from a shared allowance */
+        const size_t sharedCheckInterval = 64;
+
+        std::string stepsExceeded(size_t allowance)
+        {
+            return "Exceeded the budget of " + std::to_string(allowance) + " evaluation steps";
+        }
+    }
+
+    StepBudget &stepBudget()
+    {
+        // Outlives its thread like the RuntimeCounters pointing at it, so the steps still count in the totals
+        thread_local StepBudget &budget = *new StepBudget();
+        return budget;
+    }
+
+    size_t StepBudget::position() const
+    {
+        return steps.load(std::memory_order_relaxed) + charged;
+    }
+
+    void StepBudget::check()
+    {
+        if (limits.stepLimit != 0 && position() >= limits.stepLimit)
+            throw BudgetExceeded(stepsExceeded(limits.stepAllowance), limits.stepDepth);
+
+        if (limits.shared)
+        {
+            drawShared();
+
+            SharedSteps &shared = *limits.shared;
+            if (shared.allowance != 0 && shared.spent.load(std::memory_order_relaxed) >= shared.allowance)
+                throw BudgetExceeded(stepsExceeded(shared.stepAllowance), shared.stepDepth);
+            if (shared.cancelled && shared.cancelled->load(std::memory_order_relaxed))
+                throw BudgetExceeded("Evaluation was cancelled", 0);
+        }
+
+        if (limits.hasDeadline && std::chrono::steady_clock::now() >= limits.deadline)
+            throw BudgetExceeded("Exceeded the time budget of " + std::to_string(limits.timeoutMs) + " ms",
+                                 limits.deadlineDepth);
+
+        rearm();
+    }
+
+    void StepBudget::charge(size_t count)
+    {
+        charged += count;
+        check();
+    }
+
+    void StepBudget::rearm()
+    {
+        size_t current = steps.load(std::memory_order_relaxed);
+
+        checkAt = std::numeric_limits<size_t>::max();
+        if (limits.stepLimit != 0) checkAt = limits.stepLimit > charged ? limits.stepLimit - charged : current;
+        if (limits.shared && (limits.shared->allowance != 0 || limits.shared->cancelled))
+            checkAt = std::min(checkAt, current + sharedCheckInterval);
+        if (limits.hasDeadline) checkAt = std::min(checkAt, current + deadlineCheckInterval);
+    }
+
+    void StepBudget::drawShared()
+    {
+        size_t now = position();
+
+        limits.shared->spent.fetch_add(now - limits.sharedFrom, std::memory_order_relaxed);
+        limits.sharedFrom = now;
+    }
+
+    SharedBudget::SharedBudget() : steps(std::make_shared<SharedSteps>())
+    {
+        StepBudget &budget = stepBudget();
+        const StepBudget::Limits &limits = budget.limits;
+        startPosition = budget.position();
+
+        if (limits.stepLimit != 0)
+        {
+            steps->allowance = limits.stepLimit > startPosition ? limits.stepLimit - startPosition : 1;
+            steps->stepAllowance = limits.stepAllowance;
+            steps->stepDepth = limits.stepDepth;
+        }
+
+        // Helping a loop already, what is left of that loop's allowance may be tighter
+        if (limits.shared && limits.shared->allowance != 0)
+        {
+            budget.drawShared();
+
+            size_t spent = limits.shared->spent.load(std::memory_order_relaxed);
+            size_t left = limits.shared->allowance > spent ? limits.shared->allowance - spent : 1;
+
+            if (steps->allowance == 0 || left < steps->allowance)
+            {
+                steps->allowance = left;
+                steps->stepAllowance = limits.shared->stepAllowance;
+                steps->stepDepth = limits.shared->stepDepth;
+            }
+        }
+
+        if (limits.shared) steps->cancelled = limits.shared->cancelled;
+
+        hasDeadline = limits.hasDeadline;
+        timeoutMs = limits.timeoutMs;
+        deadline = limits.deadline;
+        deadlineDepth = limits.deadlineDepth;
+        depth = limits.depth;
+    }
+
+    void SharedBudget::chargeHelpers()
+    {
+        StepBudget &budget = stepBudget();
+
+        size_t own = budget.position() - startPosition;
+        size_t spent = steps->spent.load(std::memory_order_relaxed);
+
+        budget.charge(spent > own ? spent - own : 0);
+    }
+
+    void SharedBudget::cancelWhen(const std::atomic<bool> &flag)
+    {
+        steps->cancelled = &flag;
+    }
+
+    BudgetScope::BudgetScope(size_t maxSteps, long timeoutMs)
+    {
+        StepBudget &budget = stepBudget();
+        saved = budget.limits;
+
+        StepBudget::Limits &limits = budget.limits;
+        depth = ++limits.depth;
+
+        // An enclosing limit that runs out first stays in effect
+        size_t stepLimit = budget.position() + maxSteps;
+        if (maxSteps != 0 && (limits.stepLimit == 0 || stepLimit < limits.stepLimit))
+        {
+            limits.stepLimit = stepLimit;
+            limits.stepAllowance = maxSteps;
+            limits.stepDepth = depth;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        if (timeoutMs > 0 && (!limits.hasDeadline || deadline < limits.deadline))
+        {
+            limits.hasDeadline = true;
+            limits.deadline = deadline;
+            limits.timeoutMs = timeoutMs;
+            limits.deadlineDepth = depth;
+        }
+
+        budget.rearm();
+    }
+
+    BudgetScope::BudgetScope(const SharedBudget &share)
+    {
+        StepBudget &budget = stepBudget();
+        if (budget.limits.shared) budget.drawShared();
+        saved = budget.limits;
+
+        StepBudget::Limits &limits = budget.limits;
+        limits.depth = std::max(limits.depth, share.depth);
+        depth = ++limits.depth;
+
+        limits.shared = share.steps;
+        limits.sharedFrom = budget.position();
+
+        if (share.hasDeadline && (!limits.hasDeadline || share.deadline < limits.deadline))
+        {
+            limits.hasDeadline = true;
+            limits.deadline = share.deadline;
+            limits.timeoutMs = share.timeoutMs;
+            limits.deadlineDepth = share.deadlineDepth;
+        }
+
+        budget.rearm();
+    }
+
+    BudgetScope::~BudgetScope()
+    {
+        StepBudget &budget = stepBudget();
+
+        // Steps drawn from another allowance are still owed to the enclosing one, they are drawn from it next
+        if (budget.limits.shared) budget.drawShared();
+        if (saved.shared == budget.limits.shared) saved.sharedFrom = budget.limits.sharedFrom;
+
+        // Keep counting steps, only the limits are restored
+        budget.limits = saved;
+        budget.rearm();
+    }
+
+    bool BudgetScope::exceededHere(const BudgetExceeded &exceeded) const
+    {
+        return exceeded.depth == depth;
+    }
+}
@@ -0,0 +1,151 @@
+#ifndef RACKET_INTERPRETER_BUDGET_H
+#define RACKET_INTERPRETER_BUDGET_H
+
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace Interpreter
+{
+    class BudgetExceeded : public std::runtime_error
+    {
+    public:
+        BudgetExceeded(const std::string &what, size_t depth) : std::runtime_error(what), depth(depth)
+        {}
+
+        /* Nesting depth of the BudgetScope whose limit was gone over */
+        size_t depth;
+    };
+
+    /* Steps taken by every thread under a SharedBudget, against the allowance it was given */
+    struct SharedSteps
+    {
+        std::atomic<size_t> spent{0};
+
+        /* 0 for unlimited */
+        size_t allowance = 0;
+
+        /* stepAllowance and stepDepth of the limit the allowance was taken from */
+        size_t stepAllowance = 0, stepDepth = 0;
+
+        /* Once set, every thread drawing from the allowance stops, nullptr if it can't be cancelled */
+        const std::atomic<bool> *cancelled = nullptr;
+    };
+
+    /**
+     * Per-thread count of evaluation steps, with an optional step limit and deadline.
+     * Every step taken through Expressions::evaluate is counted, the limits are only looked at
+     * when the count reaches checkAt, so an unlimited budget costs an increment and a compare.
+     */
+    struct StepBudget
+    {
+        struct Limits
+        {
+            size_t stepLimit = 0, stepAllowance = 0, stepDepth = 0;
+            bool hasDeadline = false;
+            long timeoutMs = 0;
+            std::chrono::steady_clock::time_point deadline;
+            size_t deadlineDepth = 0;
+
+            /* Set while helping another thread, this thread's steps are also drawn from it */
+            std::shared_ptr<SharedSteps> shared;
+            size_t sharedFrom = 0;
+
+            /* BudgetScopes open on this thread */
+            size_t depth = 0;
+        };
+
+        /* Only the owning thread writes it, other threads read it for runtimeStats() */
+        std::atomic<size_t> steps{0};
+
+        /* Steps other threads took on this thread's behalf, they count against its limits too */
+        size_t charged = 0;
+
+        size_t checkAt = std::numeric_limits<size_t>::max();
+
+        Limits limits;
+
+        /* Steps counted against the limits so far, the limits are positions on this count */
+        size_t position() const;
+
+        void check();
+
+        /* Counts steps other threads took on behalf of this one, throwing if they went over a limit */
+        void charge(size_t count);
+
+        /* Recomputes checkAt from the limits */
+        void rearm();
+
+        /* Draws the steps taken since the last draw from limits.shared */
+        void drawShared();
+    };
+
+    StepBudget &stepBudget();
+
+    inline void countStep()
+    {
+        StepBudget &budget = stepBudget();
+        size_t steps = budget.steps.load(std::memory_order_relaxed) + 1;
+
+        budget.steps.store(steps, std::memory_order_relaxed);
+        if (steps >= budget.checkAt) budget.check();
+    }
+
+    /**
+     * The limits of a thread, handed to the threads helping it with a parallel loop. The steps left before its
+     * step limit become an allowance every participant draws from, so the loop as a whole stays within the
+     * limit whichever thread ends up doing the expensive work. Every participant runs under a
+     * BudgetScope(share), and the thread that created the share calls chargeHelpers() once the loop is done.
+     */
+    class SharedBudget
+    {
+    public:
+        /* Takes the limits in effect on the calling thread */
+        SharedBudget();
+
+        /* Charges the steps the other participants took to the calling thread, throwing if they went over */
+        void chargeHelpers();
+
+        /* Stops the participants with BudgetExceeded once flag is set, flag must outlive them */
+        void cancelWhen(const std::atomic<bool> &flag);
+
+    private:
+        friend class BudgetScope;
+
+        std::shared_ptr<SharedSteps> steps;
+        size_t startPosition;
+
+        bool hasDeadline;
+        long timeoutMs;
+        std::chrono::steady_clock::time_point deadline;
+        size_t deadlineDepth, depth;
+    };
+
+    /**
+     * Limits the evaluation done on this thread while it is alive. A limit of 0 means unlimited.
+     * Scopes nest: the limits in effect are the tighter of this scope's and the enclosing scope's.
+     * Throws BudgetExceeded from the step that goes over either limit.
+     */
+    class BudgetScope
+    {
+    public:
+        BudgetScope(size_t maxSteps, long timeoutMs);
+
+        /* Adds the limits of share, drawing this thread's steps from its allowance */
+        explicit BudgetScope(const SharedBudget &share);
+
+        ~BudgetScope();
+
+        /* Whether exceeded went over a limit of this scope, rather than one of an enclosing scope */
+        bool exceededHere(const BudgetExceeded &exceeded) const;
+
+    private:
+        StepBudget::Limits saved;
+        size_t depth;
+    };
+}
+
+#endif //RACKET_INTERPRETER_BUDGET_H
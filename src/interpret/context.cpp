@@ -0,0 +1,135 @@
+#include <algorithm>
+
+#include "context.h"
+#include "../expressions/struct_expression.h"
+#include "../expressions/concurrency_expression.h"
+
+namespace Interpreter
+{
+    Context::Context()
+            : functions(Functions::funcMap), specialForms(Functions::specialFormMap), heap(Memory::createRegistry())
+    {
+        globalScope.reset(new Expressions::Scope(*this));
+        Functions::defineConstants(globalScope);
+    }
+
+    Context::Context(Context &parent)
+            : functions(parent.functions), specialForms(parent.specialForms), structs(parent.structs),
+              heap(Memory::createRegistry())
+    {
+        globalScope.reset(new Expressions::Scope(*this, parent.globalScope));
+    }
+
+    Context::~Context()
+    {
+        cancelBackground();
+
+        globalScope->clear();
+        testCases.clear();
+
+        // Futures of other contexts may be using scopes layered under this one's
+        if (!BackgroundWork::sharingHeap()) Memory::collect(globalScope.get());
+        globalScope.reset();
+
+        Memory::releaseRegistry(heap);
+    }
+
+    void Context::defineStruct(const std::string &structName, const std::vector<std::string> &structFields)
+    {
+        StructFunctions::addStructFunctions(functions, structName, structFields);
+        structs[structName] = structFields;
+    }
+
+    bool Context::isBuiltin(const std::string &name) const
+    {
+        return functions.count(name) > 0 || specialForms.count(name) > 0;
+    }
+
+    void Context::trace(Memory::Tracer &tracer)
+    {
+        {
+            std::lock_guard<std::mutex> guard(testCasesLock);
+            for (auto &testCase : testCases)
+            {
+                tracer.mark(testCase.test.get());
+                tracer.mark(testCase.expected.get());
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(externalRootsLock);
+        for (auto &root : externalRoots)
+            if (auto expr = root.lock()) tracer.mark(expr.get());
+    }
+
+    void Context::addExternalRoot(const std::shared_ptr<Expressions::Expression> &root)
+    {
+        std::lock_guard<std::mutex> guard(externalRootsLock);
+
+        externalRoots.erase(std::remove_if(externalRoots.begin(), externalRoots.end(),
+                                           [](const std::weak_ptr<Expressions::Expression> &held)
+                                           { return held.expired(); }), externalRoots.end());
+        externalRoots.push_back(root);
+    }
+
+    void Context::addFuture(const std::shared_ptr<Expressions::FutureState> &future)
+    {
+        future->budget->cancelWhen(cancelled);
+
+        std::lock_guard<std::mutex> guard(futuresLock);
+
+        // Forget the futures that are gone, so a long running context doesn't pile them up
+        futures.erase(std::remove_if(futures.begin(), futures.end(),
+                                     [](const std::weak_ptr<Expressions::FutureState> &state)
+                                     { return state.expired(); }), futures.end());
+        futures.push_back(future);
+    }
+
+    void Context::addPlace(const std::shared_ptr<Expressions::PlaceState> &place)
+    {
+        place->budget->cancelWhen(cancelled);
+
+        std::lock_guard<std::mutex> guard(futuresLock);
+
+        places.erase(std::remove_if(places.begin(), places.end(),
+                                    [](const std::weak_ptr<Expressions::PlaceState> &state)
+                                    { return state.expired(); }), places.end());
+        places.push_back(place);
+    }
+
+    void Context::cancelBackground()
+    {
+        cancelled = true;
+
+        // Futures may start more futures and places while the earlier ones are stopping
+        while (true)
+        {
+            std::vector<std::shared_ptr<Expressions::FutureState>> running;
+            std::vector<std::shared_ptr<Expressions::PlaceState>> runningPlaces;
+            {
+                std::lock_guard<std::mutex> guard(futuresLock);
+                for (auto &future : futures)
+                    if (auto state = future.lock()) running.push_back(std::move(state));
+                for (auto &place : places)
+                    if (auto state = place.lock()) runningPlaces.push_back(std::move(state));
+                futures.clear();
+                places.clear();
+            }
+
+            if (running.empty() && runningPlaces.empty()) return;
+            for (auto &state : running) state->join();
+            for (auto &state : runningPlaces) state->join();
+        }
+    }
+
+    Context *Context::find(const Expressions::Scope *scope)
+    {
+        return scope ? scope->context : nullptr;
+    }
+
+    Context &Context::of(const Expressions::Scope &scope)
+    {
+        if (Context *context = find(&scope)) return *context;
+
+        throw std::logic_error("Scope doesn't belong to an interpreter context");
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef RACKET_INTERPRETER_CONTEXT_H
+#define RACKET_INTERPRETER_CONTEXT_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+
+#include "../functions/functions.h"
+#include "../memory/gc.h"
+
+namespace Expressions
+{
+    class Expression;
+
+    struct FutureState;
+
+    struct PlaceState;
+}
+
+namespace Interpreter
+{
+    /**
+     * One interpreter: its builtins, the structs defined so far, the queued test cases, the global scope and the
+     * heap its scopes are collected from. Contexts share nothing, so independent interpreters can live in one
+     * process and run on different threads. Everything evaluated in a context finds it through its scope, see
+     * Context::of.
+     */
+    class Context
+    {
+    public:
+        /* Starts from the registered builtins and a global scope holding the constants */
+        Context();
+
+        /**
+         * A context layered over parent: it starts with parent's builtins and structs, and its global scope is a
+         * child of parent's, so parent's globals are visible while new definitions stay here. parent must outlive
+         * it and must not define anything while it is alive.
+         */
+        explicit Context(Context &parent);
+
+        ~Context();
+
+        Context(const Context &) = delete;
+
+        Context &operator=(const Context &) = delete;
+
+        /* Adds the constructor, predicate and getters of a struct. Other threads must not be evaluating here. */
+        void defineStruct(const std::string &structName, const std::vector<std::string> &structFields);
+
+        bool isBuiltin(const std::string &name) const;
+
+        /* Marks what the context keeps alive besides the global scope */
+        void trace(Memory::Tracer &tracer);
+
+        /**
+         * Keeps root, and every scope it refers to, alive across collections for as long as anything outside the
+         * heap holds on to it, such as a procedure an embedder kept as a Racquet::Value
+         */
+        void addExternalRoot(const std::shared_ptr<Expressions::Expression> &root);
+
+        /* Keeps track of a future started here, so it is stopped before the context goes away */
+        void addFuture(const std::shared_ptr<Expressions::FutureState> &future);
+
+        /* Keeps track of a place created here like a future, before its thread starts */
+        void addPlace(const std::shared_ptr<Expressions::PlaceState> &place);
+
+        /**
+         * Cancels the futures and places started here and waits for all of them to stop. Nothing evaluated here
+         * is running on another thread afterwards. Called by the destructor.
+         */
+        void cancelBackground();
+
+        /* The context scope belongs to, nullptr for scopes made outside of any */
+        static Context *find(const Expressions::Scope *scope);
+
+        static Context &of(const Expressions::Scope &scope);
+
+    public:
+        Functions::builtin_table functions;
+        Functions::builtin_table specialForms;
+
+        /* Fields of every struct defined here, by struct name */
+        std::map<std::string, std::vector<std::string>> structs;
+
+        std::list<TestingFunctions::TestCase> testCases;
+        std::mutex testCasesLock;
+
+        /* Test cases that failed in every run-tests so far, racquet run exits with 1 if there are any */
+        std::atomic<size_t> failedTests{0};
+
+        std::vector<std::weak_ptr<Expressions::Expression>> externalRoots;
+        std::mutex externalRootsLock;
+
+        /* Futures and places started here, and whether they were told to stop */
+        std::vector<std::weak_ptr<Expressions::FutureState>> futures;
+        std::vector<std::weak_ptr<Expressions::PlaceState>> places;
+        std::mutex futuresLock;
+        std::atomic<bool> cancelled{false};
+
+        Memory::ScopeRegistry *heap;
+
+        std::shared_ptr<Expressions::Scope> globalScope;
+    };
+}
+
+#endif //RACKET_INTERPRETER_CONTEXT_H
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <unordered_map>
+
+#include "counters.h"
+#include "budget.h"
+
+namespace Interpreter
+{
+    bool printStatsAtExit = false;
+
+    namespace
+    {
+        std::mutex registryLock;
+        std::vector<RuntimeCounters *> threadCounters;
+        std::vector<std::string> builtinNames;
+        std::unordered_map<std::string, size_t> builtinIndices;
+    }
+
+    RuntimeCounters &runtimeCounters()
+    {
+        // Counts outlive their thread so they still show up in the totals, the blocks are never released.
+        thread_local RuntimeCounters *counters = nullptr;
+
+        if (!counters)
+        {
+            counters = new RuntimeCounters();
+            counters->budget = &stepBudget();
+
+            std::lock_guard<std::mutex> guard(registryLock);
+            threadCounters.push_back(counters);
+        }
+
+        return *counters;
+    }
+
+    size_t builtinIndex(const std::string &name)
+    {
+        thread_local std::unordered_map<std::string, size_t> cache;
+
+        auto cached = cache.find(name);
+        if (cached != cache.end()) return cached->second;
+
+        std::lock_guard<std::mutex> guard(registryLock);
+        auto found = builtinIndices.find(name);
+        size_t index;
+
+        if (found != builtinIndices.end()) index = found->second;
+        else
+        {
+            index = builtinNames.size();
+            builtinNames.push_back(name);
+            builtinIndices[name] = index;
+        }
+
+        cache[name] = index;
+        return index;
+    }
+
+    void countBuiltinCall(size_t index)
+    {
+        RuntimeCounters &counters = runtimeCounters();
+
+        if (index >= counters.builtinCalls.size())
+        {
+            std::lock_guard<std::mutex> guard(counters.builtinLock);
+            while (counters.builtinCalls.size() <= index) counters.builtinCalls.emplace_back(0);
+        }
+
+        bumpCounter(counters.builtinCalls[index]);
+    }
+
+    RuntimeStats runtimeStats()
+    {
+        RuntimeStats stats;
+        std::vector<size_t> calls;
+
+        std::lock_guard<std::mutex> guard(registryLock);
+        calls.resize(builtinNames.size());
+
+        for (auto counters : threadCounters)
+        {
+            stats.steps += counters->budget->steps.load(std::memory_order_relaxed);
+            stats.lambdaCalls += counters->lambdaCalls.load(std::memory_order_relaxed);
+            stats.scopeAllocations += counters->scopeAllocations.load(std::memory_order_relaxed);
+            stats.clones += counters->clones.load(std::memory_order_relaxed);
+            stats.parses += counters->parses.load(std::memory_order_relaxed);
+            stats.gmpPromotions += counters->gmpPromotions.load(std::memory_order_relaxed);
+
+            std::lock_guard<std::mutex> builtinGuard(counters->builtinLock);
+            for (size_t i = 0; i < counters->builtinCalls.size(); ++i)
+                calls[i] += counters->builtinCalls[i].load(std::memory_order_relaxed);
+        }
+
+        for (size_t i = 0; i < calls.size(); ++i)
+        {
+            if (calls[i] == 0) continue;
+
+            stats.builtinCalls += calls[i];
+            stats.callsByBuiltin.emplace_back(builtinNames[i], calls[i]);
+        }
+
+        std::stable_sort(stats.callsByBuiltin.begin(), stats.callsByBuiltin.end(),
+                         [](const std::pair<std::string, size_t> &a, const std::pair<std::string, size_t> &b)
+                         {
+                             return a.second > b.second;
+                         });
+
+        return stats;
+    }
+
+    void printRuntimeStats(std::ostream &stream)
+    {
+        RuntimeStats stats = runtimeStats();
+
+        stream << "Evaluation steps:  " << stats.steps << std::endl;
+        stream << "Lambda calls:      " << stats.lambdaCalls << std::endl;
+        stream << "Builtin calls:     " << stats.builtinCalls << std::endl;
+        stream << "Scope allocations: " << stats.scopeAllocations << std::endl;
+        stream << "Clones:            " << stats.clones << std::endl;
+        stream << "Parses:            " << stats.parses << std::endl;
+        stream << "GMP promotions:    " << stats.gmpPromotions << std::endl;
+
+        for (auto &builtin : stats.callsByBuiltin)
+            stream << "  " << builtin.second << "\t" << builtin.first << std::endl;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef RACKET_INTERPRETER_COUNTERS_H
+#define RACKET_INTERPRETER_COUNTERS_H
+
+#include <atomic>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Interpreter
+{
+    struct StepBudget;
+
+    /**
+     * Per-thread event counts. Only the owning thread writes them, so a relaxed load and store is enough
+     * to count and other threads can still read them while taking a snapshot.
+     */
+    struct RuntimeCounters
+    {
+        std::atomic<size_t> lambdaCalls{0}, scopeAllocations{0}, clones{0}, parses{0}, gmpPromotions{0};
+
+        /* Indexed by builtinIndex(), only grown under builtinLock */
+        std::deque<std::atomic<size_t>> builtinCalls;
+        std::mutex builtinLock;
+
+        const StepBudget *budget = nullptr;
+    };
+
+    struct RuntimeStats
+    {
+        size_t steps = 0, lambdaCalls = 0, builtinCalls = 0, scopeAllocations = 0, clones = 0, parses = 0,
+                gmpPromotions = 0;
+
+        /* Calls to each builtin that was called at least once, most called first */
+        std::vector<std::pair<std::string, size_t>> callsByBuiltin;
+    };
+
+    extern bool printStatsAtExit;
+
+    RuntimeCounters &runtimeCounters();
+
+    inline void bumpCounter(std::atomic<size_t> &counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /* A stable index for counting calls to the named builtin */
+    size_t builtinIndex(const std::string &name);
+
+    void countBuiltinCall(size_t index);
+
+    /* Sums the counters of every thread */
+    RuntimeStats runtimeStats();
+
+    void printRuntimeStats(std::ostream &stream);
+}
+
+#endif //RACKET_INTERPRETER_COUNTERS_H
@@ -0,0 +1,74 @@
+#include <stdexcept>
+
+#include "csv_reader.h"
+
+namespace Interpreter
+{
+    typedef std::streambuf::traits_type traits;
+
+    bool CsvReader::next(std::streambuf &source)
+    {
+        count = 0;
+
+        int chr = source.sgetc();
+        while (chr == '\n' || chr == '\r') chr = source.snextc();
+        if (traits::eq_int_type(chr, traits::eof())) return false;
+
+        while (true)
+        {
+            CsvField &field = nextField();
+
+            if (chr == '"')
+            {
+                field.quoted = true;
+                source.sbumpc();
+
+                while (true)
+                {
+                    chr = source.sbumpc();
+                    if (traits::eq_int_type(chr, traits::eof()))
+                        throw std::invalid_argument("read-csv: Unexpected end of input in a quoted field");
+
+                    if (chr == '"')
+                    {
+                        if (source.sgetc() != '"') break;
+                        source.sbumpc();
+                    }
+
+                    field.text.push_back(traits::to_char_type(chr));
+                }
+
+                chr = source.sgetc();
+            }
+
+            // Anything after the closing quote is kept as well, like the text of an unquoted field
+            while (!traits::eq_int_type(chr, traits::eof()) && chr != separator && chr != '\n' && chr != '\r')
+            {
+                field.text.push_back(traits::to_char_type(chr));
+                chr = source.snextc();
+            }
+
+            if (chr == separator)
+            {
+                chr = source.snextc();
+                continue;
+            }
+
+            if (chr == '\r' && source.snextc() == '\n') source.sbumpc();
+            else if (chr == '\n') source.sbumpc();
+
+            return true;
+        }
+    }
+
+    CsvField &CsvReader::nextField()
+    {
+        if (count == fields.size()) fields.emplace_back();
+
+        CsvField &field = fields[count++];
+        field.text.clear();
+        field.quoted = false;
+
+        return field;
+    }
+}
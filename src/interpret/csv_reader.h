@@ -0,0 +1,51 @@
+#ifndef RACKET_INTERPRETER_CSV_READER_H
+#define RACKET_INTERPRETER_CSV_READER_H
+
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace Interpreter
+{
+    struct CsvField
+    {
+        std::string text;
+
+        /* Quoted fields are always strings, even if they look like numbers */
+        bool quoted = false;
+    };
+
+    /**
+     * Reads comma separated records one at a time, straight from a stream buffer. Fields may be quoted, a quoted
+     * field can hold separators, line breaks and doubled quotes. Records end at \n or \r\n, blank lines are
+     * skipped. The fields of the last record stay valid until the next one is read, their storage is reused.
+     */
+    class CsvReader
+    {
+    public:
+        explicit CsvReader(char separator = ',') : separator(separator)
+        {}
+
+        /* Reads the next record, false at the end of the input. Throws if the input ends within a quoted field. */
+        bool next(std::streambuf &source);
+
+        size_t size() const
+        {
+            return count;
+        }
+
+        const CsvField &operator[](size_t index) const
+        {
+            return fields[index];
+        }
+
+    private:
+        CsvField &nextField();
+
+        char separator;
+        std::vector<CsvField> fields;
+        size_t count = 0;
+    };
+}
+
+#endif //RACKET_INTERPRETER_CSV_READER_H
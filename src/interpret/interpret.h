@@ -13,7 +13,16 @@ namespace Interpreter
 
     Expressions::expression_vector interpretSaveSteps(std::unique_ptr<Expressions::Expression>);
 
+    /* Reads the next complete top-level form, skipping comment lines */
+    std::string read(std::istream &);
+
     void repl(std::istream &, std::shared_ptr<Expressions::Scope> &, const bool &);
+
+    /**
+     * Evaluates every form of a script, printing the values like the repl does, until the end of the input or
+     * (exit). Stops at the first error, printing it to std::cerr. Returns the exit status of the script.
+     */
+    int run(std::istream &, std::shared_ptr<Expressions::Scope> &);
 }
 
 #endif //RACKET_INTERPRETER_INTERPRET_H
@@ -0,0 +1,576 @@
+#include <charconv>
+#include <cstring>
+
+#include "json.h"
+#include "../expressions/hash_expression.h"
+#include "../expressions/vector_expression.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Json
+{
+    typedef std::unique_ptr<Expressions::Expression> expr_ptr;
+    typedef std::shared_ptr<Expressions::Scope> scope_ptr;
+    using boost::multiprecision::mpz_int;
+
+    namespace
+    {
+        /* Deeper nesting is refused rather than risking the stack, this also stops writing a table containing
+         * itself */
+        const size_t maxDepth = 512;
+
+        /* The writer hands its buffer over once it holds this much */
+        const size_t writeBlockSize = 1u << 16u;
+
+        /* Digits that always fit in a long long */
+        const size_t fastDigits = 18;
+
+        bool isWhitespace(char chr)
+        {
+            return chr == ' ' || chr == '\n' || chr == '\r' || chr == '\t';
+        }
+
+        bool isDigit(char chr)
+        {
+            return chr >= '0' && chr <= '9';
+        }
+
+        /* A symbol the way string->symbol makes it */
+        std::string symbolFor(const std::string &str)
+        {
+            if (str.empty()) return "'||";
+            if (str.find_first_of(" \n\t") != std::string::npos) return "'|" + str + "|";
+
+            return "'" + str;
+        }
+
+        /* The name of a symbol the way symbol->string gives it */
+        std::string symbolName(const std::string &symbol)
+        {
+            if (symbol.length() > 1 && symbol[1] == '|') return symbol.substr(2, symbol.length() - 3);
+
+            return symbol.substr(1);
+        }
+
+        void appendUtf8(std::string &out, unsigned long codePoint)
+        {
+            if (codePoint < 0x80) out.push_back(static_cast<char>(codePoint));
+            else if (codePoint < 0x800)
+            {
+                out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            else if (codePoint < 0x10000)
+            {
+                out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            else
+            {
+                out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+        }
+
+        class Reader
+        {
+        public:
+            Reader(const std::string &text, size_t position, scope_ptr scope)
+                    : text(text), position(position), scope(std::move(scope))
+            {}
+
+            expr_ptr value(size_t depth)
+            {
+                if (depth > maxDepth) fail("Nested too deeply");
+
+                skipWhitespace();
+                if (position == text.size()) fail("Unexpected end of input");
+
+                char chr = text[position];
+                if (chr == '{') return object(depth);
+                if (chr == '[') return array(depth);
+                if (chr == '"') return std::make_unique<Expressions::StringExpression>(string(), scope);
+                if (chr == 't')
+                    return literal("true", std::make_unique<Expressions::BooleanValueExpression>(true, scope));
+                if (chr == 'f')
+                    return literal("false", std::make_unique<Expressions::BooleanValueExpression>(false, scope));
+                if (chr == 'n') return literal("null", std::make_unique<Expressions::SymbolExpression>("'null", scope));
+                if (chr == '-' || isDigit(chr)) return number();
+
+                fail(std::string("Unexpected character ") + chr);
+            }
+
+            void skipWhitespace()
+            {
+                while (position < text.size() && isWhitespace(text[position])) ++position;
+            }
+
+            [[noreturn]] void fail(const std::string &message)
+            {
+                throw std::invalid_argument("Invalid JSON: " + message + " at offset " + std::to_string(position));
+            }
+
+            const std::string &text;
+            size_t position;
+
+        private:
+            void expect(char chr)
+            {
+                skipWhitespace();
+                if (position == text.size() || text[position] != chr) fail(std::string("Expected ") + chr);
+
+                ++position;
+            }
+
+            /* Skips chr if it comes next */
+            bool accept(char chr)
+            {
+                skipWhitespace();
+                if (position == text.size() || text[position] != chr) return false;
+
+                ++position;
+                return true;
+            }
+
+            expr_ptr object(size_t depth)
+            {
+                ++position;
+                auto table = std::make_unique<Expressions::HashExpression>(false, scope);
+                if (accept('}')) return table;
+
+                do
+                {
+                    skipWhitespace();
+                    if (position == text.size() || text[position] != '"') fail("Expected a key");
+
+                    auto key = std::make_unique<Expressions::SymbolExpression>(symbolFor(string()), scope);
+                    expect(':');
+                    table = table->with(std::move(key), value(depth + 1), scope);
+                }
+                while (accept(','));
+
+                expect('}');
+                return table;
+            }
+
+            expr_ptr array(size_t depth)
+            {
+                ++position;
+                std::list<expr_ptr> elements;
+
+                if (!accept(']'))
+                {
+                    do elements.push_back(value(depth + 1));
+                    while (accept(','));
+
+                    expect(']');
+                }
+
+                return std::make_unique<Expressions::ListExpression>(std::move(elements), scope);
+            }
+
+            expr_ptr literal(const char *word, expr_ptr result)
+            {
+                size_t length = std::strlen(word);
+                if (text.compare(position, length, word) != 0) fail("Unexpected character " + text.substr(position, 1));
+
+                position += length;
+                return result;
+            }
+
+            /* The characters of a string, copied in runs between the characters that need a closer look */
+            std::string string()
+            {
+                std::string str;
+                ++position;
+
+                while (true)
+                {
+                    size_t run = scanString(text.data() + position, text.size() - position);
+                    str.append(text, position, run);
+                    position += run;
+
+                    if (position == text.size()) fail("Unexpected end of input in a string");
+
+                    char chr = text[position++];
+                    if (chr == '"') return str;
+                    if (chr != '\\') fail("Unescaped control character in a string");
+                    if (position == text.size()) fail("Unexpected end of input in a string");
+
+                    switch (text[position++])
+                    {
+                        case '"': str.push_back('"'); break;
+                        case '\\': str.push_back('\\'); break;
+                        case '/': str.push_back('/'); break;
+                        case 'b': str.push_back('\b'); break;
+                        case 'f': str.push_back('\f'); break;
+                        case 'n': str.push_back('\n'); break;
+                        case 'r': str.push_back('\r'); break;
+                        case 't': str.push_back('\t'); break;
+                        case 'u': appendUtf8(str, codePoint()); break;
+                        default: --position; fail("Invalid escape");
+                    }
+                }
+            }
+
+            unsigned long hexQuad()
+            {
+                if (text.size() - position < 4) fail("Expected four hex digits");
+
+                unsigned long value = 0;
+                for (size_t end = position + 4; position < end; ++position)
+                {
+                    char chr = text[position];
+                    value <<= 4u;
+
+                    if (isDigit(chr)) value |= static_cast<unsigned long>(chr - '0');
+                    else if (chr >= 'a' && chr <= 'f') value |= static_cast<unsigned long>(chr - 'a' + 10);
+                    else if (chr >= 'A' && chr <= 'F') value |= static_cast<unsigned long>(chr - 'A' + 10);
+                    else fail("Expected a hex digit");
+                }
+
+                return value;
+            }
+
+            /* The character of a \u escape, joining a surrogate pair into one */
+            unsigned long codePoint()
+            {
+                unsigned long high = hexQuad();
+                if (high < 0xD800 || high > 0xDBFF) return high;
+
+                if (text.compare(position, 2, "\\u") != 0) return 0xFFFD;
+                position += 2;
+
+                unsigned long low = hexQuad();
+                if (low < 0xDC00 || low > 0xDFFF) return 0xFFFD;
+
+                return 0x10000 + ((high - 0xD800) << 10u) + (low - 0xDC00);
+            }
+
+            size_t digits()
+            {
+                size_t start = position;
+                while (position < text.size() && isDigit(text[position])) ++position;
+
+                if (position == start) fail("Expected a digit");
+                return position - start;
+            }
+
+            expr_ptr number()
+            {
+                size_t start = position;
+                bool negative = text[position] == '-';
+                if (negative) ++position;
+
+                size_t integerDigits = digits();
+                if (integerDigits > 1 && text[position - integerDigits] == '0') fail("Leading zero in a number");
+
+                bool exact = true;
+                if (position < text.size() && text[position] == '.')
+                {
+                    ++position;
+                    digits();
+                    exact = false;
+                }
+
+                if (position < text.size() && (text[position] == 'e' || text[position] == 'E'))
+                {
+                    ++position;
+                    if (position < text.size() && (text[position] == '+' || text[position] == '-')) ++position;
+                    digits();
+                    exact = false;
+                }
+
+                std::string literal = text.substr(start, position - start);
+                if (!exact)
+                {
+                    // From the text rather than through a double, so 0.1 stays 0.1
+                    Expressions::InexactNumberExpression::numerical_type value(literal);
+                    return std::make_unique<Expressions::InexactNumberExpression>(value, scope);
+                }
+
+                if (integerDigits > fastDigits)
+                    return std::make_unique<Expressions::NumericalValueExpression>(mpz_int(literal), mpz_int(1), scope);
+
+                long long value = 0;
+                for (size_t i = negative ? 1 : 0; i < literal.size(); ++i) value = value * 10 + (literal[i] - '0');
+
+                Expressions::NumericalValueExpression::numerical_type exactValue(negative ? -value : value);
+                return std::make_unique<Expressions::NumericalValueExpression>(exactValue, scope);
+            }
+
+            scope_ptr scope;
+        };
+
+        void readString(std::streambuf &source, std::string &text)
+        {
+            typedef std::streambuf::traits_type traits;
+            text.push_back(traits::to_char_type(source.sbumpc()));
+
+            while (true)
+            {
+                int chr = source.sbumpc();
+                if (traits::eq_int_type(chr, traits::eof()))
+                    throw std::invalid_argument("Invalid JSON: Unexpected end of input in a string");
+
+                text.push_back(traits::to_char_type(chr));
+
+                if (chr == '"') return;
+                if (chr == '\\')
+                {
+                    chr = source.sbumpc();
+                    if (traits::eq_int_type(chr, traits::eof()))
+                        throw std::invalid_argument("Invalid JSON: Unexpected end of input in a string");
+
+                    text.push_back(traits::to_char_type(chr));
+                }
+            }
+        }
+    }
+
+    size_t scanString(const char *data, size_t length)
+    {
+        size_t i = 0;
+
+#ifdef __SSE2__
+        const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), lastControl = _mm_set1_epi8(0x1F);
+
+        for (; i + 16 <= length; i += 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+
+            // A byte is a control character if the unsigned maximum of it and 0x1F is 0x1F
+            __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                                           _mm_cmpeq_epi8(_mm_max_epu8(chunk, lastControl), lastControl));
+
+            int mask = _mm_movemask_epi8(special);
+            if (mask != 0) return i + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+#endif
+
+        for (; i < length; ++i)
+        {
+            auto chr = static_cast<unsigned char>(data[i]);
+            if (chr == '"' || chr == '\\' || chr < 0x20) return i;
+        }
+
+        return length;
+    }
+
+    expr_ptr parse(const std::string &text, size_t &position, const scope_ptr &scope)
+    {
+        Reader reader(text, position, scope);
+        expr_ptr value = reader.value(0);
+
+        position = reader.position;
+        return value;
+    }
+
+    bool readValue(std::streambuf &source, std::string &text)
+    {
+        typedef std::streambuf::traits_type traits;
+        text.clear();
+
+        int chr = source.sgetc();
+        while (!traits::eq_int_type(chr, traits::eof()) && isWhitespace(traits::to_char_type(chr)))
+            chr = source.snextc();
+
+        if (traits::eq_int_type(chr, traits::eof())) return false;
+
+        if (chr == '"')
+        {
+            readString(source, text);
+            return true;
+        }
+
+        if (chr != '{' && chr != '[')
+        {
+            // A number or a literal, which ends at the first character that can't be part of one
+            while (!traits::eq_int_type(chr, traits::eof()) && !isWhitespace(traits::to_char_type(chr))
+                   && chr != ',' && chr != ']' && chr != '}' && chr != '[' && chr != '{' && chr != '"')
+            {
+                text.push_back(traits::to_char_type(chr));
+                chr = source.snextc();
+            }
+
+            // Taken along so parsing fails on it, instead of every read stopping at it again
+            if (text.empty()) text.push_back(traits::to_char_type(source.sbumpc()));
+
+            return true;
+        }
+
+        size_t depth = 0;
+        do
+        {
+            if (chr == '"')
+            {
+                readString(source, text);
+            }
+            else
+            {
+                if (chr == '{' || chr == '[') ++depth;
+                else if (chr == '}' || chr == ']') --depth;
+
+                text.push_back(traits::to_char_type(source.sbumpc()));
+            }
+
+            chr = source.sgetc();
+            if (depth > 0 && traits::eq_int_type(chr, traits::eof()))
+                throw std::invalid_argument("Invalid JSON: Unexpected end of input");
+        }
+        while (depth > 0);
+
+        return true;
+    }
+
+/* Writer */
+
+    void Writer::write(Expressions::Expression &value)
+    {
+        writeValue(value, 0);
+        flushIfFull();
+    }
+
+    void Writer::flush()
+    {
+        if (!buffer.empty()) sink(buffer);
+        buffer.clear();
+    }
+
+    void Writer::flushIfFull()
+    {
+        if (buffer.size() >= writeBlockSize) flush();
+    }
+
+    void Writer::writeValue(Expressions::Expression &value, size_t depth)
+    {
+        if (depth > maxDepth) throw std::invalid_argument("write-json: Nested too deeply: " + value.toString());
+        flushIfFull();
+
+        if (auto str = dynamic_cast<Expressions::StringExpression *>(&value)) writeString(str->str);
+        else if (auto boolean = dynamic_cast<Expressions::BooleanValueExpression *>(&value))
+            buffer += boolean->value ? "true" : "false";
+        else if (auto symbol = dynamic_cast<Expressions::SymbolExpression *>(&value))
+        {
+            if (symbol->symbol != "'null")
+                throw std::invalid_argument("write-json: Expected a jsexpr, found " + symbol->symbol);
+            buffer += "null";
+        }
+        else if (auto list = dynamic_cast<Expressions::ListExpression *>(&value))
+        {
+            buffer.push_back('[');
+            for (auto it = list->list.begin(); it != list->list.end(); ++it)
+            {
+                if (it != list->list.begin()) buffer.push_back(',');
+                writeValue(**it, depth + 1);
+            }
+            buffer.push_back(']');
+        }
+        else if (auto vector = dynamic_cast<Expressions::VectorExpression *>(&value))
+        {
+            Expressions::expression_vector elements = vector->elements();
+
+            buffer.push_back('[');
+            for (size_t i = 0; i < elements.size(); ++i)
+            {
+                if (i > 0) buffer.push_back(',');
+                writeValue(*elements[i], depth + 1);
+            }
+            buffer.push_back(']');
+        }
+        else if (auto table = dynamic_cast<Expressions::HashExpression *>(&value))
+        {
+            bool first = true;
+            buffer.push_back('{');
+
+            table->forEach([this, &first, depth](Expressions::Expression &key, Expressions::Expression &entry)
+                           {
+                               if (!first) buffer.push_back(',');
+                               first = false;
+
+                               if (auto keySymbol = dynamic_cast<Expressions::SymbolExpression *>(&key))
+                                   writeString(symbolName(keySymbol->symbol));
+                               else if (auto keyString = dynamic_cast<Expressions::StringExpression *>(&key))
+                                   writeString(keyString->str);
+                               else throw std::invalid_argument("write-json: Expected a symbol or string key, found "
+                                                                + key.toString());
+
+                               buffer.push_back(':');
+                               writeValue(entry, depth + 1);
+                           });
+
+            buffer.push_back('}');
+        }
+        else writeNumber(value);
+    }
+
+    void Writer::writeString(const std::string &str)
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+
+        buffer.push_back('"');
+
+        size_t position = 0;
+        while (position < str.size())
+        {
+            size_t run = scanString(str.data() + position, str.size() - position);
+            buffer.append(str, position, run);
+            position += run;
+
+            if (position == str.size()) break;
+
+            char chr = str[position++];
+            switch (chr)
+            {
+                case '"': buffer += "\\\""; break;
+                case '\\': buffer += "\\\\"; break;
+                case '\b': buffer += "\\b"; break;
+                case '\f': buffer += "\\f"; break;
+                case '\n': buffer += "\\n"; break;
+                case '\r': buffer += "\\r"; break;
+                case '\t': buffer += "\\t"; break;
+                default:
+                    buffer += "\\u00";
+                    buffer.push_back(hexDigits[(chr >> 4) & 0xF]);
+                    buffer.push_back(hexDigits[chr & 0xF]);
+            }
+        }
+
+        buffer.push_back('"');
+    }
+
+    void Writer::writeNumber(Expressions::Expression &value)
+    {
+        if (auto exact = dynamic_cast<Expressions::NumericalValueExpression *>(&value))
+        {
+            if (denominator(exact->value) == 1)
+            {
+                buffer += numerator(exact->value).str();
+                return;
+            }
+
+            // Only integers have an exact JSON form, other rationals are written as the nearest double
+            char digits[32];
+            auto result = std::to_chars(digits, digits + sizeof(digits), exact->value.convert_to<double>());
+            buffer.append(digits, result.ptr);
+            return;
+        }
+
+        if (auto inexact = dynamic_cast<Expressions::InexactNumberExpression *>(&value))
+        {
+            std::string digits = inexact->value.str();
+
+            // Keeps the number inexact when it is read back
+            if (digits.find_first_of(".e") == std::string::npos) digits += ".0";
+            buffer += digits;
+            return;
+        }
+
+        throw std::invalid_argument("write-json: Expected a jsexpr, found " + value.toString());
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef RACKET_INTERPRETER_JSON_H
+#define RACKET_INTERPRETER_JSON_H
+
+#include <functional>
+#include <streambuf>
+#include <string>
+
+#include "../expressions/expressions.h"
+
+/**
+ * JSON values as expressions: objects are immutable hashes with symbol keys, arrays are lists, the literals are
+ * booleans and the symbol null. Integers are exact, numbers with a fraction or an exponent inexact.
+ */
+namespace Json
+{
+    /**
+     * Parses the value starting at position in one pass and leaves position after it. Throws if text doesn't
+     * start with a valid value.
+     */
+    std::unique_ptr<Expressions::Expression> parse(const std::string &text, size_t &position,
+                                                   const std::shared_ptr<Expressions::Scope> &scope);
+
+    /**
+     * Reads the text of the next value from source into text, without checking more than where it ends. False
+     * if only whitespace is left, throws if the input ends within the value.
+     */
+    bool readValue(std::streambuf &source, std::string &text);
+
+    /**
+     * Writes values as JSON, handing it to the sink in blocks instead of building the whole text first. Throws
+     * for anything that has no JSON form, what was written before stays written.
+     */
+    class Writer
+    {
+    public:
+        typedef std::function<void(const std::string &)> sink_function;
+
+        explicit Writer(sink_function sink) : sink(std::move(sink))
+        {}
+
+        void write(Expressions::Expression &value);
+
+        /* Hands over what is left in the buffer */
+        void flush();
+
+    private:
+        void writeValue(Expressions::Expression &value, size_t depth);
+
+        void writeString(const std::string &str);
+
+        void writeNumber(Expressions::Expression &value);
+
+        void flushIfFull();
+
+        sink_function sink;
+        std::string buffer;
+    };
+
+    /* Index of the first quote, backslash or control character in data, or length if there is none */
+    size_t scanString(const char *data, size_t length);
+}
+
+#endif //RACKET_INTERPRETER_JSON_H
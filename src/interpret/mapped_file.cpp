@@ -0,0 +1,44 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+namespace Interpreter
+{
+    MappedFile::MappedFile(const std::string &path)
+    {
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) return;
+
+        struct stat info{};
+        if (::fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+        {
+            void *mapping = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapping != MAP_FAILED)
+            {
+                data = mapping;
+                length = static_cast<size_t>(info.st_size);
+                ::madvise(data, length, MADV_SEQUENTIAL);
+
+                // The buffer is never written to, putting back a different character than was read fails instead
+                char *begin = static_cast<char *>(data);
+                setg(begin, begin, begin + length);
+            }
+        }
+
+        // The mapping stays valid once the descriptor is closed
+        ::close(descriptor);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (data) ::munmap(data, length);
+    }
+
+    bool MappedFile::isOpen() const
+    {
+        return data != nullptr;
+    }
+}
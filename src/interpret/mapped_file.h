@@ -0,0 +1,51 @@
+#ifndef RACKET_INTERPRETER_MAPPED_FILE_H
+#define RACKET_INTERPRETER_MAPPED_FILE_H
+
+#include <istream>
+#include <streambuf>
+#include <string>
+
+namespace Interpreter
+{
+    /**
+     * A stream buffer over a whole file mapped into memory, so reading it never copies it or makes a system call.
+     * Only regular, non-empty files can be mapped, check isOpen and read anything else through a file stream.
+     */
+    class MappedFile : public std::streambuf
+    {
+    public:
+        explicit MappedFile(const std::string &path);
+
+        ~MappedFile() override;
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool isOpen() const;
+
+    private:
+        void *data = nullptr;
+        size_t length = 0;
+    };
+
+    /* An input stream owning the mapping it reads from */
+    class MappedInputStream : public std::istream
+    {
+    public:
+        explicit MappedInputStream(const std::string &path) : std::istream(nullptr), file(path)
+        {
+            rdbuf(&file);
+        }
+
+        bool isOpen() const
+        {
+            return file.isOpen();
+        }
+
+    private:
+        MappedFile file;
+    };
+}
+
+#endif //RACKET_INTERPRETER_MAPPED_FILE_H
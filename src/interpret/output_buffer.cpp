@@ -0,0 +1,86 @@
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "output_buffer.h"
+
+namespace Interpreter
+{
+    OutputBuffer::OutputBuffer(int descriptor, size_t capacity) : descriptor(descriptor), buffer(capacity)
+    {}
+
+    OutputBuffer::~OutputBuffer()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        drain();
+    }
+
+    bool OutputBuffer::good() const
+    {
+        return !failed;
+    }
+
+    OutputBuffer::int_type OutputBuffer::overflow(int_type ch)
+    {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) return traits_type::not_eof(ch);
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (used == buffer.size() && !drain()) return traits_type::eof();
+
+        buffer[used++] = traits_type::to_char_type(ch);
+        return ch;
+    }
+
+    std::streamsize OutputBuffer::xsputn(const char *data, std::streamsize count)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto size = static_cast<size_t>(count);
+
+        if (used + size > buffer.size())
+        {
+            if (!drain()) return 0;
+
+            // Too large to be worth buffering
+            if (size >= buffer.size()) return writeOut(data, size) ? count : 0;
+        }
+
+        std::memcpy(buffer.data() + used, data, size);
+        used += size;
+
+        return count;
+    }
+
+    int OutputBuffer::sync()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return drain() ? 0 : -1;
+    }
+
+    bool OutputBuffer::drain()
+    {
+        bool written = writeOut(buffer.data(), used);
+        used = 0;
+
+        return written;
+    }
+
+    bool OutputBuffer::writeOut(const char *data, size_t count)
+    {
+        while (count > 0)
+        {
+            ssize_t written = ::write(descriptor, data, count);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0)
+            {
+                failed = true;
+                return false;
+            }
+
+            data += written;
+            count -= written;
+        }
+
+        return true;
+    }
+}
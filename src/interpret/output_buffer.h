@@ -0,0 +1,51 @@
+#ifndef RACKET_INTERPRETER_OUTPUT_BUFFER_H
+#define RACKET_INTERPRETER_OUTPUT_BUFFER_H
+
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+namespace Interpreter
+{
+    /**
+     * A stream buffer writing to a file descriptor in large blocks, so printing a line costs a copy instead of a
+     * system call. Only flushes when full, on flush and when destroyed. Threads may share it, every write is
+     * guarded by a lock.
+     */
+    class OutputBuffer : public std::streambuf
+    {
+    public:
+        explicit OutputBuffer(int descriptor, size_t capacity = 1u << 20u);
+
+        ~OutputBuffer() override;
+
+        OutputBuffer(const OutputBuffer &) = delete;
+
+        OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+        /* Whether every write so far reached the descriptor */
+        bool good() const;
+
+    protected:
+        int_type overflow(int_type ch) override;
+
+        std::streamsize xsputn(const char *data, std::streamsize count) override;
+
+        int sync() override;
+
+    private:
+        /* Writes out what is buffered, the lock has to be held */
+        bool drain();
+
+        bool writeOut(const char *data, size_t count);
+
+        int descriptor;
+        std::vector<char> buffer;
+        size_t used = 0;
+        bool failed = false;
+
+        std::mutex lock;
+    };
+}
+
+#endif //RACKET_INTERPRETER_OUTPUT_BUFFER_H
@@ -3,7 +3,9 @@
 //
 
 #include <iostream>
-#include <regex>
+#include <cctype>
+#include <set>
+#include <algorithm>
 
 #include "parser.h"
 #include "../functions/functions.h"
@@ -188,7 +190,7 @@ namespace Parser
     void parseSpecialForm(const std::string &str, const std::shared_ptr<Expressions::Scope> &scope,
                           std::unique_ptr<Expressions::Expression> &out)
     {
-        if (Functions::specialFormMap.count(str) > 0)
+        if (Functions::specialFormsFor(scope.get()).count(str) > 0)
         {
             out = Functions::getFormByName(str, scope);
         }
@@ -200,14 +202,169 @@ namespace Parser
         }
     }
 
+    /* Matches -?[0-9]+[./]?[0-9]* without building a std::regex, this runs for every token parsed */
     bool isNumber(const std::string &str)
     {
-        std::regex numberRegex("-?[0-9]+[./]?([0-9]*)?");
-        return !str.empty() && std::regex_match(str, numberRegex);
+        size_t i = 0;
+        if (i < str.size() && str[i] == '-') ++i;
+
+        size_t digitsStart = i;
+        while (i < str.size() && std::isdigit(static_cast<unsigned char>(str[i]))) ++i;
+        if (i == digitsStart) return false;
+
+        if (i < str.size() && (str[i] == '.' || str[i] == '/')) ++i;
+        while (i < str.size() && std::isdigit(static_cast<unsigned char>(str[i]))) ++i;
+
+        return i == str.size();
+    }
+
+    /**
+     * Tokens that never refer to a binding: literals, quoted data and the else keyword of cond.
+     */
+    bool isSelfEvaluating(const std::string &token)
+    {
+        if (token.empty()) return true;
+
+        char chr = token[0];
+        return chr == '"' || chr == '\'' || chr == '`' || chr == '#'
+               || token == "true" || token == "false" || token == "else" || isNumber(token);
+    }
+
+    void collectFreeVariables(const std::string &str, std::set<std::string> bound, std::vector<std::string> &out)
+    {
+        if (str.empty()) return;
+
+        if (str.front() != '(' && str.front() != '[')
+        {
+            if (!isSelfEvaluating(str) && bound.count(str) == 0
+                && std::find(out.begin(), out.end(), str) == out.end())
+                out.push_back(str);
+
+            return;
+        }
+
+        std::vector<std::string> tuple = parseTuple(str);
+        if (tuple.empty()) return;
+
+        const std::string &head = tuple.front();
+
+        if (head == "lambda" && tuple.size() > 1)
+        {
+            for (auto &param : parseTuple(tuple[1])) bound.insert(param);
+
+            for (int i = 2; i < tuple.size(); ++i) collectFreeVariables(tuple[i], bound, out);
+            return;
+        }
+        else if (head == "define-struct") return;
+        else if ((head == "local" || head == "define" || head == "define/memo") && tuple.size() > 1)
+        {
+            /** Names introduced by the form are visible to every part of it, so they are bound first */
+            std::vector<std::string> definitions;
+            if (head == "local") definitions = parseTuple(tuple[1]);
+            else definitions.push_back(str);
+
+            for (auto &definition : definitions)
+            {
+                std::vector<std::string> defTuple = parseTuple(definition);
+                if (defTuple.size() < 2) continue;
+
+                if (defTuple[1].front() == '(' || defTuple[1].front() == '[')
+                    bound.insert(parseTuple(defTuple[1]).front());
+                else bound.insert(defTuple[1]);
+            }
+
+            for (auto &definition : definitions)
+            {
+                std::vector<std::string> defTuple = parseTuple(definition);
+                if (defTuple.size() < 3) continue;
+
+                std::set<std::string> defBound = bound;
+                if (defTuple[1].front() == '(' || defTuple[1].front() == '[')
+                {
+                    for (auto &param : parseTuple(defTuple[1])) defBound.insert(param);
+                }
+
+                for (int i = 2; i < defTuple.size(); ++i) collectFreeVariables(defTuple[i], defBound, out);
+            }
+
+            if (head == "local")
+            {
+                for (int i = 2; i < tuple.size(); ++i) collectFreeVariables(tuple[i], bound, out);
+            }
+
+            return;
+        }
+
+        for (auto &member : tuple) collectFreeVariables(member, bound, out);
+    }
+
+    std::vector<std::string> freeVariables(const std::vector<std::string> &lambdaExpr)
+    {
+        std::vector<std::string> out;
+        if (lambdaExpr.size() < 3) return out;
+
+        std::set<std::string> bound;
+        for (auto &param : parseTuple(lambdaExpr[1])) bound.insert(param);
+
+        for (int i = 2; i < lambdaExpr.size(); ++i) collectFreeVariables(lambdaExpr[i], bound, out);
+
+        return out;
+    }
+
+    /**
+     * True if evaluating str could add a definition outside of a local, e.g. a define or define-struct in a body.
+     */
+    bool definesNonLocally(const std::string &str)
+    {
+        if (str.empty() || (str.front() != '(' && str.front() != '[')) return false;
+
+        std::vector<std::string> tuple = parseTuple(str);
+        if (tuple.empty()) return false;
+
+        const std::string &head = tuple.front();
+
+        if (head == "define" || head == "define/memo" || head == "define-struct") return true;
+        else if (head == "local" && tuple.size() > 1)
+        {
+            /** The local's own definitions stay local, but their bodies are still checked */
+            for (auto &definition : parseTuple(tuple[1]))
+            {
+                std::vector<std::string> defTuple = parseTuple(definition);
+                if (!defTuple.empty() && defTuple.front() == "define-struct") return true;
+
+                for (int i = 2; i < defTuple.size(); ++i)
+                    if (definesNonLocally(defTuple[i])) return true;
+            }
+
+            for (int i = 2; i < tuple.size(); ++i)
+                if (definesNonLocally(tuple[i])) return true;
+
+            return false;
+        }
+
+        for (auto &member : tuple)
+            if (definesNonLocally(member)) return true;
+
+        return false;
+    }
+
+    bool isPure(const std::vector<std::string> &lambdaExpr, const std::function<bool(const std::string &)> &isPureName)
+    {
+        if (lambdaExpr.size() < 3) return false;
+
+        for (int i = 2; i < lambdaExpr.size(); ++i)
+            if (definesNonLocally(lambdaExpr[i])) return false;
+
+        for (auto &name : freeVariables(lambdaExpr))
+            if (!isPureName(name)) return false;
+
+        return true;
     }
 
     std::unique_ptr<Expressions::Expression> parse(std::string str, const std::shared_ptr<Expressions::Scope> &scope)
     {
+        Interpreter::bumpCounter(Interpreter::runtimeCounters().parses);
+
         if (str[0] == '(' || str[0] == '[')
         {
             std::shared_ptr<Expressions::Scope> localScope(new Expressions::Scope(scope));
@@ -288,15 +445,15 @@ namespace Parser
             return std::make_unique<Expressions::SymbolExpression>(
                     Expressions::SymbolExpression(parseSymbol(str), std::move(localScope)));
         }
-        else if (scope != nullptr && scope->contains(str))
+        else if (Expressions::Scope *owner = scope != nullptr ? scope->find(str) : nullptr)
         {
-            return scope->getDefinition(str);
+            return owner->getDefinition(str);
         }
-        else if (Functions::funcMap.count(str) > 0)
+        else if (Functions::functionsFor(scope.get()).count(str) > 0)
         {
             return Functions::getFuncByName(str, scope);
         }
-        else if (Functions::specialFormMap.count(str) > 0)
+        else if (Functions::specialFormsFor(scope.get()).count(str) > 0)
         {
             return Functions::getFormByName(str, scope);
         }
@@ -16,6 +16,20 @@ namespace Parser
 
     std::vector<std::string> parseTuple(const std::string &);
 
+    bool isNumber(const std::string &);
+
+    /**
+     * Free-variable analysis for a lambda given as its tuple members ("lambda", params, body...).
+     * @return The identifiers referenced by the body that are not bound by the lambda or forms inside it.
+     */
+    std::vector<std::string> freeVariables(const std::vector<std::string> &lambdaExpr);
+
+    /**
+     * Conservative purity check for a lambda given as its tuple members. Only succeeds if the body defines nothing
+     * outside of a local and every free variable it references passes isPureName.
+     */
+    bool isPure(const std::vector<std::string> &lambdaExpr, const std::function<bool(const std::string &)> &isPureName);
+
     void replaceInScope(std::string &, const std::string &, const std::string &);
 
     void
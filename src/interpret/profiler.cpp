@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include "profiler.h"
+
+namespace Profiler
+{
+    bool enabled = false;
+
+    namespace
+    {
+        typedef std::vector<uint16_t> LabelStack;
+
+        const FrameId labelMask = 0xffff;
+
+        struct StackSamples
+        {
+            size_t steps = 0;
+            std::chrono::steady_clock::duration time{0};
+        };
+
+        struct ThreadProfile
+        {
+            std::vector<FrameId> stack;
+            FrameId creationFrame = 0;
+            size_t countdown = 1;
+            std::chrono::steady_clock::time_point lastSample = std::chrono::steady_clock::now();
+
+            std::mutex lock;
+            std::map<LabelStack, StackSamples> stacks;
+        };
+
+        std::string reportPath;
+        size_t period = 1;
+        std::chrono::steady_clock::time_point started;
+        std::atomic<FrameId> calls{0};
+
+        std::mutex profilesLock;
+        std::vector<ThreadProfile *> profiles;
+        std::vector<std::string> labels{"racquet"};
+        std::unordered_map<std::string, uint16_t> labelIndices;
+
+        ThreadProfile &localProfile()
+        {
+            // Frames and samples of a thread are reported after it exits, so profiles are never released.
+            thread_local ThreadProfile *profile = nullptr;
+
+            if (!profile)
+            {
+                profile = new ThreadProfile();
+                profile->countdown = period;
+
+                std::lock_guard<std::mutex> guard(profilesLock);
+                profiles.push_back(profile);
+            }
+
+            return *profile;
+        }
+
+        uint16_t labelIndex(const std::string &label)
+        {
+            thread_local std::unordered_map<std::string, uint16_t> cache;
+
+            auto cached = cache.find(label);
+            if (cached != cache.end()) return cached->second;
+
+            std::lock_guard<std::mutex> guard(profilesLock);
+            auto found = labelIndices.find(label);
+            uint16_t index;
+
+            if (found != labelIndices.end()) index = found->second;
+            else if (labels.size() >= labelMask)
+            {
+                // Out of labels, everything from here on shares the last index, which no real label is given
+                if (labels.size() == labelMask) labels.push_back("<other>");
+                index = labelMask;
+            }
+            else
+            {
+                index = labels.size();
+                labels.push_back(label);
+                labelIndices[label] = index;
+            }
+
+            cache[label] = index;
+            return index;
+        }
+
+        void record(ThreadProfile &profile)
+        {
+            LabelStack key;
+            key.reserve(profile.stack.size());
+
+            for (auto frame : profile.stack) key.push_back(frame & labelMask);
+
+            auto now = std::chrono::steady_clock::now();
+
+            std::lock_guard<std::mutex> guard(profile.lock);
+            StackSamples &samples = profile.stacks[key];
+            samples.steps += period;
+            samples.time += now - profile.lastSample;
+            profile.lastSample = now;
+        }
+
+        double toMs(std::chrono::steady_clock::duration duration)
+        {
+            return std::chrono::duration<double, std::milli>(duration).count();
+        }
+
+        struct FunctionTotals
+        {
+            size_t selfSteps = 0, totalSteps = 0;
+            std::chrono::steady_clock::duration selfTime{0}, totalTime{0};
+        };
+    }
+
+    void start(const std::string &path, size_t samplePeriod)
+    {
+        reportPath = path;
+        period = std::max<size_t>(samplePeriod, 1);
+        started = std::chrono::steady_clock::now();
+        localProfile().countdown = period;
+        enabled = true;
+    }
+
+    void stop()
+    {
+        if (!enabled) return;
+        enabled = false;
+
+        std::map<LabelStack, StackSamples> merged;
+        std::lock_guard<std::mutex> guard(profilesLock);
+
+        for (auto profile : profiles)
+        {
+            std::lock_guard<std::mutex> profileGuard(profile->lock);
+
+            for (auto &entry : profile->stacks)
+            {
+                merged[entry.first].steps += entry.second.steps;
+                merged[entry.first].time += entry.second.time;
+            }
+        }
+
+        std::map<uint16_t, FunctionTotals> functions;
+        size_t sampledSteps = 0;
+
+        for (auto &entry : merged)
+        {
+            const LabelStack &stack = entry.first;
+            sampledSteps += entry.second.steps;
+
+            uint16_t self = stack.empty() ? 0 : stack.back();
+            functions[self].selfSteps += entry.second.steps;
+            functions[self].selfTime += entry.second.time;
+
+            // Recursive functions appear on the stack several times, but only count once towards their total
+            std::set<uint16_t> seen(stack.begin(), stack.end());
+            seen.insert(0);
+
+            for (auto label : seen)
+            {
+                functions[label].totalSteps += entry.second.steps;
+                functions[label].totalTime += entry.second.time;
+            }
+        }
+
+        std::vector<std::pair<uint16_t, FunctionTotals>> sorted(functions.begin(), functions.end());
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<uint16_t, FunctionTotals> &a,
+                                                   const std::pair<uint16_t, FunctionTotals> &b)
+        {
+            return a.second.selfSteps > b.second.selfSteps;
+        });
+
+        std::ofstream flat(reportPath);
+        flat << "Flat profile: " << sampledSteps << " steps sampled every " << period << " steps over "
+             << std::fixed << std::setprecision(1) << toMs(std::chrono::steady_clock::now() - started)
+             << " ms" << std::endl << std::endl;
+        flat << std::setw(12) << "self steps" << std::setw(8) << "self %" << std::setw(12) << "self ms"
+             << std::setw(13) << "total steps" << std::setw(12) << "total ms" << "  function" << std::endl;
+
+        for (auto &entry : sorted)
+        {
+            const FunctionTotals &totals = entry.second;
+            double percent = sampledSteps ? 100.0 * totals.selfSteps / sampledSteps : 0;
+
+            flat << std::setw(12) << totals.selfSteps << std::setw(8) << percent
+                 << std::setw(12) << toMs(totals.selfTime) << std::setw(13) << totals.totalSteps
+                 << std::setw(12) << toMs(totals.totalTime) << "  " << labels[entry.first] << std::endl;
+        }
+
+        std::ofstream collapsed(reportPath + ".folded");
+
+        for (auto &entry : merged)
+        {
+            collapsed << labels[0];
+
+            for (auto label : entry.first) collapsed << ";" << labels[label];
+
+            collapsed << " " << entry.second.steps << std::endl;
+        }
+
+        std::cerr << "Profile written to " << reportPath << " and " << reportPath << ".folded" << std::endl;
+    }
+
+    FrameId enterCall(const std::string &label)
+    {
+        FrameId call = calls.fetch_add(1, std::memory_order_relaxed) + 1;
+        return (call << 16) | labelIndex(label);
+    }
+
+    FrameId currentFrame()
+    {
+        return localProfile().creationFrame;
+    }
+
+    void sample()
+    {
+        ThreadProfile &profile = localProfile();
+        if (--profile.countdown) return;
+
+        profile.countdown = period;
+        record(profile);
+    }
+
+    void resetClock()
+    {
+        ThreadProfile &profile = localProfile();
+
+        std::lock_guard<std::mutex> guard(profile.lock);
+        profile.lastSample = std::chrono::steady_clock::now();
+    }
+
+    CreationScope::CreationScope(FrameId frame)
+    {
+        ThreadProfile &profile = localProfile();
+        saved = profile.creationFrame;
+        profile.creationFrame = frame;
+    }
+
+    CreationScope::~CreationScope()
+    {
+        localProfile().creationFrame = saved;
+    }
+
+    Activation::Activation(FrameId frame)
+    {
+        std::vector<FrameId> &stack = localProfile().stack;
+        pushed = frame != 0 && (stack.empty() || stack.back() != frame);
+
+        if (pushed) stack.push_back(frame);
+    }
+
+    Activation::~Activation()
+    {
+        if (pushed) localProfile().stack.pop_back();
+    }
+}
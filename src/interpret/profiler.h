@@ -0,0 +1,60 @@
+#ifndef RACKET_INTERPRETER_PROFILER_H
+#define RACKET_INTERPRETER_PROFILER_H
+
+#include <cstdint>
+#include <string>
+
+namespace Profiler
+{
+    /**
+     * Identifies one invocation of a function: the low 16 bits index the function's label,
+     * the rest is a counter so recursive invocations stay apart on the stack. 0 is top level.
+     */
+    typedef uint64_t FrameId;
+
+    extern bool enabled;
+
+    /* Starts sampling the stack every samplePeriod evaluation steps, the report is written by stop() */
+    void start(const std::string &reportPath, size_t samplePeriod);
+
+    /* Writes a flat profile to the report path and the sampled stacks in collapsed format next to it */
+    void stop();
+
+    /* A fresh frame for an invocation of the function with the given label */
+    FrameId enterCall(const std::string &label);
+
+    /* The frame expressions created on this thread are attributed to */
+    FrameId currentFrame();
+
+    /* Counts down to the next sample, called once per evaluation step */
+    void sample();
+
+    /* Starts timing the next sample from now, so time spent waiting for input isn't attributed to anything */
+    void resetClock();
+
+    /* Attributes the expressions created while alive to a frame */
+    class CreationScope
+    {
+    public:
+        explicit CreationScope(FrameId frame);
+
+        ~CreationScope();
+
+    private:
+        FrameId saved;
+    };
+
+    /* Makes a frame the active one on this thread's stack while alive */
+    class Activation
+    {
+    public:
+        explicit Activation(FrameId frame);
+
+        ~Activation();
+
+    private:
+        bool pushed;
+    };
+}
+
+#endif //RACKET_INTERPRETER_PROFILER_H
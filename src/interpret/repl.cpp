@@ -3,6 +3,8 @@
 //
 
 #include "interpret.h"
+#include "../memory/gc.h"
+#include "../functions/functions.h"
 
 namespace Interpreter
 {
@@ -25,6 +27,8 @@ namespace Interpreter
     std::unique_ptr<Expressions::Expression> eval(const std::string &input,
                                                   std::shared_ptr<Expressions::Scope> &globalScope)
     {
+        if (Profiler::enabled) Profiler::resetClock();
+
         auto expr = Parser::parse(input, globalScope);
         return Interpreter::interpret(std::move(expr));
     }
@@ -32,6 +36,8 @@ namespace Interpreter
     Expressions::expression_vector evalSteps(const std::string &input,
                                              std::shared_ptr<Expressions::Scope> &globalScope)
     {
+        if (Profiler::enabled) Profiler::resetClock();
+
         auto expr = Parser::parse(input, globalScope);
         return Interpreter::interpretSaveSteps(std::move(expr));
     }
@@ -40,7 +46,7 @@ namespace Interpreter
     {
         if (expr->type() == "VoidValueExpression") return;
 
-        std::cout << expr->toString() << std::endl;
+        Functions::output() << expr->toString() << '\n';
     }
 
     void print(Expressions::expression_vector &steps)
@@ -51,7 +57,7 @@ namespace Interpreter
                 exp->type() == "PartialExpression")
                 continue;
 
-            std::cout << exp->toString() << std::endl << std::endl;
+            Functions::output() << exp->toString() << "\n\n";
         }
     }
 
@@ -89,6 +95,36 @@ namespace Interpreter
             {
                 std::cout << exception.what() << std::endl;
             }
+
+            // Nothing is being evaluated between two inputs, so the global scope is the only root
+            Memory::maybeCollect(globalScope.get());
+        }
+    }
+
+    int run(std::istream &inputStream, std::shared_ptr<Expressions::Scope> &globalScope)
+    {
+        while (inputStream)
+        {
+            std::string input = read(inputStream);
+            if (input.empty()) continue;
+            if (input == "(exit)") break;
+
+            try
+            {
+                auto expr = eval(input, globalScope);
+                print(expr);
+            }
+            catch (std::exception &exception)
+            {
+                // Whatever was printed before the error comes out before it
+                Functions::output().flush();
+                std::cerr << exception.what() << std::endl;
+                return 1;
+            }
+
+            Memory::maybeCollect(globalScope.get());
         }
+
+        return 0;
     }
-}
\ No newline at end of file
+}
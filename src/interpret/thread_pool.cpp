@@ -0,0 +1,283 @@
+#include <chrono>
+#include <exception>
+
+#include "thread_pool.h"
+
+namespace Interpreter
+{
+    namespace
+    {
+        size_t sharedThreadCount = 1;
+
+        /* The pool this thread works for and its index there, null on threads outside any pool */
+        thread_local ThreadPool *currentPool = nullptr;
+        thread_local size_t workerIndex = 0;
+
+        /* Parallel loops this thread is currently inside of */
+        thread_local size_t parallelDepth = 0;
+
+        std::atomic<size_t> backgroundWork(0), heapSharingWork(0);
+
+        class ParallelRegion
+        {
+        public:
+            ParallelRegion()
+            {
+                ++parallelDepth;
+            }
+
+            ~ParallelRegion()
+            {
+                --parallelDepth;
+            }
+        };
+    }
+
+    ThreadPool::ThreadPool(size_t threadCount) : pending(0)
+    {
+        if (threadCount == 0) threadCount = 1;
+
+        for (size_t i = 0; i < threadCount; ++i) queues.emplace_back(new WorkerQueue());
+
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+
+        available.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::workerLoop(size_t index)
+    {
+        currentPool = this;
+        workerIndex = index;
+
+        while (true)
+        {
+            Task task;
+            if (popTask(task))
+            {
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(lock);
+            available.wait(guard, [this] { return stopping || pending > 0; });
+
+            if (stopping && pending == 0) return;
+        }
+    }
+
+    bool ThreadPool::popTask(Task &task)
+    {
+        bool isOwnWorker = currentPool == this;
+
+        if (isOwnWorker)
+        {
+            WorkerQueue &own = *queues[workerIndex];
+            std::lock_guard<std::mutex> guard(own.lock);
+
+            if (!own.tasks.empty())
+            {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                --pending;
+                return true;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+
+            if (!injected.empty())
+            {
+                task = std::move(injected.front());
+                injected.pop_front();
+                --pending;
+                return true;
+            }
+        }
+
+        /** Steal the oldest task of another worker, they tend to be the biggest */
+        size_t start = isOwnWorker ? workerIndex + 1 : 0;
+        for (size_t i = 0; i < queues.size(); ++i)
+        {
+            WorkerQueue &victim = *queues[(start + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --pending;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool ThreadPool::runPendingTask()
+    {
+        Task task;
+        if (!popTask(task)) return false;
+
+        task();
+        return true;
+    }
+
+    void ThreadPool::submit(std::function<void()> task)
+    {
+        if (currentPool == this)
+        {
+            WorkerQueue &own = *queues[workerIndex];
+            std::lock_guard<std::mutex> guard(own.lock);
+            own.tasks.push_back(std::move(task));
+            ++pending;
+        }
+        else
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            injected.push_back(std::move(task));
+            ++pending;
+        }
+
+        // Taking the lock orders the notification after a sleeping worker's check of pending
+        {
+            std::lock_guard<std::mutex> guard(lock);
+        }
+        available.notify_one();
+    }
+
+    void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &body)
+    {
+        ParallelRegion region;
+
+        if (workers.size() == 1 || count < 2)
+        {
+            for (size_t i = 0; i < count; ++i) body(i);
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+        size_t finished = 0;
+        std::exception_ptr error;
+        std::mutex doneLock;
+        std::condition_variable done;
+
+        /** Each participant claims indices until none are left */
+        auto claim = [&]
+        {
+            std::exception_ptr claimError;
+
+            for (size_t i = next++; i < count; i = next++)
+            {
+                try
+                {
+                    body(i);
+                }
+                catch (...)
+                {
+                    claimError = std::current_exception();
+                    next = count;
+                }
+            }
+
+            return claimError;
+        };
+
+        /** The calling thread is one of the participants, so one task per other thread that could help */
+        size_t taskCount = std::min(count - 1, workers.size());
+        for (size_t task = 0; task < taskCount; ++task)
+        {
+            submit([&]
+                   {
+                       std::exception_ptr taskError = claim();
+
+                       std::lock_guard<std::mutex> guard(doneLock);
+                       if (taskError && !error) error = taskError;
+                       ++finished;
+                       done.notify_all();
+                   });
+        }
+
+        std::exception_ptr ownError = claim();
+
+        /** Tasks still queued finish immediately once run, so run whatever is pending instead of just waiting */
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> guard(doneLock);
+                if (finished == taskCount) break;
+            }
+
+            if (runPendingTask()) continue;
+
+            std::unique_lock<std::mutex> guard(doneLock);
+            done.wait_for(guard, std::chrono::milliseconds(1), [&] { return finished == taskCount; });
+        }
+
+        if (ownError) std::rethrow_exception(ownError);
+        if (error) std::rethrow_exception(error);
+    }
+
+    size_t ThreadPool::size() const
+    {
+        return workers.size();
+    }
+
+    void ThreadPool::configure(size_t threadCount)
+    {
+        sharedThreadCount = threadCount;
+    }
+
+    ThreadPool &ThreadPool::shared()
+    {
+        static ThreadPool pool(sharedThreadCount);
+        return pool;
+    }
+
+    bool ThreadPool::onWorkerThread()
+    {
+        return currentPool != nullptr;
+    }
+
+    bool ThreadPool::inParallel()
+    {
+        return currentPool != nullptr || parallelDepth > 0 || BackgroundWork::sharingHeap();
+    }
+
+    BackgroundWork::BackgroundWork(bool sharesHeap) : sharesHeap(sharesHeap)
+    {
+        ++backgroundWork;
+        if (sharesHeap) ++heapSharingWork;
+    }
+
+    BackgroundWork::~BackgroundWork()
+    {
+        if (sharesHeap) --heapSharingWork;
+        --backgroundWork;
+    }
+
+    bool BackgroundWork::running()
+    {
+        return backgroundWork > 0;
+    }
+
+    bool BackgroundWork::sharingHeap()
+    {
+        return heapSharingWork > 0;
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef RACKET_INTERPRETER_THREAD_POOL_H
+#define RACKET_INTERPRETER_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Interpreter
+{
+    /**
+     * Work stealing pool. Every worker has its own deque: it pushes and pops its own tasks at the back, and
+     * idle workers steal from the front of the others'. Tasks submitted from outside the pool go through a
+     * shared queue. A thread waiting on a parallel loop runs queued tasks instead of blocking, so loops can
+     * nest without starving the pool.
+     */
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t threadCount);
+
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        void submit(std::function<void()> task);
+
+        /**
+         * Runs body(i) for every i in [0, count) across the pool and returns once all of them are done.
+         * The calling thread claims indices too. With a single worker the loop simply runs inline.
+         */
+        void parallelFor(size_t count, const std::function<void(size_t)> &body);
+
+        size_t size() const;
+
+        /* Sets the worker count of the shared pool, must be called before its first use. */
+        static void configure(size_t threadCount);
+
+        static ThreadPool &shared();
+
+        static bool onWorkerThread();
+
+        /* Whether this thread is a worker, is inside a parallel loop, or futures are running, i.e. other threads
+         * may be evaluating in the same context */
+        static bool inParallel();
+
+    private:
+        typedef std::function<void()> Task;
+
+        struct WorkerQueue
+        {
+            std::mutex lock;
+            std::deque<Task> tasks;
+        };
+
+        void workerLoop(size_t index);
+
+        /* Takes a task from this thread's own deque, the shared queue, or another worker, in that order */
+        bool popTask(Task &task);
+
+        bool runPendingTask();
+
+        std::vector<std::thread> workers;
+        std::vector<std::unique_ptr<WorkerQueue>> queues;
+
+        std::deque<Task> injected;
+        std::mutex lock;
+        std::condition_variable available;
+
+        /* Tasks queued anywhere in the pool, sleeping workers wait for this to become non-zero */
+        std::atomic<size_t> pending;
+        bool stopping = false;
+    };
+}
+
+namespace Interpreter
+{
+    /**
+     * Marks evaluation that keeps running after the input that started it is done, for as long as it is alive.
+     * Futures share the heap of the thread that created them, places have heaps of their own.
+     */
+    class BackgroundWork
+    {
+    public:
+        explicit BackgroundWork(bool sharesHeap);
+
+        ~BackgroundWork();
+
+        BackgroundWork(const BackgroundWork &) = delete;
+
+        BackgroundWork &operator=(const BackgroundWork &) = delete;
+
+        static bool running();
+
+        /* Whether some of it may be using scopes of other threads, so collecting them isn't safe */
+        static bool sharingHeap();
+
+    private:
+        bool sharesHeap;
+    };
+}
+
+#endif //RACKET_INTERPRETER_THREAD_POOL_H
@@ -1,39 +1,68 @@
+#include <fstream>
+
+#include <unistd.h>
+
 #include "args/args.h"
 #include "interpret/interpret.h"
 #include "functions/functions.h"
-#include "expressions/struct_expression.h"
+#include "interpret/profiler.h"
+#include "interpret/context.h"
+#include "interpret/output_buffer.h"
+#include "server/server.h"
 
-void define_constants(std::shared_ptr<Expressions::Scope> &globalScope)
+/* racquet run <file> [args]: everything printed goes through one large buffer, flushed on exit */
+int runScript(int argc, char *argv[], Interpreter::Context &context)
 {
-    globalScope->define("e", std::make_unique<Expressions::InexactNumberExpression>
-            (Expressions::InexactNumberExpression(M_E,
-                                                  std::make_shared<Expressions::Scope>(
-                                                          Expressions::Scope(globalScope)))));
-    globalScope->define("pi", std::make_unique<Expressions::InexactNumberExpression>
-            (Expressions::InexactNumberExpression(M_PI,
-                                                  std::make_shared<Expressions::Scope>(
-                                                          Expressions::Scope(globalScope)))));
-
-    StructFunctions::defineStruct("posn", std::vector<std::string>{"x", "y"});
-
-    globalScope->define("empty", std::make_unique<Expressions::ListExpression>
-            (Expressions::ListExpression(std::list<std::unique_ptr<Expressions::Expression>>(),
-                                         std::make_shared<Expressions::Scope>(
-                                                 Expressions::Scope(globalScope)))));
+    if (argc < 2)
+    {
+        std::cerr << "run: Expected a file to run" << std::endl;
+        return 2;
+    }
+
+    std::ifstream file(argv[1]);
+    if (!file)
+    {
+        std::cerr << argv[1] << ": Could not open file" << std::endl;
+        return 2;
+    }
+
+    for (int i = 2; i < argc; ++i) Functions::commandLineArguments.emplace_back(argv[i]);
+
+    std::cout.flush();
+    Interpreter::OutputBuffer buffer(STDOUT_FILENO);
+    std::ostream out(&buffer);
+    Functions::setDefaultOutput(&out);
+
+    int status = Interpreter::run(file, context.globalScope);
+
+    out.flush();
+    Functions::setDefaultOutput(&std::cout);
+
+    // A script whose tests fail fails too, like one that raised an error
+    if (status == 0 && (!buffer.good() || context.failedTests > 0)) return 1;
+    return status;
 }
 
 int main(int argc, char *argv[])
 {
     Functions::registerFunctions();
-    std::shared_ptr<Expressions::Scope> globalScope(new Expressions::Scope(nullptr));
-    define_constants(globalScope);
+    Interpreter::Context context;
 
-    CLI::parseCmdArgs(argc, argv, globalScope);
+    int run = CLI::findRunCommand(argc, argv);
+    CLI::parseCmdArgs(run, argv, context.globalScope);
 
-    std::cout << "Run '(exit)' to exit." << std::endl;
+    if (!Server::serverOptions.socketPath.empty()) return Server::serve(context);
 
-    Interpreter::repl(std::cin, globalScope, false);
+    int status = 0;
+    if (run < argc) status = runScript(argc - run, argv + run, context);
+    else
+    {
+        std::cout << "Run '(exit)' to exit." << std::endl;
 
-    globalScope->clear();
-    return 0;
-}
\ No newline at end of file
+        Interpreter::repl(std::cin, context.globalScope, false);
+    }
+
+    Profiler::stop();
+    if (Interpreter::printStatsAtExit) Interpreter::printRuntimeStats(std::cerr);
+    return status;
+}
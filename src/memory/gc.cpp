@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "gc.h"
+#include "../interpret/thread_pool.h"
+#include "../interpret/context.h"
+
+namespace Memory
+{
+    namespace
+    {
+        const size_t minimumCollectionThreshold = 10000;
+
+        std::mutex registriesLock;
+        std::vector<ScopeRegistry *> registries;
+
+        std::mutex statsLock;
+        HeapStats stats;
+
+        std::vector<std::function<void(Tracer &)>> rootTracers;
+
+        // Collections of different contexts may trace the same scopes of a context they are layered over
+        std::mutex collectionLock;
+        std::atomic<unsigned int> lastEpoch(0);
+        std::atomic<bool> collectionRequested(false);
+
+        ScopeRegistry *localRegistry()
+        {
+            // Thread registries are never freed, scopes may outlive the thread that created them.
+            thread_local ScopeRegistry *registry = nullptr;
+
+            if (!registry) registry = createRegistry();
+
+            return registry;
+        }
+
+        ScopeRegistry *registryOf(const Expressions::Scope *scope)
+        {
+            Interpreter::Context *context = Interpreter::Context::find(scope);
+            return context ? context->heap : localRegistry();
+        }
+    }
+
+    ScopeRegistry *createRegistry()
+    {
+        auto registry = new ScopeRegistry();
+        registry->nextCollection = minimumCollectionThreshold;
+
+        std::lock_guard<std::mutex> guard(registriesLock);
+        registries.push_back(registry);
+
+        return registry;
+    }
+
+    void releaseRegistry(ScopeRegistry *registry)
+    {
+        {
+            std::lock_guard<std::mutex> guard(registriesLock);
+            registries.erase(std::find(registries.begin(), registries.end(), registry));
+        }
+
+        ScopeRegistry *local = localRegistry();
+        {
+            std::lock(registry->lock, local->lock);
+            std::lock_guard<std::mutex> guard(registry->lock, std::adopt_lock);
+            std::lock_guard<std::mutex> localGuard(local->lock, std::adopt_lock);
+
+            while (Expressions::Scope *scope = registry->head)
+            {
+                registry->head = scope->heapNext;
+
+                scope->context = nullptr;
+                scope->heapRegistry = local;
+                scope->heapPrev = nullptr;
+                scope->heapNext = local->head;
+                if (local->head) local->head->heapPrev = scope;
+                local->head = scope;
+                ++local->liveScopes;
+            }
+        }
+
+        delete registry;
+    }
+
+    void registerScope(Expressions::Scope *scope)
+    {
+        ScopeRegistry *registry = registryOf(scope);
+        std::lock_guard<std::mutex> guard(registry->lock);
+
+        scope->heapRegistry = registry;
+        scope->heapPrev = nullptr;
+        scope->heapNext = registry->head;
+        if (registry->head) registry->head->heapPrev = scope;
+        registry->head = scope;
+        ++registry->liveScopes;
+    }
+
+    void unregisterScope(Expressions::Scope *scope)
+    {
+        ScopeRegistry *registry = scope->heapRegistry;
+        if (!registry) return;
+
+        std::lock_guard<std::mutex> guard(registry->lock);
+
+        if (scope->heapPrev) scope->heapPrev->heapNext = scope->heapNext;
+        else registry->head = scope->heapNext;
+        if (scope->heapNext) scope->heapNext->heapPrev = scope->heapPrev;
+
+        scope->heapRegistry = nullptr;
+        --registry->liveScopes;
+    }
+
+    void addRootTracer(std::function<void(Tracer &)> rootTracer)
+    {
+        rootTracers.push_back(std::move(rootTracer));
+    }
+
+    /* Tracer */
+
+    void Tracer::mark(const std::shared_ptr<Expressions::Scope> &scope)
+    {
+        mark(scope.get());
+    }
+
+    void Tracer::mark(Expressions::Scope *scope)
+    {
+        if (!scope || scope->markEpoch == epoch) return;
+
+        scope->markEpoch = epoch;
+        worklist.push_back(scope);
+    }
+
+    void Tracer::mark(Expressions::Expression *expr)
+    {
+        if (expr) expr->trace(*this);
+    }
+
+    bool Tracer::firstVisit(unsigned int &markEpoch)
+    {
+        if (markEpoch == epoch) return false;
+
+        markEpoch = epoch;
+        return true;
+    }
+
+    void Tracer::drain()
+    {
+        while (!worklist.empty())
+        {
+            Expressions::Scope *scope = worklist.back();
+            worklist.pop_back();
+
+            mark(scope->parent);
+            for (auto &definition : scope->definitions)
+            {
+                mark(definition.second.get());
+            }
+        }
+    }
+
+    void collect(Expressions::Scope *globalScope)
+    {
+        std::lock_guard<std::mutex> collecting(collectionLock);
+        auto start = std::chrono::steady_clock::now();
+
+        unsigned int epoch = ++lastEpoch;
+        Tracer tracer(epoch);
+
+        Interpreter::Context *context = Interpreter::Context::find(globalScope);
+
+        tracer.mark(globalScope);
+        if (context) context->trace(tracer);
+        for (auto &rootTracer : rootTracers)
+        {
+            rootTracer(tracer);
+        }
+        tracer.drain();
+
+        ScopeRegistry *registry = registryOf(globalScope);
+        std::vector<Expressions::Scope *> garbage;
+        {
+            std::lock_guard<std::mutex> guard(registry->lock);
+
+            for (Expressions::Scope *scope = registry->head; scope != nullptr; scope = scope->heapNext)
+            {
+                if (scope->markEpoch != epoch) garbage.push_back(scope);
+            }
+        }
+
+        /** Move everything out of the garbage before freeing any of it, since freeing one scope can free others */
+        std::vector<std::map<std::string, std::unique_ptr<Expressions::Expression>>> definitions;
+        std::vector<std::shared_ptr<Expressions::Scope>> parents;
+        definitions.reserve(garbage.size());
+        parents.reserve(garbage.size());
+
+        for (auto scope : garbage)
+        {
+            definitions.push_back(std::move(scope->definitions));
+            scope->definitions.clear();
+            parents.push_back(std::move(scope->parent));
+        }
+
+        definitions.clear();
+        parents.clear();
+
+        std::chrono::duration<double, std::milli> pause = std::chrono::steady_clock::now() - start;
+
+        std::lock_guard<std::mutex> guard(statsLock);
+        ++stats.collections;
+        stats.scopesReclaimed += garbage.size();
+        stats.lastPauseMs = pause.count();
+        stats.totalPauseMs += pause.count();
+    }
+
+    void maybeCollect(Expressions::Scope *globalScope)
+    {
+        ScopeRegistry *registry = registryOf(globalScope);
+        size_t live, next;
+        {
+            std::lock_guard<std::mutex> guard(registry->lock);
+            live = registry->liveScopes;
+            next = registry->nextCollection;
+        }
+
+        // A future may be using scopes that look unreachable from here, a requested collection waits for it
+        if (Interpreter::BackgroundWork::sharingHeap()) return;
+        if (!collectionRequested.exchange(false) && live < next) return;
+
+        collect(globalScope);
+
+        std::lock_guard<std::mutex> guard(registry->lock);
+        registry->nextCollection = std::max(minimumCollectionThreshold, 2 * registry->liveScopes);
+    }
+
+    void requestCollection()
+    {
+        collectionRequested = true;
+    }
+
+    HeapStats heapStats()
+    {
+        HeapStats rtn;
+        {
+            std::lock_guard<std::mutex> guard(statsLock);
+            rtn = stats;
+        }
+
+        rtn.liveScopes = 0;
+
+        std::lock_guard<std::mutex> guard(registriesLock);
+        for (auto registry : registries)
+        {
+            std::lock_guard<std::mutex> registryGuard(registry->lock);
+            rtn.liveScopes += registry->liveScopes;
+        }
+
+        return rtn;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef RACKET_INTERPRETER_GC_H
+#define RACKET_INTERPRETER_GC_H
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "../expressions/expressions.h"
+
+namespace Memory
+{
+    /**
+     * Every Scope registers itself with the registry of its interpreter context, or with the one of the thread
+     * that created it if it isn't part of any. The list is intrusive (Scope::heapPrev/heapNext) so registering
+     * never allocates.
+     */
+    struct ScopeRegistry
+    {
+        std::mutex lock;
+        Expressions::Scope *head = nullptr;
+        size_t liveScopes = 0;
+
+        /* Live scopes at which maybeCollect collects next */
+        size_t nextCollection = 0;
+    };
+
+    struct HeapStats
+    {
+        size_t liveScopes = 0;
+        size_t collections = 0;
+        size_t scopesReclaimed = 0;
+        double lastPauseMs = 0;
+        double totalPauseMs = 0;
+    };
+
+    class Tracer
+    {
+    public:
+        explicit Tracer(unsigned int epoch) : epoch(epoch)
+        {}
+
+        void mark(const std::shared_ptr<Expressions::Scope> &scope);
+
+        void mark(Expressions::Scope *scope);
+
+        void mark(Expressions::Expression *expr);
+
+        /* Whether an object outside of any scope, e.g. the state shared by the copies of a promise, is reached for
+         * the first time in this collection. Keeps tracing from going around in circles. */
+        bool firstVisit(unsigned int &markEpoch);
+
+        /* Marks everything reachable from the scopes marked so far. */
+        void drain();
+
+    private:
+        unsigned int epoch;
+        std::vector<Expressions::Scope *> worklist;
+    };
+
+    void registerScope(Expressions::Scope *scope);
+
+    /* A registry for the scopes of one interpreter context */
+    ScopeRegistry *createRegistry();
+
+    /* Frees a registry, moving scopes that are still alive over to the calling thread's. They no longer belong to
+     * any context. */
+    void releaseRegistry(ScopeRegistry *registry);
+
+    void unregisterScope(Expressions::Scope *scope);
+
+    /* Roots outside of the global scope, e.g. queued test cases, are reported by root tracers. */
+    void addRootTracer(std::function<void(Tracer &)> rootTracer);
+
+    /**
+     * Marks everything reachable from the global scope, its context and the root tracers, then breaks up the
+     * unreachable scopes of that context (or of the calling thread, for a global scope outside of any) by
+     * dropping their definitions, which lets reference counting free the cycles.
+     * Must only be called when no evaluation is in progress in that context.
+     */
+    void collect(Expressions::Scope *globalScope);
+
+    /* Collects if the heap grew enough since the last collection, or if a collection was requested. */
+    void maybeCollect(Expressions::Scope *globalScope);
+
+    void requestCollection();
+
+    HeapStats heapStats();
+}
+
+#endif //RACKET_INTERPRETER_GC_H
@@ -0,0 +1,114 @@
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "nursery.h"
+
+namespace Memory
+{
+    namespace
+    {
+        const size_t granularity = 16;
+        const size_t sizeClasses = 8;
+        const size_t chunkSize = 64 * 1024;
+
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        struct ThreadNursery
+        {
+            FreeBlock *freeLists[sizeClasses] = {};
+            char *bump = nullptr;
+            char *end = nullptr;
+            std::atomic<size_t> allocations{0};
+        };
+
+        std::mutex chunksLock;
+        std::vector<void *> chunks;
+        std::vector<ThreadNursery *> nurseries;
+
+        ThreadNursery *localNursery()
+        {
+            // Blocks may be freed after their thread exits, so neither nurseries nor chunks are released.
+            thread_local ThreadNursery *nursery = nullptr;
+
+            if (!nursery)
+            {
+                nursery = new ThreadNursery();
+
+                std::lock_guard<std::mutex> guard(chunksLock);
+                nurseries.push_back(nursery);
+            }
+
+            return nursery;
+        }
+
+        size_t sizeClass(size_t size)
+        {
+            return (size + granularity - 1) / granularity - 1;
+        }
+
+        void refill(ThreadNursery *nursery)
+        {
+            char *chunk = static_cast<char *>(::operator new(chunkSize));
+            nursery->bump = chunk;
+            nursery->end = chunk + chunkSize;
+
+            std::lock_guard<std::mutex> guard(chunksLock);
+            chunks.push_back(chunk);
+        }
+    }
+
+    void *nurseryAllocate(size_t size)
+    {
+        size_t index = sizeClass(size);
+        if (index >= sizeClasses) return ::operator new(size);
+
+        ThreadNursery *nursery = localNursery();
+        // Only this thread writes the counter, so no read-modify-write is needed
+        nursery->allocations.store(nursery->allocations.load(std::memory_order_relaxed) + 1,
+                                   std::memory_order_relaxed);
+
+        if (FreeBlock *block = nursery->freeLists[index])
+        {
+            nursery->freeLists[index] = block->next;
+            return block;
+        }
+
+        size_t blockSize = (index + 1) * granularity;
+        if (static_cast<size_t>(nursery->end - nursery->bump) < blockSize) refill(nursery);
+
+        void *block = nursery->bump;
+        nursery->bump += blockSize;
+        return block;
+    }
+
+    void nurseryFree(void *block, size_t size)
+    {
+        size_t index = sizeClass(size);
+        if (index >= sizeClasses) return ::operator delete(block);
+
+        ThreadNursery *nursery = localNursery();
+        auto freed = static_cast<FreeBlock *>(block);
+        freed->next = nursery->freeLists[index];
+        nursery->freeLists[index] = freed;
+    }
+
+    NurseryStats nurseryStats()
+    {
+        NurseryStats stats;
+        std::lock_guard<std::mutex> guard(chunksLock);
+
+        for (auto nursery : nurseries)
+        {
+            stats.allocations += nursery->allocations.load(std::memory_order_relaxed);
+        }
+
+        stats.chunks = chunks.size();
+        stats.chunkBytes = chunks.size() * chunkSize;
+        return stats;
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef RACKET_INTERPRETER_NURSERY_H
+#define RACKET_INTERPRETER_NURSERY_H
+
+#include <cstddef>
+
+namespace Memory
+{
+    struct NurseryStats
+    {
+        size_t allocations = 0;
+        size_t chunks = 0;
+        size_t chunkBytes = 0;
+    };
+
+    /**
+     * Allocator for small, short-lived values such as numbers and booleans.
+     * Each thread bumps through its own chunks, and freed blocks go on a per-size free list of the thread
+     * freeing them, so allocating a temporary is a pointer bump or a list pop and never reaches malloc.
+     * Chunks are never returned, blocks are reused by later values of the same size class.
+     */
+    void *nurseryAllocate(size_t size);
+
+    void nurseryFree(void *block, size_t size);
+
+    NurseryStats nurseryStats();
+}
+
+/* Class-specific allocation functions routing a value type through the nursery */
+#define NURSERY_ALLOCATED \
+        static void *operator new(size_t size) { return Memory::nurseryAllocate(size); } \
+        static void operator delete(void *block, size_t size) { Memory::nurseryFree(block, size); }
+
+#endif //RACKET_INTERPRETER_NURSERY_H
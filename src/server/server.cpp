@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "../interpret/interpret.h"
+#include "../interpret/budget.h"
+
+namespace Server
+{
+    ServerOptions serverOptions;
+
+    namespace
+    {
+        /* Larger frames are taken as garbage rather than allocated */
+        const uint32_t maximumFrameLength = 64u << 20u;
+
+        /* How long a forked evaluation may overrun the request's time budget before it is killed */
+        const long forkGraceMs = 1000;
+
+        bool writeAll(int socket, const char *data, size_t length)
+        {
+            while (length > 0)
+            {
+                ssize_t written = ::write(socket, data, length);
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) return false;
+
+                data += written;
+                length -= written;
+            }
+
+            return true;
+        }
+
+        bool readAll(int socket, char *data, size_t length)
+        {
+            while (length > 0)
+            {
+                ssize_t received = ::read(socket, data, length);
+                if (received < 0 && errno == EINTR) continue;
+                if (received <= 0) return false;
+
+                data += received;
+                length -= received;
+            }
+
+            return true;
+        }
+
+        void appendLength(std::string &out, uint32_t length)
+        {
+            for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<char>((length >> shift) & 0xffu));
+        }
+
+        uint32_t lengthAt(const char *data)
+        {
+            auto bytes = reinterpret_cast<const unsigned char *>(data);
+            return (uint32_t(bytes[0]) << 24u) | (uint32_t(bytes[1]) << 16u) | (uint32_t(bytes[2]) << 8u) | bytes[3];
+        }
+
+        Response failure(const std::string &message)
+        {
+            Response response;
+            response.status = Status::error;
+            response.result = message;
+
+            return response;
+        }
+
+        /* Waits for the descriptor to become readable until the deadline, forever if timeoutMs is 0 */
+        bool waitReadable(int descriptor, long timeoutMs)
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+            while (true)
+            {
+                int wait = -1;
+                if (timeoutMs > 0)
+                    wait = static_cast<int>(std::max<long>(0, std::chrono::duration_cast<std::chrono::milliseconds>
+                            (deadline - std::chrono::steady_clock::now()).count()));
+
+                pollfd ready{descriptor, POLLIN, 0};
+                int result = ::poll(&ready, 1, wait);
+                if (result < 0 && errno == EINTR) continue;
+
+                return result > 0;
+            }
+        }
+
+        void reportLatencies(std::vector<double> &latenciesMs)
+        {
+            if (latenciesMs.empty()) return;
+
+            std::sort(latenciesMs.begin(), latenciesMs.end());
+
+            double total = 0;
+            for (double latency : latenciesMs) total += latency;
+
+            size_t p99 = std::min(latenciesMs.size() - 1, static_cast<size_t>(0.99 * (latenciesMs.size() - 1) + 0.5));
+
+            // One write, so reports of clients closing at the same time don't interleave
+            std::ostringstream report;
+            report << std::fixed << std::setprecision(3) << "client closed: " << latenciesMs.size()
+                   << " forked request(s), fork to result mean " << total / latenciesMs.size() << " ms, p99 "
+                   << latenciesMs[p99] << " ms, max " << latenciesMs.back() << " ms" << std::endl;
+            std::cerr << report.str();
+        }
+
+        void serveClient(Interpreter::Context &prelude, int client)
+        {
+            std::string request;
+            std::vector<double> latenciesMs;
+
+            while (receiveFrame(client, request))
+            {
+                Response response;
+
+                if (serverOptions.fork)
+                {
+                    double latencyMs = 0;
+                    response = evaluateForked(prelude, request, latencyMs);
+                    latenciesMs.push_back(latencyMs);
+                }
+                else response = evaluate(prelude, request);
+
+                if (!sendFrame(client, encodeResponse(response))) break;
+            }
+
+            ::close(client);
+            reportLatencies(latenciesMs);
+        }
+    }
+
+    Response evaluate(Interpreter::Context &prelude, const std::string &source)
+    {
+        Response response;
+        std::ostringstream output;
+
+        {
+            Interpreter::Context context(prelude);
+            Functions::OutputRedirect redirect(&output);
+
+            try
+            {
+                Interpreter::BudgetScope budget(serverOptions.stepLimit, serverOptions.timeoutMs);
+
+                // Split into top-level forms the way the members of a tuple are, several may share a line
+                for (auto &form : Parser::parseTuple("(" + source + "\n)"))
+                {
+                    auto value = Interpreter::interpret(Parser::parse(form, context.globalScope));
+                    response.result = value->type() == "VoidValueExpression" ? "" : value->toString();
+                    value.reset();
+
+                    Memory::maybeCollect(context.globalScope.get());
+                }
+            }
+            catch (std::exception &error)
+            {
+                response.status = Status::error;
+                response.result = error.what();
+            }
+
+            // Futures the request left running would outlive its context and print past its output
+            context.cancelBackground();
+        }
+
+        response.output = output.str();
+        return response;
+    }
+
+    Response evaluateForked(Interpreter::Context &prelude, const std::string &source, double &latencyMs)
+    {
+        int result[2];
+        if (::pipe(result) < 0) return failure(std::string("pipe: ") + std::strerror(errno));
+
+        auto start = std::chrono::steady_clock::now();
+
+        pid_t child = ::fork();
+        if (child < 0)
+        {
+            ::close(result[0]);
+            ::close(result[1]);
+            return failure(std::string("fork: ") + std::strerror(errno));
+        }
+
+        if (child == 0)
+        {
+            ::close(result[0]);
+
+            // Only this thread made it into the child, nothing may wait on the others, so no destructors either
+            bool sent = sendFrame(result[1], encodeResponse(evaluate(prelude, source)));
+            ::_exit(sent ? 0 : 1);
+        }
+
+        ::close(result[1]);
+
+        long timeoutMs = serverOptions.timeoutMs > 0 ? serverOptions.timeoutMs + forkGraceMs : 0;
+        std::string frame;
+        Response response;
+
+        bool answered = waitReadable(result[0], timeoutMs) && receiveFrame(result[0], frame)
+                        && decodeResponse(frame, response);
+        ::close(result[0]);
+
+        std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+        latencyMs = latency.count();
+
+        if (!answered) ::kill(child, SIGKILL);
+
+        int status = 0;
+        while (::waitpid(child, &status, 0) < 0 && errno == EINTR);
+
+        if (answered) return response;
+        if (WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL && timeoutMs > 0 && latencyMs >= timeoutMs)
+            return failure("Evaluation killed after " + std::to_string(timeoutMs) + " ms");
+        if (WIFSIGNALED(status))
+            return failure("Evaluation died from signal " + std::to_string(WTERMSIG(status)));
+
+        return failure("Evaluation exited with code " + std::to_string(WEXITSTATUS(status)) + " without a result");
+    }
+
+    int serve(Interpreter::Context &prelude)
+    {
+        const std::string &path = serverOptions.socketPath;
+
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path))
+        {
+            std::cerr << "Socket path too long: " << path << std::endl;
+            return 1;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0)
+        {
+            std::cerr << "socket: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+
+        ::unlink(path.c_str());
+        if (::bind(listener, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0
+            || ::listen(listener, SOMAXCONN) < 0)
+        {
+            std::cerr << path << ": " << std::strerror(errno) << std::endl;
+            ::close(listener);
+            return 1;
+        }
+
+        // A client hanging up mid-response is that client's problem
+        std::signal(SIGPIPE, SIG_IGN);
+
+        std::cerr << "Serving on " << path << (serverOptions.fork ? ", forking every request" : "") << std::endl;
+
+        while (true)
+        {
+            int client = ::accept(listener, nullptr, nullptr);
+            if (client < 0)
+            {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+
+                std::cerr << "accept: " << std::strerror(errno) << std::endl;
+                break;
+            }
+
+            std::thread(serveClient, std::ref(prelude), client).detach();
+        }
+
+        ::close(listener);
+        ::unlink(path.c_str());
+        return 1;
+    }
+
+    bool sendFrame(int socket, const std::string &payload)
+    {
+        std::string frame;
+        frame.reserve(payload.size() + 4);
+        appendLength(frame, static_cast<uint32_t>(payload.size()));
+        frame += payload;
+
+        return writeAll(socket, frame.data(), frame.size());
+    }
+
+    bool receiveFrame(int socket, std::string &payload)
+    {
+        char header[4];
+        if (!readAll(socket, header, sizeof(header))) return false;
+
+        uint32_t length = lengthAt(header);
+        if (length > maximumFrameLength) return false;
+
+        payload.resize(length);
+        return length == 0 || readAll(socket, &payload[0], length);
+    }
+
+    std::string encodeResponse(const Response &response)
+    {
+        std::string encoded;
+        encoded.reserve(5 + response.output.size() + response.result.size());
+
+        encoded.push_back(static_cast<char>(response.status));
+        appendLength(encoded, static_cast<uint32_t>(response.output.size()));
+        encoded += response.output;
+        encoded += response.result;
+
+        return encoded;
+    }
+
+    bool decodeResponse(const std::string &frame, Response &response)
+    {
+        if (frame.size() < 5) return false;
+
+        uint32_t outputLength = lengthAt(frame.data() + 1);
+        if (outputLength > frame.size() - 5) return false;
+
+        response.status = static_cast<Status>(frame[0]);
+        response.output = frame.substr(5, outputLength);
+        response.result = frame.substr(5 + outputLength);
+        return true;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef RACKET_INTERPRETER_SERVER_H
+#define RACKET_INTERPRETER_SERVER_H
+
+#include <string>
+
+#include "../interpret/context.h"
+
+/**
+ * Evaluation over a Unix domain socket, so clients don't pay for starting an interpreter and loading its preludes
+ * on every request. Every message either way is a frame: a 4 byte big-endian length, then that many bytes.
+ *
+ * A request frame holds source to evaluate, any number of top-level forms. The response frame starts with a
+ * status byte, 0 if every form evaluated and 1 if one threw, followed by a 4 byte big-endian length and the
+ * output printed while evaluating. The rest is the printed value of the last form, or the error message.
+ */
+namespace Server
+{
+    struct ServerOptions
+    {
+        /* Path of the socket to listen on, not serving if empty */
+        std::string socketPath;
+
+        /* Budget of every request, 0 for none */
+        size_t stepLimit = 0;
+        long timeoutMs = 0;
+
+        /* Evaluate every request in a forked copy of the server instead of on its thread */
+        bool fork = false;
+    };
+
+    extern ServerOptions serverOptions;
+
+    enum class Status : unsigned char
+    {
+        ok = 0, error = 1
+    };
+
+    struct Response
+    {
+        Status status = Status::ok;
+        std::string output;
+        std::string result;
+    };
+
+    /**
+     * Accepts clients on serverOptions.socketPath until the listening socket fails, each on a thread of its own.
+     * Every request is evaluated in a context layered over prelude and dropped afterwards, so requests see the
+     * preludes' definitions but nothing of each other. With serverOptions.fork every request gets a process of
+     * its own instead, see evaluateForked. Returns the exit code.
+     */
+    int serve(Interpreter::Context &prelude);
+
+    /* Evaluates one request's source in a context of its own */
+    Response evaluate(Interpreter::Context &prelude, const std::string &source);
+
+    /**
+     * Evaluates one request in a child process forked off the server, so whatever it does to its copy of the
+     * heap, or to the process, never reaches the server. A child outliving the request's time budget is killed.
+     * latencyMs is set to the time from the fork to the response being read back.
+     */
+    Response evaluateForked(Interpreter::Context &prelude, const std::string &source, double &latencyMs);
+
+    bool sendFrame(int socket, const std::string &payload);
+
+    /* False once the peer closed the connection or sent a broken frame */
+    bool receiveFrame(int socket, std::string &payload);
+
+    std::string encodeResponse(const Response &response);
+
+    bool decodeResponse(const std::string &frame, Response &response);
+}
+
+#endif //RACKET_INTERPRETER_SERVER_H